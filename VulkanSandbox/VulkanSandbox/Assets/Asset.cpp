@@ -0,0 +1,36 @@
+#include "Asset.h"
+
+#include "../Graphics/UploadBatch.h"
+#include "Package.h"
+
+using namespace std;
+
+void Asset::Load()
+{
+    UploadBatch batch;
+
+    Decode();
+    Upload(batch);
+
+    uint32_t pieces = 0;
+
+    while (HasMoreToStream())
+    {
+        StreamNext(batch);
+        pieces++;
+    }
+
+    batch.Submit();
+
+    for (; pieces > 0; --pieces)
+    {
+        OnStreamed();
+    }
+}
+
+void Asset::Decode()
+{
+    vector<char> storage;
+
+    DecodeFromMemory(Package::ReadFile(_path, storage));
+}
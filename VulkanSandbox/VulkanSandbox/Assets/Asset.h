@@ -1,11 +1,46 @@
 #pragma once
+#include <cstdint>
 #include <filesystem>
+#include <span>
+#include <vector>
+
+class UploadBatch;
 
 class Asset
 {
 	public:
-	virtual void Load() = 0;
+	Asset(const std::filesystem::path& path) : _path(path) {}
+	virtual ~Asset() = default;
+
+	//blocking, decodes and uploads in a batch of its own, streamed assets go up in full
+	void Load();
+	//reads the file and decodes it on the calling thread
+	void Decode();
+	//CPU side of loading (decoding, processing) from the file's bytes, safe to run on a worker thread
+	//fileData may point straight into the mounted Package, see Package::IsMapped before holding on to it
+	virtual void DecodeFromMemory(std::span<const char> fileData) = 0;
+	//records the GPU upload of decoded data into batch, main thread only
+	virtual void Upload(UploadBatch& batch) = 0;
 	virtual void Unload() = 0;
 	 
 	virtual bool IsLoaded() const = 0;
+
+	//device memory held by the uploaded resources
+	virtual uint64_t GetGpuMemorySize() const = 0;
+	//gives back device memory when over budget, any copies it needs are recorded into batch
+	//returns the bytes freed, 0 when there's nothing left it can give up
+	//resources that frames in flight may still use have to go through Graphics::DeferDestroy
+	virtual uint64_t Evict(UploadBatch& batch) = 0;
+
+	//assets that are drawable before they're at full quality stream the rest in pieces after Upload
+	virtual bool HasMoreToStream() const { return false; }
+	//records the upload of the next piece into batch, returns the bytes staged
+	virtual uint64_t StreamNext(UploadBatch& batch) { return 0; }
+	//the batch holding the oldest piece from StreamNext has finished on the GPU
+	virtual void OnStreamed() {}
+
+	const std::filesystem::path& GetPath() const { return _path; }
+
+protected:
+	const std::filesystem::path _path;
 };
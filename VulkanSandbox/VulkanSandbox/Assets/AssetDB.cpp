@@ -0,0 +1,662 @@
+#include "AssetDB.h"
+
+#include "Package.h"
+#include "Graphics/Texture.h"
+#include "Graphics/Model.h"
+#include "../Graphics/Graphics.h"
+#include "../Utils/AsyncIO.h"
+#include "../Utils/CLogger.h"
+
+#include <algorithm>
+
+using namespace std;
+
+void AssetDB::Init()
+{
+    Assert(!_ioThread.joinable(), "AssetDB initialized twice!");
+
+    _quit = false;
+    _ioThread = thread(IOLoop);
+}
+
+void AssetDB::CreatePlaceholders()
+{
+    _placeholderTexture = Texture::CreateSolid(128, 128, 128, 255);
+    _placeholderModel = Model::CreateCube();
+
+    UploadBatch batch;
+
+    _placeholderTexture->Upload(batch);
+    _placeholderModel->Upload(batch);
+
+    batch.Submit();
+}
+
+void AssetDB::DeInit()
+{
+    {
+        scoped_lock lock(_ioMutex);
+        _quit = true;
+        _ioQueue.clear();
+    }
+
+    _ioCondition.notify_all();
+    _ioThread.join();
+
+    //decodes still running hold pointers into the slots and the staging buffers
+    JobSystem::Wait(_decodeCounter);
+
+    _stagingMemory = {};
+    _freeStagingBuffers.clear();
+
+    _uploadsInFlight.clear();
+    _decoded.clear();
+    _slots.clear();
+    _residentMemory = 0;
+    _freeSlots.clear();
+    _pathToSlot.clear();
+
+    _placeholderModel.reset();
+    _placeholderTexture.reset();
+}
+
+void AssetDB::Update()
+{
+    _frame++;
+
+    for (auto it = _uploadsInFlight.begin(); it != _uploadsInFlight.end();)
+    {
+        //streamed pieces have to land in the order they were recorded
+        if (!it->batch->IsComplete())
+        {
+            break;
+        }
+
+        for (uint32_t index : it->slots)
+        {
+            Slot& slot = _slots[index];
+
+            if (slot.released)
+            {
+                RetireSlot(index);
+                continue;
+            }
+
+            slot.state = AssetState::Resident;
+            slot.reduced = false;
+            slot.reloading = false;
+
+            if (slot.stale)
+            {
+                QueueReplacement(index);
+            }
+        }
+
+        for (const auto& [index, streamedPieces] : it->replaced)
+        {
+            SwapInReplacement(index, streamedPieces);
+        }
+
+        for (const auto& [index, generation] : it->streamed)
+        {
+            if (IsCurrent(index, generation))
+            {
+                _slots[index].asset->OnStreamed();
+            }
+        }
+
+        it = _uploadsInFlight.erase(it);
+    }
+
+    vector<IORequest> decoded;
+
+    {
+        scoped_lock lock(_decodedMutex);
+        decoded.swap(_decoded);
+    }
+
+    unique_ptr<UploadBatch> batch;
+    vector<uint32_t> uploads;
+    vector<pair<uint32_t, uint32_t>> replaced;
+    uploads.reserve(decoded.size());
+
+    for (const IORequest& request : decoded)
+    {
+        const uint32_t index = request.slot;
+        Slot& slot = _slots[index];
+
+        if (slot.released)
+        {
+            RetireSlot(index);
+            continue;
+        }
+
+        if (!batch)
+        {
+            batch = make_unique<UploadBatch>();
+        }
+
+        //the current copy stays on screen until the swap, so the replacement goes up in full instead of streaming afterwards
+        if (request.asset == slot.replacement.get())
+        {
+            slot.replacement->Upload(*batch);
+
+            uint32_t streamedPieces = 0;
+
+            for (; slot.replacement->HasMoreToStream(); ++streamedPieces)
+            {
+                slot.replacement->StreamNext(*batch);
+            }
+
+            replaced.push_back({ index, streamedPieces });
+            continue;
+        }
+
+        slot.asset->Upload(*batch);
+        TrackMemory(slot);
+        uploads.push_back(index);
+    }
+
+    vector<pair<uint32_t, uint32_t>> streamed = StreamPieces(batch);
+
+    EnforceBudget(batch);
+
+    if (!batch)
+    {
+        return;
+    }
+
+    batch->SubmitAsync();
+
+    if (!uploads.empty())
+    {
+        Log("Streaming assets to the GPU", { {"Asset count", uploads.size()}, {"Resident MB", _residentMemory >> 20} });
+    }
+
+    _uploadsInFlight.push_back({ move(batch), move(uploads), move(streamed), move(replaced) });
+}
+
+vector<pair<uint32_t, uint32_t>> AssetDB::StreamPieces(unique_ptr<UploadBatch>& batch)
+{
+    vector<pair<uint32_t, uint32_t>> streamed;
+    uint64_t streamedBytes = 0;
+
+    for (uint32_t i = 0; i < _slots.size() && streamedBytes < MAX_STREAMED_BYTES_PER_FRAME; ++i)
+    {
+        Slot& slot = _slots[i];
+
+        //only assets whose first upload has landed, a reload starts its own stream once it's back
+        if (!slot.asset || slot.state != AssetState::Resident || slot.reloading || !slot.asset->HasMoreToStream())
+        {
+            continue;
+        }
+
+        if (!batch)
+        {
+            batch = make_unique<UploadBatch>();
+        }
+
+        streamedBytes += slot.asset->StreamNext(*batch);
+        streamed.push_back({ i, slot.generation });
+    }
+
+    return streamed;
+}
+
+void AssetDB::SetMemoryBudget(uint64_t bytes)
+{
+    _memoryBudget = bytes;
+}
+
+uint64_t AssetDB::GetMemoryBudget()
+{
+    if (_memoryBudget != 0)
+    {
+        return _memoryBudget;
+    }
+
+    uint64_t budget;
+    uint64_t usage;
+    Graphics::GetDeviceLocalBudget(budget, usage);
+
+    //swap chain, attachments and staging keep whatever they're using now
+    const uint64_t otherUsage = usage > _residentMemory ? usage - _residentMemory : 0;
+    const uint64_t usable = static_cast<uint64_t>(static_cast<double>(budget) * DEVICE_BUDGET_FRACTION);
+
+    return usable > otherUsage ? usable - otherUsage : 0;
+}
+
+void AssetDB::EnforceBudget(unique_ptr<UploadBatch>& batch)
+{
+    const uint64_t budget = GetMemoryBudget();
+
+    if (_residentMemory <= budget)
+    {
+        _overBudgetLogged = false;
+        return;
+    }
+
+    vector<uint32_t> candidates;
+
+    for (uint32_t i = 0; i < _slots.size(); ++i)
+    {
+        const Slot& slot = _slots[i];
+
+        if (slot.asset && slot.state == AssetState::Resident && !slot.reloading && !slot.replacement && slot.lastUsedFrame + MIN_UNUSED_FRAMES <= _frame)
+        {
+            candidates.push_back(i);
+        }
+    }
+
+    sort(candidates.begin(), candidates.end(), [](uint32_t a, uint32_t b) { return _slots[a].lastUsedFrame < _slots[b].lastUsedFrame; });
+
+    for (uint32_t index : candidates)
+    {
+        if (_residentMemory <= budget)
+        {
+            break;
+        }
+
+        if (!batch)
+        {
+            batch = make_unique<UploadBatch>();
+        }
+
+        Slot& slot = _slots[index];
+
+        //textures give up one mip at a time, keep going on the oldest one before touching the next
+        while (_residentMemory > budget && slot.asset->Evict(*batch) > 0)
+        {
+            TrackMemory(slot);
+        }
+
+        if (slot.asset->IsLoaded())
+        {
+            slot.reduced = true;
+        }
+        else
+        {
+            slot.state = AssetState::Unloaded;
+        }
+    }
+
+    if (_residentMemory > budget && !_overBudgetLogged)
+    {
+        Error("Assets in use don't fit the memory budget", { {"Resident MB", _residentMemory >> 20}, {"Budget MB", budget >> 20} });
+        _overBudgetLogged = true;
+    }
+}
+
+pair<uint32_t, uint32_t> AssetDB::Acquire(const filesystem::path& path, AssetFactory create)
+{
+    string key = path.generic_string();
+
+    if (auto it = _pathToSlot.find(key); it != _pathToSlot.end())
+    {
+        return { it->second, _slots[it->second].generation };
+    }
+
+    uint32_t index;
+
+    if (!_freeSlots.empty())
+    {
+        index = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+    else
+    {
+        index = static_cast<uint32_t>(_slots.size());
+        _slots.emplace_back();
+    }
+
+    Slot& slot = _slots[index];
+    slot.asset = create(path);
+    slot.create = create;
+    slot.path = key;
+    slot.lastUsedFrame = _frame;
+
+    _pathToSlot.emplace(move(key), index);
+
+    QueueLoad(index);
+
+    return { index, slot.generation };
+}
+
+void AssetDB::Release(uint32_t index, uint32_t generation)
+{
+    if (!IsCurrent(index, generation))
+    {
+        return;
+    }
+
+    Slot& slot = _slots[index];
+
+    //bumping the generation is what makes every outstanding handle stale
+    slot.generation++;
+    _pathToSlot.erase(slot.path);
+
+    //a decode or upload still holds the asset, Update retires it once it's back
+    if (slot.state == AssetState::Loading || slot.reloading || slot.replacement)
+    {
+        slot.released = true;
+        return;
+    }
+
+    RetireSlot(index);
+}
+
+bool AssetDB::IsCurrent(uint32_t index, uint32_t generation)
+{
+    return index < _slots.size() && _slots[index].generation == generation && _slots[index].asset;
+}
+
+Asset* AssetDB::Touch(uint32_t index, uint32_t generation)
+{
+    if (!IsCurrent(index, generation))
+    {
+        return nullptr;
+    }
+
+    Slot& slot = _slots[index];
+    slot.lastUsedFrame = _frame;
+
+    //a pending replacement brings the asset back in full anyway
+    if (!slot.replacement && (slot.state == AssetState::Unloaded || (slot.reduced && !slot.reloading)))
+    {
+        QueueLoad(index);
+    }
+
+    return slot.state == AssetState::Resident ? slot.asset.get() : nullptr;
+}
+
+void AssetDB::QueueLoad(uint32_t index)
+{
+    Slot& slot = _slots[index];
+
+    //reduced assets stay drawable while the full copy streams in
+    if (slot.state == AssetState::Resident)
+    {
+        slot.reloading = true;
+    }
+    else
+    {
+        slot.state = AssetState::Loading;
+    }
+
+    {
+        scoped_lock lock(_ioMutex);
+        _ioQueue.push_back({ slot.asset.get(), index });
+    }
+
+    _ioCondition.notify_one();
+}
+
+void AssetDB::Reload(const filesystem::path& path)
+{
+    if (auto it = _pathToSlot.find(path.generic_string()); it != _pathToSlot.end())
+    {
+        QueueReplacement(it->second);
+    }
+}
+
+void AssetDB::QueueReplacement(uint32_t index)
+{
+    Slot& slot = _slots[index];
+
+    //an unloaded asset reads the new file whenever it next loads
+    if (slot.state == AssetState::Unloaded)
+    {
+        return;
+    }
+
+    //the decode in flight may have read the old file, go again once it has landed
+    if (slot.state == AssetState::Loading || slot.reloading || slot.replacement)
+    {
+        slot.stale = true;
+        return;
+    }
+
+    slot.stale = false;
+    slot.replacement = slot.create(slot.path);
+
+    {
+        scoped_lock lock(_ioMutex);
+        _ioQueue.push_back({ slot.replacement.get(), index });
+    }
+
+    _ioCondition.notify_one();
+}
+
+void AssetDB::SwapInReplacement(uint32_t index, uint32_t streamedPieces)
+{
+    Slot& slot = _slots[index];
+
+    if (slot.released)
+    {
+        RetireSlot(index);
+        return;
+    }
+
+    //frames in flight may still be drawing with the old copy
+    Asset* old = slot.asset.release();
+    Graphics::DeferDestroy([old]() { delete old; });
+
+    slot.asset = move(slot.replacement);
+
+    for (uint32_t i = 0; i < streamedPieces; ++i)
+    {
+        slot.asset->OnStreamed();
+    }
+
+    slot.state = AssetState::Resident;
+    slot.reduced = false;
+    TrackMemory(slot);
+
+    Log("Reloaded asset", { {"Path", slot.path}, {"Resident MB", _residentMemory >> 20} });
+
+    if (slot.stale)
+    {
+        QueueReplacement(index);
+    }
+}
+
+void AssetDB::TrackMemory(Slot& slot)
+{
+    const uint64_t gpuMemory = slot.asset->GetGpuMemorySize();
+
+    _residentMemory = _residentMemory - slot.gpuMemory + gpuMemory;
+    slot.gpuMemory = gpuMemory;
+}
+
+void AssetDB::RetireSlot(uint32_t index)
+{
+    Slot& slot = _slots[index];
+
+    _residentMemory -= slot.gpuMemory;
+
+    Asset* asset = slot.asset.release();
+    Asset* replacement = slot.replacement.release();
+    Graphics::DeferDestroy([asset, replacement]() { delete asset; delete replacement; });
+
+    slot.state = AssetState::Unloaded;
+    slot.released = false;
+    slot.reduced = false;
+    slot.reloading = false;
+    slot.stale = false;
+    slot.gpuMemory = 0;
+    slot.create = nullptr;
+    slot.path.clear();
+
+    _freeSlots.push_back(index);
+}
+
+void AssetDB::SubmitDecode(const IORequest& request, span<const char> fileData, vector<char> storage, int32_t stagingBuffer)
+{
+    JobSystem::Submit([request, fileData, storage = move(storage), stagingBuffer]()
+        {
+            request.asset->DecodeFromMemory(storage.empty() ? fileData : span<const char>(storage));
+
+            //assets copy whatever isn't in the package mapping, so the buffer is free again
+            if (stagingBuffer >= 0)
+            {
+                scoped_lock lock(_stagingMutex);
+                _freeStagingBuffers.push_back(stagingBuffer);
+            }
+
+            scoped_lock lock(_decodedMutex);
+            _decoded.push_back(request);
+        }, _decodeCounter);
+}
+
+int32_t AssetDB::AcquireStagingBuffer(uint64_t size)
+{
+    scoped_lock lock(_stagingMutex);
+
+    if (size > STAGING_BUFFER_SIZE || _freeStagingBuffers.empty())
+    {
+        return -1;
+    }
+
+    const int32_t index = _freeStagingBuffers.back();
+    _freeStagingBuffers.pop_back();
+
+    return index;
+}
+
+void AssetDB::IOLoop()
+{
+    struct PendingRead
+    {
+        IORequest request;
+        AsyncIO::File file;
+        vector<char> storage;
+        int32_t stagingBuffer = -1;
+    };
+
+    //reading stays on this thread so the workers only ever do CPU work
+    //every loose file requested since the last pass goes out as one batch of reads, the buffers have to outlive io
+    unordered_map<uint64_t, PendingRead> pending;
+    uint64_t nextRead = 0;
+    AsyncIO io;
+    vector<AsyncIO::Completion> completions;
+
+    //pinned with the kernel once, so small reads skip mapping their pages every time (io_uring's READ_FIXED)
+    _stagingMemory.resize(STAGING_BUFFER_COUNT * STAGING_BUFFER_SIZE);
+    vector<span<char>> stagingBuffers;
+
+    for (uint32_t i = 0; i < STAGING_BUFFER_COUNT; ++i)
+    {
+        stagingBuffers.emplace_back(_stagingMemory.data() + i * STAGING_BUFFER_SIZE, STAGING_BUFFER_SIZE);
+    }
+
+    if (io.RegisterBuffers(stagingBuffers))
+    {
+        scoped_lock lock(_stagingMutex);
+
+        for (int32_t i = STAGING_BUFFER_COUNT; i > 0; --i)
+        {
+            _freeStagingBuffers.push_back(i - 1);
+        }
+    }
+    else
+    {
+        //without a ring they would only be an extra copy away from a plain vector
+        _stagingMemory = {};
+    }
+
+    while (true)
+    {
+        deque<IORequest> requests;
+
+        {
+            unique_lock lock(_ioMutex);
+
+            //with reads out the completions are what wakes this thread up
+            if (pending.empty())
+            {
+                _ioCondition.wait(lock, []() { return _quit || !_ioQueue.empty(); });
+            }
+
+            if (_quit)
+            {
+                break;
+            }
+
+            requests.swap(_ioQueue);
+        }
+
+        vector<AsyncIO::Read> reads;
+
+        for (const IORequest& request : requests)
+        {
+            //packaged files come back as a view of the mapping, storage is only filled for compressed ones
+            vector<char> storage;
+
+            if (optional<span<const char>> packaged = Package::ReadPackaged(request.asset->GetPath(), storage))
+            {
+                SubmitDecode(request, *packaged, move(storage));
+                continue;
+            }
+
+            PendingRead read{ request };
+
+            Assert(AsyncIO::OpenFile(request.asset->GetPath(), read.file), "Failed to load file", { {"file", request.asset->GetPath().string()} });
+
+            read.stagingBuffer = AcquireStagingBuffer(read.file.size);
+            char* buffer = nullptr;
+
+            if (read.stagingBuffer >= 0)
+            {
+                buffer = _stagingMemory.data() + read.stagingBuffer * STAGING_BUFFER_SIZE;
+            }
+            else
+            {
+                read.storage.resize(read.file.size);
+                buffer = read.storage.data();
+            }
+
+            reads.push_back({ read.file, 0, read.file.size, buffer, read.stagingBuffer, nextRead });
+            pending.emplace(nextRead++, move(read));
+        }
+
+        io.Submit(reads);
+
+        completions.clear();
+        io.Reap(completions, requests.empty() ? 1 : 0);
+
+        for (const AsyncIO::Completion& completion : completions)
+        {
+            auto it = pending.find(completion.userData);
+            PendingRead& read = it->second;
+
+            const uint64_t size = read.file.size;
+
+            Assert(completion.result == static_cast<int64_t>(size), "Failed to load file",
+                { {"file", read.request.asset->GetPath().string()}, {"result", completion.result} });
+
+            AsyncIO::CloseFile(read.file);
+
+            if (read.stagingBuffer >= 0)
+            {
+                SubmitDecode(read.request, span<const char>(_stagingMemory.data() + read.stagingBuffer * STAGING_BUFFER_SIZE, size), {},
+                    read.stagingBuffer);
+            }
+            else
+            {
+                SubmitDecode(read.request, {}, move(read.storage));
+            }
+            pending.erase(it);
+        }
+    }
+
+    //nothing decodes after quitting, just let the reads land before their buffers go
+    while (io.InFlight() > 0)
+    {
+        io.Reap(completions, io.InFlight());
+    }
+
+    for (auto& [id, read] : pending)
+    {
+        AsyncIO::CloseFile(read.file);
+    }
+}
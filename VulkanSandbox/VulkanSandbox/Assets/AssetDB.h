@@ -0,0 +1,200 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Asset.h"
+#include "AssetHandle.h"
+#include "../Graphics/UploadBatch.h"
+#include "../Utils/JobSystem.h"
+
+class Texture;
+class Model;
+
+//Owns every streamed asset. Files are read on a dedicated I/O thread, decoded on the job system
+//and uploaded in one batch per frame, until then Get hands back a placeholder so drawing never waits
+//Resident assets are kept under a device memory budget by evicting the ones drawn least recently,
+//an evicted asset streams back in the next time it's drawn
+class AssetDB
+{
+public:
+	//starts the I/O thread, loads can be queued before the device exists
+	static void Init();
+	//the placeholders need the device, they are uploaded before anything else
+	static void CreatePlaceholders();
+	static void DeInit();
+
+	//queues the asset if it isn't known yet, loading the same path twice shares the asset
+	template<typename T>
+	static AssetHandle<T> Load(const std::filesystem::path& path)
+	{
+		static_assert(std::is_base_of_v<Asset, T>, "AssetDB can only load assets!");
+
+		const auto [index, generation] = Acquire(path, [](const std::filesystem::path& assetPath) -> std::unique_ptr<Asset>
+			{
+				return std::make_unique<T>(assetPath);
+			});
+
+		return { index, generation };
+	}
+
+	//the resident asset, or the placeholder for its type while it's still loading
+	//call it for what's about to be drawn, it marks the asset as used this frame and brings evicted assets back
+	template<typename T>
+	static T* Get(AssetHandle<T> handle)
+	{
+		if (Asset* asset = Touch(handle.index, handle.generation))
+		{
+			return static_cast<T*>(asset);
+		}
+
+		if constexpr (std::is_same_v<T, Texture>)
+		{
+			return static_cast<T*>(_placeholderTexture.get());
+		}
+		else
+		{
+			static_assert(std::is_same_v<T, Model>, "No placeholder for this asset type!");
+			return static_cast<T*>(_placeholderModel.get());
+		}
+	}
+
+	template<typename T>
+	static AssetState GetState(AssetHandle<T> handle)
+	{
+		return IsCurrent(handle.index, handle.generation) ? _slots[handle.index].state : AssetState::Unloaded;
+	}
+
+	//invalidates every handle to the asset, its GPU resources go once no frame in flight can use them
+	template<typename T>
+	static void Release(AssetHandle<T> handle)
+	{
+		Release(handle.index, handle.generation);
+	}
+
+	//the file behind path changed on disk, a fresh copy is decoded and uploaded in full next to the current one
+	//and swapped in at the start of the frame its upload finished, handles stay valid throughout
+	//does nothing for paths that aren't loaded
+	static void Reload(const std::filesystem::path& path);
+
+	//main thread, once per frame after the frame's fence has been waited on
+	//promotes finished uploads to resident, submits everything decoded since last frame as one batch
+	//along with the next piece of every asset that is still streaming, and evicts until the resident assets fit the budget again
+	static void Update();
+
+	//bytes of device memory the resident assets may use, 0 derives it from the device's own budget
+	static void SetMemoryBudget(uint64_t bytes);
+	static uint64_t GetMemoryBudget();
+	static uint64_t GetResidentMemory() { return _residentMemory; }
+
+	//share of the device budget we let ourselves use, the rest is headroom for the driver and other apps
+	constexpr static double DEVICE_BUDGET_FRACTION = 0.9;
+	//assets drawn more recently than this aren't evicted, they would only have to stream straight back in
+	constexpr static uint64_t MIN_UNUSED_FRAMES = 30;
+	//streamed pieces stop once a frame has staged this much, the top mip of a big texture always fits on its own
+	constexpr static uint64_t MAX_STREAMED_BYTES_PER_FRAME = 16ull << 20;
+	//loose files up to this size are read into buffers registered with AsyncIO once, bigger ones into their own vector
+	//all of them together have to stay under the memlock limit, or registering fails and every read takes the vector path
+	constexpr static uint32_t STAGING_BUFFER_COUNT = 8;
+	constexpr static uint64_t STAGING_BUFFER_SIZE = 1ull << 20;
+
+private:
+	using AssetFactory = std::unique_ptr<Asset>(*)(const std::filesystem::path& path);
+
+	struct Slot
+	{
+		std::unique_ptr<Asset> asset;
+		//a reload's new copy until it replaces asset
+		std::unique_ptr<Asset> replacement;
+		AssetFactory create = nullptr;
+		std::string path;
+		uint32_t generation = 0;
+		AssetState state = AssetState::Unloaded;
+		//released while loading, the asset goes away once its decode is back
+		bool released = false;
+		//evicted down to a lower quality copy that is still drawable
+		bool reduced = false;
+		//a reduced asset streaming its full quality copy back in
+		bool reloading = false;
+		//the file changed while the asset was busy loading, reloaded once it's resident
+		bool stale = false;
+		uint64_t lastUsedFrame = 0;
+		uint64_t gpuMemory = 0;
+	};
+
+	struct IORequest
+	{
+		Asset* asset;
+		uint32_t slot;
+	};
+
+	struct UploadInFlight
+	{
+		std::unique_ptr<UploadBatch> batch;
+		std::vector<uint32_t> slots;
+		//slot and generation of every asset that streamed a piece in the batch
+		std::vector<std::pair<uint32_t, uint32_t>> streamed;
+		//slots whose replacement went up in full in the batch, with the number of pieces it streamed
+		std::vector<std::pair<uint32_t, uint32_t>> replaced;
+	};
+
+	static std::pair<uint32_t, uint32_t> Acquire(const std::filesystem::path& path, AssetFactory create);
+	static void Release(uint32_t index, uint32_t generation);
+	static bool IsCurrent(uint32_t index, uint32_t generation);
+	static Asset* Touch(uint32_t index, uint32_t generation);
+	static void QueueLoad(uint32_t index);
+	static void QueueReplacement(uint32_t index);
+	//puts a replacement whose upload finished in place of the slot's asset
+	static void SwapInReplacement(uint32_t index, uint32_t streamedPieces);
+	static void TrackMemory(Slot& slot);
+	static void EnforceBudget(std::unique_ptr<UploadBatch>& batch);
+	static std::vector<std::pair<uint32_t, uint32_t>> StreamPieces(std::unique_ptr<UploadBatch>& batch);
+	//drops a released slot's asset once no frame can be using it
+	static void RetireSlot(uint32_t index);
+	//decodes on the job system, fileData is only used when storage is empty
+	//a staging buffer the data was read into goes back to the free list once the decode is done with it
+	static void SubmitDecode(const IORequest& request, std::span<const char> fileData, std::vector<char> storage, int32_t stagingBuffer = -1);
+	//-1 when none is free or size doesn't fit
+	static int32_t AcquireStagingBuffer(uint64_t size);
+	static void IOLoop();
+
+	//only touched on the main thread, the worker threads get the asset pointer and slot index up front
+	inline static std::vector<Slot> _slots;
+	inline static std::vector<uint32_t> _freeSlots;
+	inline static std::unordered_map<std::string, uint32_t> _pathToSlot;
+
+	inline static std::thread _ioThread;
+	inline static std::deque<IORequest> _ioQueue;
+	inline static std::mutex _ioMutex;
+	inline static std::condition_variable _ioCondition;
+	inline static bool _quit = false;
+
+	inline static JobCounter _decodeCounter;
+	//decodes that finished, filled by the job system and drained by Update
+	inline static std::vector<IORequest> _decoded;
+	inline static std::mutex _decodedMutex;
+
+	//STAGING_BUFFER_COUNT buffers back to back, empty when AsyncIO couldn't register them
+	inline static std::vector<char> _stagingMemory;
+	inline static std::vector<int32_t> _freeStagingBuffers;
+	inline static std::mutex _stagingMutex;
+
+	//in submission order, a batch only counts as done once every batch before it is
+	inline static std::vector<UploadInFlight> _uploadsInFlight;
+
+	inline static uint64_t _frame = 0;
+	inline static uint64_t _memoryBudget = 0;
+	inline static uint64_t _residentMemory = 0;
+	inline static bool _overBudgetLogged = false;
+
+	inline static std::unique_ptr<Asset> _placeholderTexture;
+	inline static std::unique_ptr<Asset> _placeholderModel;
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+enum class AssetState : uint8_t
+{
+	Unloaded,
+	Loading, //being read, decoded or uploaded
+	Resident
+};
+
+//slot index plus the generation it was handed out with, goes stale once the asset is released
+template<typename T>
+struct AssetHandle
+{
+	constexpr static uint32_t INVALID_INDEX = ~0u;
+
+	uint32_t index = INVALID_INDEX;
+	uint32_t generation = 0;
+
+	bool IsValid() const { return index != INVALID_INDEX; }
+	bool operator==(const AssetHandle&) const = default;
+};
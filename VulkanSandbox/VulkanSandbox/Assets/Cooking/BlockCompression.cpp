@@ -0,0 +1,542 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+constexpr int BLOCK_TEXELS = 16;
+
+//BC7 4 bit index interpolation weights, out of 64
+constexpr uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//fills bits from the least significant bit of out[0] upwards, the order every BC format packs in
+class BitWriter
+{
+public:
+    BitWriter(uint8_t* out, uint32_t size) : _out(out)
+    {
+        memset(out, 0, size);
+    }
+
+    void Write(uint32_t value, uint32_t bitCount)
+    {
+        for (uint32_t i = 0; i < bitCount; ++i, ++_pos)
+        {
+            _out[_pos >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (_pos & 7));
+        }
+    }
+
+private:
+    uint8_t* _out;
+    uint32_t _pos = 0;
+};
+
+static void ToFloat(const uint8_t* rgba, float texels[BLOCK_TEXELS][4])
+{
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            texels[i][c] = rgba[i * 4 + c];
+        }
+    }
+}
+
+//direction the texels spread out along the most, by power iteration on their covariance
+static void PrincipalAxis(const float texels[BLOCK_TEXELS][4], int channels, float mean[4], float axis[4])
+{
+    for (int c = 0; c < 4; ++c)
+    {
+        mean[c] = 0;
+        axis[c] = 0;
+    }
+
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            mean[c] += texels[i][c] / BLOCK_TEXELS;
+        }
+    }
+
+    float covariance[4][4] = {};
+
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = 0; b < channels; ++b)
+            {
+                covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+            }
+        }
+    }
+
+    //start on the widest channel so the iteration can't begin orthogonal to the answer
+    int widest = 0;
+
+    for (int c = 1; c < channels; ++c)
+    {
+        if (covariance[c][c] > covariance[widest][widest])
+        {
+            widest = c;
+        }
+    }
+
+    axis[widest] = 1;
+
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {};
+        float length = 0;
+
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = 0; b < channels; ++b)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+
+            length += next[a] * next[a];
+        }
+
+        //flat block, any axis works
+        if (length < 1e-12f)
+        {
+            break;
+        }
+
+        length = sqrt(length);
+
+        for (int c = 0; c < channels; ++c)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+}
+
+//endpoints at the ends of the texels' projection onto the principal axis
+static void FitEndpoints(const float texels[BLOCK_TEXELS][4], int channels, float endpoint0[4], float endpoint1[4])
+{
+    float mean[4];
+    float axis[4];
+    PrincipalAxis(texels, channels, mean, axis);
+
+    float minT = numeric_limits<float>::max();
+    float maxT = -numeric_limits<float>::max();
+
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        float t = 0;
+
+        for (int c = 0; c < channels; ++c)
+        {
+            t += (texels[i][c] - mean[c]) * axis[c];
+        }
+
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+        endpoint0[c] = clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+        endpoint1[c] = clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+    }
+}
+
+//best endpoints for fixed indices, weights[i] is how much of endpoint0 texel i gets
+static bool LeastSquaresEndpoints(const float texels[BLOCK_TEXELS][4], const float weights[BLOCK_TEXELS], int channels,
+    float endpoint0[4], float endpoint1[4])
+{
+    float aa = 0;
+    float ab = 0;
+    float bb = 0;
+    float ax[4] = {};
+    float bx[4] = {};
+
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        const float a = weights[i];
+        const float b = 1.0f - a;
+
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+
+        for (int c = 0; c < channels; ++c)
+        {
+            ax[c] += a * texels[i][c];
+            bx[c] += b * texels[i][c];
+        }
+    }
+
+    const float determinant = aa * bb - ab * ab;
+
+    //every texel on the same index, nothing to solve
+    if (abs(determinant) < 1e-6f)
+    {
+        return false;
+    }
+
+    for (int c = 0; c < channels; ++c)
+    {
+        endpoint0[c] = clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+        endpoint1[c] = clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+    }
+
+    return true;
+}
+
+static uint16_t To565(const float color[4])
+{
+    const uint32_t r = static_cast<uint32_t>(lround(color[0] * 31.0f / 255.0f));
+    const uint32_t g = static_cast<uint32_t>(lround(color[1] * 63.0f / 255.0f));
+    const uint32_t b = static_cast<uint32_t>(lround(color[2] * 31.0f / 255.0f));
+
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void From565(uint16_t color, int out[3])
+{
+    const int r = color >> 11;
+    const int g = (color >> 5) & 63;
+    const int b = color & 31;
+
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+//nearest of the four palette entries for every texel, returns the summed squared error
+static uint32_t FitBC1Indices(const uint8_t* rgba, uint16_t color0, uint16_t color1, uint8_t indices[BLOCK_TEXELS])
+{
+    int palette[4][3];
+    From565(color0, palette[0]);
+    From565(color1, palette[1]);
+
+    for (int c = 0; c < 3; ++c)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t totalError = 0;
+
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        uint32_t bestError = numeric_limits<uint32_t>::max();
+
+        for (uint8_t p = 0; p < 4; ++p)
+        {
+            uint32_t error = 0;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                const int diff = rgba[i * 4 + c] - palette[p][c];
+                error += diff * diff;
+            }
+
+            if (error < bestError)
+            {
+                bestError = error;
+                indices[i] = p;
+            }
+        }
+
+        totalError += bestError;
+    }
+
+    return totalError;
+}
+
+uint32_t BlockCompression::BlockSize(BlockFormat format)
+{
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+void BlockCompression::EncodeBlock(BlockFormat format, const uint8_t* rgba, uint8_t* out)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        EncodeBC1(rgba, out);
+        break;
+    case BlockFormat::BC3:
+        EncodeBC3(rgba, out);
+        break;
+    case BlockFormat::BC5:
+        EncodeBC5(rgba, out);
+        break;
+    case BlockFormat::BC7:
+        EncodeBC7(rgba, out);
+        break;
+    }
+}
+
+void BlockCompression::EncodeBC1(const uint8_t* rgba, uint8_t* out)
+{
+    float texels[BLOCK_TEXELS][4];
+    ToFloat(rgba, texels);
+
+    float endpoint0[4];
+    float endpoint1[4];
+    FitEndpoints(texels, 3, endpoint0, endpoint1);
+
+    uint16_t color0 = To565(endpoint0);
+    uint16_t color1 = To565(endpoint1);
+    uint8_t indices[BLOCK_TEXELS];
+    uint32_t error = FitBC1Indices(rgba, color0, color1, indices);
+
+    //one least squares pass on the indices the axis fit picked
+    constexpr float INDEX_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float weights[BLOCK_TEXELS];
+
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        weights[i] = INDEX_WEIGHTS[indices[i]];
+    }
+
+    if (LeastSquaresEndpoints(texels, weights, 3, endpoint0, endpoint1))
+    {
+        const uint16_t refined0 = To565(endpoint0);
+        const uint16_t refined1 = To565(endpoint1);
+        uint8_t refinedIndices[BLOCK_TEXELS];
+
+        if (FitBC1Indices(rgba, refined0, refined1, refinedIndices) < error)
+        {
+            color0 = refined0;
+            color1 = refined1;
+            memcpy(indices, refinedIndices, sizeof(indices));
+        }
+    }
+
+    //color0 <= color1 would switch the block to three colours plus transparent black
+    if (color0 < color1)
+    {
+        swap(color0, color1);
+
+        for (uint8_t& index : indices)
+        {
+            index ^= 1;
+        }
+    }
+    else if (color0 == color1)
+    {
+        memset(indices, 0, sizeof(indices));
+    }
+
+    BitWriter writer(out, 8);
+    writer.Write(color0, 16);
+    writer.Write(color1, 16);
+
+    for (uint8_t index : indices)
+    {
+        writer.Write(index, 2);
+    }
+}
+
+void BlockCompression::EncodeBC3(const uint8_t* rgba, uint8_t* out)
+{
+    EncodeBC4(rgba, 3, out);
+    EncodeBC1(rgba, out + 8);
+}
+
+void BlockCompression::EncodeBC5(const uint8_t* rgba, uint8_t* out)
+{
+    EncodeBC4(rgba, 0, out);
+    EncodeBC4(rgba, 1, out + 8);
+}
+
+void BlockCompression::EncodeBC4(const uint8_t* rgba, uint32_t channel, uint8_t* out)
+{
+    uint8_t values[BLOCK_TEXELS];
+    uint8_t minValue = 255;
+    uint8_t maxValue = 0;
+
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        values[i] = rgba[i * 4 + channel];
+        minValue = std::min(minValue, values[i]);
+        maxValue = std::max(maxValue, values[i]);
+    }
+
+    //value0 > value1 picks the eight value mode, six of them interpolated
+    int palette[8];
+    palette[0] = maxValue;
+    palette[1] = minValue;
+
+    for (int i = 1; i <= 6; ++i)
+    {
+        palette[i + 1] = ((7 - i) * maxValue + i * minValue + 3) / 7;
+    }
+
+    BitWriter writer(out, 8);
+    writer.Write(maxValue, 8);
+    writer.Write(minValue, 8);
+
+    for (uint8_t value : values)
+    {
+        uint32_t best = 0;
+        int bestError = numeric_limits<int>::max();
+
+        for (uint32_t p = 0; p < 8 && maxValue != minValue; ++p)
+        {
+            const int error = abs(value - palette[p]);
+
+            if (error < bestError)
+            {
+                bestError = error;
+                best = p;
+            }
+        }
+
+        writer.Write(best, 3);
+    }
+}
+
+//7 bit endpoint plus a shared p-bit, tries both p-bits and keeps whichever lands closer
+static void QuantizeMode6(const float endpoint[4], uint8_t quantized[4], uint8_t& pBit)
+{
+    float bestError = numeric_limits<float>::max();
+
+    for (uint8_t p = 0; p < 2; ++p)
+    {
+        uint8_t candidate[4];
+        float error = 0;
+
+        for (int c = 0; c < 4; ++c)
+        {
+            candidate[c] = static_cast<uint8_t>(clamp<long>(lround((endpoint[c] - p) * 0.5f), 0, 127));
+
+            const float diff = static_cast<float>((candidate[c] << 1) | p) - endpoint[c];
+            error += diff * diff;
+        }
+
+        if (error < bestError)
+        {
+            bestError = error;
+            pBit = p;
+            memcpy(quantized, candidate, 4);
+        }
+    }
+}
+
+static uint32_t FitMode6Indices(const uint8_t* rgba, const uint8_t quantized[2][4], const uint8_t pBits[2], uint8_t indices[BLOCK_TEXELS])
+{
+    int palette[16][4];
+
+    for (int c = 0; c < 4; ++c)
+    {
+        const uint32_t e0 = (quantized[0][c] << 1) | pBits[0];
+        const uint32_t e1 = (quantized[1][c] << 1) | pBits[1];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            palette[i][c] = static_cast<int>(((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6);
+        }
+    }
+
+    uint32_t totalError = 0;
+
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        uint32_t bestError = numeric_limits<uint32_t>::max();
+
+        for (uint8_t p = 0; p < 16; ++p)
+        {
+            uint32_t error = 0;
+
+            for (int c = 0; c < 4; ++c)
+            {
+                const int diff = rgba[i * 4 + c] - palette[p][c];
+                error += diff * diff;
+            }
+
+            if (error < bestError)
+            {
+                bestError = error;
+                indices[i] = p;
+            }
+        }
+
+        totalError += bestError;
+    }
+
+    return totalError;
+}
+
+void BlockCompression::EncodeBC7(const uint8_t* rgba, uint8_t* out)
+{
+    float texels[BLOCK_TEXELS][4];
+    ToFloat(rgba, texels);
+
+    //mode 6 interpolates from endpoint 0 to 1, so the low end of the axis goes first
+    float endpoints[2][4];
+    FitEndpoints(texels, 4, endpoints[1], endpoints[0]);
+
+    uint8_t quantized[2][4];
+    uint8_t pBits[2];
+    QuantizeMode6(endpoints[0], quantized[0], pBits[0]);
+    QuantizeMode6(endpoints[1], quantized[1], pBits[1]);
+
+    uint8_t indices[BLOCK_TEXELS];
+    uint32_t error = FitMode6Indices(rgba, quantized, pBits, indices);
+
+    float weights[BLOCK_TEXELS];
+
+    for (int i = 0; i < BLOCK_TEXELS; ++i)
+    {
+        weights[i] = 1.0f - BC7_WEIGHTS[indices[i]] / 64.0f;
+    }
+
+    if (error > 0 && LeastSquaresEndpoints(texels, weights, 4, endpoints[0], endpoints[1]))
+    {
+        uint8_t refined[2][4];
+        uint8_t refinedPBits[2];
+        uint8_t refinedIndices[BLOCK_TEXELS];
+        QuantizeMode6(endpoints[0], refined[0], refinedPBits[0]);
+        QuantizeMode6(endpoints[1], refined[1], refinedPBits[1]);
+
+        if (FitMode6Indices(rgba, refined, refinedPBits, refinedIndices) < error)
+        {
+            memcpy(quantized, refined, sizeof(quantized));
+            memcpy(pBits, refinedPBits, sizeof(pBits));
+            memcpy(indices, refinedIndices, sizeof(indices));
+        }
+    }
+
+    //the first index only has room for 3 bits, so its top bit has to be 0
+    if (indices[0] & 8)
+    {
+        swap(quantized[0], quantized[1]);
+        swap(pBits[0], pBits[1]);
+
+        for (uint8_t& index : indices)
+        {
+            index = 15 - index;
+        }
+    }
+
+    BitWriter writer(out, 16);
+    //mode 6 is six zero bits followed by a one
+    writer.Write(1 << 6, 7);
+
+    for (int c = 0; c < 4; ++c)
+    {
+        writer.Write(quantized[0][c], 7);
+        writer.Write(quantized[1][c], 7);
+    }
+
+    writer.Write(pBits[0], 1);
+    writer.Write(pBits[1], 1);
+    writer.Write(indices[0], 3);
+
+    for (int i = 1; i < BLOCK_TEXELS; ++i)
+    {
+        writer.Write(indices[i], 4);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+enum class BlockFormat : uint8_t
+{
+	BC1, //RGB, 8 bytes per block
+	BC3, //RGBA, BC1 colour plus a BC4 alpha block, 16 bytes per block
+	BC5, //two BC4 channels (red, green) for tangent space normals, 16 bytes per block
+	BC7  //RGBA, 16 bytes per block, only mode 6 is encoded
+};
+
+//CPU encoders for one 4x4 block at a time, texels come in as 16 RGBA8 values in row order
+class BlockCompression
+{
+public:
+	static uint32_t BlockSize(BlockFormat format);
+	static void EncodeBlock(BlockFormat format, const uint8_t* rgba, uint8_t* out);
+
+	static void EncodeBC1(const uint8_t* rgba, uint8_t* out);
+	static void EncodeBC3(const uint8_t* rgba, uint8_t* out);
+	static void EncodeBC5(const uint8_t* rgba, uint8_t* out);
+	static void EncodeBC7(const uint8_t* rgba, uint8_t* out);
+
+private:
+	//one channel of the block, read every fourth byte starting at channel
+	static void EncodeBC4(const uint8_t* rgba, uint32_t channel, uint8_t* out);
+};
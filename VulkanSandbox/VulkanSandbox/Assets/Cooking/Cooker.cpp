@@ -0,0 +1,388 @@
+#include "Cooker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+
+#include "ModelCooker.h"
+#include "ShaderCooker.h"
+#include "TextureCooker.h"
+#include "../Graphics/Model.h"
+#include "../Graphics/ModelFile.h"
+#include "../Graphics/TextureFile.h"
+#include "../../Utils/CLogger.h"
+#include "../../Utils/JobSystem.h"
+#include "../../Utils/utils.h"
+
+using namespace std;
+
+static string Lowercase(string text)
+{
+    transform(text.begin(), text.end(), text.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+    return text;
+}
+
+const vector<CookRule>& Cooker::GetRules()
+{
+    static const vector<CookRule> rules = {
+        {
+            "Texture", TextureFileHeader::VERSION,
+            "filter=" + to_string(static_cast<int>(TextureCooker::MIP_FILTER)),
+            { ".png", ".jpg", ".jpeg", ".tga" },
+            TextureCooker::CookedPath,
+            TextureCooker::Cook,
+            nullptr
+        },
+        {
+            "Model", ModelFileHeader::VERSION,
+            "lods=" + to_string(Model::MAX_LODS) + " reduction=" + to_string(Model::LOD_MIN_REDUCTION) + " step=" + to_string(Model::LOD_MAX_STEP_ERROR),
+            { ".obj", ".fbx", ".gltf", ".glb" },
+            ModelCooker::CookedPath,
+            ModelCooker::Cook,
+            nullptr
+        },
+        {
+            "Shader", 1,
+            "optimize=performance",
+            vector<string>(begin(ShaderCooker::EXTENSIONS), end(ShaderCooker::EXTENSIONS)),
+            ShaderCooker::CookedPath,
+            ShaderCooker::Cook,
+            ShaderCooker::FindIncludes
+        } };
+
+    return rules;
+}
+
+const CookRule* Cooker::FindRule(const filesystem::path& source)
+{
+    const string extension = Lowercase(source.extension().string());
+
+    for (const CookRule& rule : GetRules())
+    {
+        if (find(rule.extensions.begin(), rule.extensions.end(), extension) != rule.extensions.end())
+        {
+            return &rule;
+        }
+    }
+
+    return nullptr;
+}
+
+vector<filesystem::path> Cooker::CookAll(const vector<filesystem::path>& roots)
+{
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    vector<CookStep> steps;
+
+    for (const filesystem::path& root : roots)
+    {
+        if (!filesystem::exists(root))
+        {
+            continue;
+        }
+
+        for (const filesystem::directory_entry& fileIt : filesystem::recursive_directory_iterator(root))
+        {
+            const CookRule* rule = fileIt.is_regular_file() ? FindRule(fileIt.path()) : nullptr;
+
+            if (!rule)
+            {
+                continue;
+            }
+
+            CookStep step{ rule, fileIt.path().lexically_normal(), rule->output(fileIt.path()), { fileIt.path().lexically_normal() } };
+
+            if (rule->dependencies)
+            {
+                const vector<filesystem::path> dependencies = rule->dependencies(step.source);
+                step.inputs.insert(step.inputs.end(), dependencies.begin(), dependencies.end());
+            }
+
+            steps.push_back(move(step));
+        }
+    }
+
+    const Manifest previous = LoadManifest();
+    Manifest manifest;
+
+    //inputs shared between steps (shader includes) only get hashed once
+    vector<string> inputPaths;
+
+    for (const CookStep& step : steps)
+    {
+        for (const filesystem::path& input : step.inputs)
+        {
+            inputPaths.push_back(input.generic_string());
+        }
+    }
+
+    sort(inputPaths.begin(), inputPaths.end());
+    inputPaths.erase(unique(inputPaths.begin(), inputPaths.end()), inputPaths.end());
+
+    vector<InputRecord> records(inputPaths.size());
+    atomic<uint32_t> hashedCount = 0;
+
+    JobSystem::ParallelFor(inputPaths.size(), 8, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                error_code error;
+                InputRecord& record = records[i];
+                record.size = filesystem::file_size(inputPaths[i], error);
+
+                //a missing input hashes as 0, whatever depends on it fails to cook and stays dirty
+                if (error)
+                {
+                    record = {};
+                    continue;
+                }
+
+                record.writeTime = filesystem::last_write_time(inputPaths[i], error).time_since_epoch().count();
+
+                auto it = previous.inputs.find(inputPaths[i]);
+
+                if (it != previous.inputs.end() && it->second.size == record.size && it->second.writeTime == record.writeTime)
+                {
+                    record.hash = it->second.hash;
+                    continue;
+                }
+
+                vector<char> data;
+                loadWholeBinFile(inputPaths[i].c_str(), data);
+                record.hash = HashBytes(data);
+                hashedCount++;
+            }
+        });
+
+    for (size_t i = 0; i < inputPaths.size(); ++i)
+    {
+        if (records[i].hash != 0)
+        {
+            manifest.inputs[inputPaths[i]] = records[i];
+        }
+    }
+
+    vector<CookStep*> dirty;
+
+    for (CookStep& step : steps)
+    {
+        const string ruleKey = string(step.rule->name) + '\n' + to_string(step.rule->version) + '\n' + step.rule->settings;
+        step.key = HashBytes(ruleKey);
+
+        for (const filesystem::path& input : step.inputs)
+        {
+            const string path = input.generic_string();
+            const InputRecord& record = records[lower_bound(inputPaths.begin(), inputPaths.end(), path) - inputPaths.begin()];
+
+            step.key = HashBytes(path, step.key);
+            step.key = HashBytes(span(reinterpret_cast<const char*>(&record.hash), sizeof(record.hash)), step.key);
+        }
+
+        auto it = previous.outputs.find(step.output.generic_string());
+
+        if (it == previous.outputs.end() || it->second != step.key || !filesystem::exists(step.output))
+        {
+            dirty.push_back(&step);
+        }
+    }
+
+    //a texture already spreads its mips and block rows over the workers, so one output per job is enough
+    JobSystem::ParallelFor(dirty.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                dirty[i]->succeeded = dirty[i]->rule->cook(dirty[i]->source, dirty[i]->output);
+            }
+        });
+
+    uint32_t failedCount = 0;
+
+    for (const CookStep& step : steps)
+    {
+        if (step.succeeded)
+        {
+            manifest.outputs[step.output.generic_string()] = step.key;
+        }
+        else
+        {
+            failedCount++;
+        }
+    }
+
+    vector<filesystem::path> cooked;
+
+    for (const CookStep* step : dirty)
+    {
+        if (step->succeeded)
+        {
+            cooked.push_back(step->output);
+        }
+    }
+
+    if (hashedCount > 0 || !dirty.empty() || manifest.inputs.size() != previous.inputs.size() || manifest.outputs.size() != previous.outputs.size())
+    {
+        SaveManifest(manifest);
+    }
+
+    Log("Cooked assets", { {"Outputs", steps.size()}, {"Cooked", dirty.size() - failedCount}, {"Failed", failedCount},
+        {"Inputs hashed", hashedCount.load()}, {"Milliseconds", chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()} });
+
+    return cooked;
+}
+
+uint64_t Cooker::HashBytes(span<const char> data, uint64_t seed)
+{
+    constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+
+    uint64_t hash = seed ^ (data.size() * PRIME_1);
+    size_t i = 0;
+
+    for (; i + 8 <= data.size(); i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data.data() + i, sizeof(word));
+
+        hash = rotl(hash ^ (word * PRIME_2), 31) * PRIME_1;
+    }
+
+    for (; i < data.size(); ++i)
+    {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * PRIME_1;
+    }
+
+    //final avalanche so nearby inputs don't give nearby hashes
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+//one entry per line, the path goes last so it may contain spaces
+//KCOOK <version>
+//in <hash> <size> <write time> <path>
+//out <key> <path>
+Cooker::Manifest Cooker::LoadManifest()
+{
+    Manifest manifest;
+
+    if (!filesystem::exists(MANIFEST_PATH))
+    {
+        return manifest;
+    }
+
+    vector<char> text;
+    loadWholeTextFile(MANIFEST_PATH.string().c_str(), text);
+
+    string_view content(text.data());
+
+    //pops the next space separated field off line
+    auto field = [](string_view& line)
+    {
+        const size_t space = line.find(' ');
+        const string_view value = line.substr(0, space);
+        line = space == string_view::npos ? string_view() : line.substr(space + 1);
+
+        return value;
+    };
+
+    auto number = [&](string_view& line, auto& result, int base)
+    {
+        const string_view value = field(line);
+        from_chars(value.data(), value.data() + value.size(), result, base);
+    };
+
+    bool valid = false;
+
+    while (!content.empty())
+    {
+        const size_t lineEnd = content.find('\n');
+        string_view line = content.substr(0, lineEnd);
+        content = lineEnd == string_view::npos ? string_view() : content.substr(lineEnd + 1);
+
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+
+        const string_view type = field(line);
+
+        if (type == "KCOOK")
+        {
+            uint32_t version = 0;
+            number(line, version, 10);
+            valid = version == MANIFEST_VERSION;
+        }
+        else if (!valid)
+        {
+            break;
+        }
+        else if (type == "in")
+        {
+            InputRecord record;
+            number(line, record.hash, 16);
+            number(line, record.size, 10);
+            number(line, record.writeTime, 10);
+            manifest.inputs[string(line)] = record;
+        }
+        else if (type == "out")
+        {
+            uint64_t key = 0;
+            number(line, key, 16);
+            manifest.outputs[string(line)] = key;
+        }
+    }
+
+    //a manifest from another version can't vouch for anything, everything recooks
+    if (!valid)
+    {
+        return {};
+    }
+
+    return manifest;
+}
+
+void Cooker::SaveManifest(const Manifest& manifest)
+{
+    filesystem::create_directories(MANIFEST_PATH.parent_path());
+
+    //written next to the real one and swapped in, so a crash mid-write never leaves a half manifest behind
+    filesystem::path tempPath = MANIFEST_PATH;
+    tempPath += ".tmp";
+
+    FILE* file = nullptr;
+    errno_t err = fopen_s(&file, tempPath.string().c_str(), "wb");
+
+    Assert(file, "Failed to open cook manifest for writing", { {"file", tempPath.string()}, {"error code", err} });
+
+    //sorted so the file diffs cleanly between runs
+    vector<pair<string, InputRecord>> inputs(manifest.inputs.begin(), manifest.inputs.end());
+    vector<pair<string, uint64_t>> outputs(manifest.outputs.begin(), manifest.outputs.end());
+    sort(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    sort(outputs.begin(), outputs.end());
+
+    fprintf(file, "KCOOK %u\n", MANIFEST_VERSION);
+
+    for (const auto& [path, record] : inputs)
+    {
+        fprintf(file, "in %016llx %llu %lld %s\n", static_cast<unsigned long long>(record.hash), static_cast<unsigned long long>(record.size),
+            static_cast<long long>(record.writeTime), path.c_str());
+    }
+
+    for (const auto& [path, key] : outputs)
+    {
+        fprintf(file, "out %016llx %s\n", static_cast<unsigned long long>(key), path.c_str());
+    }
+
+    fclose(file);
+
+    filesystem::rename(tempPath, MANIFEST_PATH);
+}
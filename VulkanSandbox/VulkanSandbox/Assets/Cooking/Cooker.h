@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//How one kind of source file turns into its cooked output
+struct CookRule
+{
+	const char* name;
+	//bump whenever the same inputs would now cook to something different, every output of the rule recooks
+	uint32_t version;
+	//anything else the output depends on, so changing a setting recooks as well
+	std::string settings;
+	//lower case, with the dot
+	std::vector<std::string> extensions;
+	std::filesystem::path (*output)(const std::filesystem::path& source);
+	//false when the source doesn't cook, it is tried again on the next run
+	bool (*cook)(const std::filesystem::path& source, const std::filesystem::path& dest);
+	//inputs besides the source itself, null when there are none
+	std::vector<std::filesystem::path> (*dependencies)(const std::filesystem::path& source);
+};
+
+//Cooks source assets into ./Build, keeping a manifest of what every output was cooked from
+//An output's key hashes its rule, version and settings with the contents of each of its inputs,
+//it only recooks when that key changes, so timestamps don't matter and a cooked Build/ plus its manifest
+//can be carried over between machines (CI caches) as long as the sources match
+class Cooker
+{
+public:
+	//cooks every file under roots that a rule handles and whose output is missing or out of date, spread over the job system
+	//returns the outputs that were cooked, one CookAll at a time since they share the manifest
+	static std::vector<std::filesystem::path> CookAll(const std::vector<std::filesystem::path>& roots);
+
+	static const std::vector<CookRule>& GetRules();
+	//the rule that cooks source, null if nothing does
+	static const CookRule* FindRule(const std::filesystem::path& source);
+
+	//64 bit hash of file contents, not cryptographic
+	static uint64_t HashBytes(std::span<const char> data, uint64_t seed = 0);
+
+	//everything the game's assets are cooked from
+	inline static const std::vector<std::filesystem::path> SOURCE_ROOTS = { "Data/Textures", "Data/Models", "Data/Shaders" };
+	inline static const std::filesystem::path MANIFEST_PATH = "Build/Cook.manifest";
+	constexpr static uint32_t MANIFEST_VERSION = 1;
+
+private:
+	//an input's hash is only recomputed when its size or write time changed since the last run
+	struct InputRecord
+	{
+		uint64_t size = 0;
+		int64_t writeTime = 0;
+		uint64_t hash = 0;
+	};
+
+	struct Manifest
+	{
+		//keyed by generic path
+		std::unordered_map<std::string, InputRecord> inputs;
+		std::unordered_map<std::string, uint64_t> outputs;
+	};
+
+	struct CookStep
+	{
+		const CookRule* rule;
+		std::filesystem::path source;
+		std::filesystem::path output;
+		//source first
+		std::vector<std::filesystem::path> inputs;
+		uint64_t key = 0;
+		bool succeeded = true;
+	};
+
+	static Manifest LoadManifest();
+	static void SaveManifest(const Manifest& manifest);
+};
@@ -0,0 +1,499 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <immintrin.h>
+
+#include "../../Utils/JobSystem.h"
+
+using namespace std;
+
+//the filter passes are written once against these, AVX2 does 8 floats at a time and SSE2 4
+#if defined(__AVX2__)
+using VFloat = __m256;
+constexpr uint32_t SIMD_WIDTH = 8;
+
+static VFloat VLoad(const float* src) { return _mm256_loadu_ps(src); }
+static void VStore(float* dst, VFloat v) { _mm256_storeu_ps(dst, v); }
+static VFloat VSet(float f) { return _mm256_set1_ps(f); }
+static VFloat VSub(VFloat a, VFloat b) { return _mm256_sub_ps(a, b); }
+static VFloat VMul(VFloat a, VFloat b) { return _mm256_mul_ps(a, b); }
+static VFloat VDiv(VFloat a, VFloat b) { return _mm256_div_ps(a, b); }
+static VFloat VMax(VFloat a, VFloat b) { return _mm256_max_ps(a, b); }
+static VFloat VSqrt(VFloat v) { return _mm256_sqrt_ps(v); }
+static VFloat VMulAdd(VFloat a, VFloat b, VFloat c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+using VFloat = __m128;
+constexpr uint32_t SIMD_WIDTH = 4;
+
+static VFloat VLoad(const float* src) { return _mm_loadu_ps(src); }
+static void VStore(float* dst, VFloat v) { _mm_storeu_ps(dst, v); }
+static VFloat VSet(float f) { return _mm_set1_ps(f); }
+static VFloat VSub(VFloat a, VFloat b) { return _mm_sub_ps(a, b); }
+static VFloat VMul(VFloat a, VFloat b) { return _mm_mul_ps(a, b); }
+static VFloat VDiv(VFloat a, VFloat b) { return _mm_div_ps(a, b); }
+static VFloat VMax(VFloat a, VFloat b) { return _mm_max_ps(a, b); }
+static VFloat VSqrt(VFloat v) { return _mm_sqrt_ps(v); }
+static VFloat VMulAdd(VFloat a, VFloat b, VFloat c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+
+//texels per job, rows are grouped until a chunk has about this many
+constexpr size_t TEXELS_PER_JOB = 64 * 1024;
+//widest reach of a kernel tap into the even/odd split of a row
+constexpr int32_t ROW_PADDING = 2;
+constexpr float KAISER_ALPHA = 4.0f;
+constexpr float MIN_NORMAL_LENGTH = 1e-6f;
+
+static float SrgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static const array<float, 256> SRGB_TO_LINEAR = []()
+    {
+        array<float, 256> table{};
+
+        for (size_t i = 0; i < table.size(); ++i)
+        {
+            table[i] = SrgbToLinear(i / 255.0f);
+        }
+
+        return table;
+    }();
+
+//entry i is the linear value halfway between srgb i - 1 and i, so a binary search rounds in srgb space
+static const array<float, 256> SRGB_THRESHOLDS = []()
+    {
+        array<float, 256> table{};
+
+        for (size_t i = 1; i < table.size(); ++i)
+        {
+            table[i] = SrgbToLinear((i - 0.5f) / 255.0f);
+        }
+
+        return table;
+    }();
+
+static uint8_t LinearToSrgb(float linear)
+{
+    uint32_t index = 0;
+
+    for (uint32_t step = 128; step > 0; step >>= 1)
+    {
+        if (linear >= SRGB_THRESHOLDS[index + step])
+        {
+            index += step;
+        }
+    }
+
+    return static_cast<uint8_t>(index);
+}
+
+static uint8_t FloatToUnorm(float value)
+{
+    return static_cast<uint8_t>(clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+//zeroth order modified bessel function, the series converges well before 20 terms for our alpha
+static double BesselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 20; ++k)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+static size_t RowsPerJob(uint32_t width)
+{
+    return std::max<size_t>(TEXELS_PER_JOB / std::max(width, 1u), 1);
+}
+
+vector<MipImage> MipGenerator::Generate(MipImage source, MipFilter filter, MipColorSpace colorSpace, bool simd)
+{
+    const uint32_t mipCount = MipCount(source.width, source.height);
+    const Kernel& kernel = GetKernel(filter);
+
+    vector<MipImage> mips(mipCount);
+    auto level = make_shared<const FloatImage>(ToFloat(source, colorSpace, simd));
+    mips[0] = move(source);
+
+    //each level needs the one above it, but converting a finished level back to bytes overlaps with filtering the next
+    JobCounter counter;
+
+    for (uint32_t mip = 1; mip < mipCount; ++mip)
+    {
+        FloatImage next = Downsample(*level, kernel, simd);
+
+        if (colorSpace == MipColorSpace::Normal)
+        {
+            Renormalize(next, simd);
+        }
+
+        level = make_shared<const FloatImage>(move(next));
+
+        JobSystem::Submit([&mips, mip, level, colorSpace, simd]()
+            {
+                mips[mip] = ToBytes(*level, colorSpace, simd);
+            }, counter);
+    }
+
+    JobSystem::Wait(counter);
+
+    return mips;
+}
+
+uint32_t MipGenerator::MipCount(uint32_t width, uint32_t height)
+{
+    return static_cast<uint32_t>(floor(log2(std::max(width, height)))) + 1;
+}
+
+const MipGenerator::Kernel& MipGenerator::GetKernel(MipFilter filter)
+{
+    static const Kernel box{ { 0, 1 }, { 0.5f, 0.5f } };
+
+    //sinc cut off at the new nyquist, windowed over 4 source texels either side of the dst centre
+    static const Kernel kaiser = []()
+        {
+            Kernel kernel;
+            const double radius = 4.0;
+            double sum = 0;
+
+            for (int32_t offset = -3; offset <= 4; ++offset)
+            {
+                //source texel centre relative to the dst texel centre, in source texels
+                const double d = offset - 0.5;
+                const double x = d * 0.5 * 3.14159265358979323846;
+                const double sinc = sin(x) / x;
+                const double t = d / radius;
+                const double window = BesselI0(KAISER_ALPHA * sqrt(1.0 - t * t)) / BesselI0(KAISER_ALPHA);
+
+                kernel.offsets.push_back(offset);
+                kernel.weights.push_back(static_cast<float>(sinc * window));
+                sum += sinc * window;
+            }
+
+            for (float& weight : kernel.weights)
+            {
+                weight = static_cast<float>(weight / sum);
+            }
+
+            return kernel;
+        }();
+
+    return filter == MipFilter::Kaiser ? kaiser : box;
+}
+
+MipGenerator::FloatImage MipGenerator::ToFloat(const MipImage& image, MipColorSpace colorSpace, bool simd)
+{
+    FloatImage result;
+    result.width = image.width;
+    result.height = image.height;
+
+    const size_t texelCount = static_cast<size_t>(image.width) * image.height;
+
+    for (vector<float>& plane : result.planes)
+    {
+        plane.resize(texelCount);
+    }
+
+    JobSystem::ParallelFor(image.height, RowsPerJob(image.width), [&](size_t begin, size_t end)
+        {
+            const size_t first = begin * image.width;
+            const size_t last = end * image.width;
+            size_t i = first;
+
+#if defined(__AVX2__)
+            if (simd)
+            {
+                const __m256i byteMask = _mm256_set1_epi32(0xff);
+                const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+
+                for (; i + 8 <= last; i += 8)
+                {
+                    const __m256i texels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&image.rgba[i * 4]));
+
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const __m256i value = _mm256_and_si256(_mm256_srli_epi32(texels, c * 8), byteMask);
+                        const __m256 converted = colorSpace == MipColorSpace::Srgb && c < 3
+                            ? _mm256_i32gather_ps(SRGB_TO_LINEAR.data(), value, 4)
+                            : _mm256_mul_ps(_mm256_cvtepi32_ps(value), scale);
+
+                        _mm256_storeu_ps(&result.planes[c][i], converted);
+                    }
+                }
+            }
+#endif
+
+            for (; i < last; ++i)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    const uint8_t value = image.rgba[i * 4 + c];
+                    result.planes[c][i] = colorSpace == MipColorSpace::Srgb && c < 3 ? SRGB_TO_LINEAR[value] : value / 255.0f;
+                }
+            }
+        });
+
+    return result;
+}
+
+MipImage MipGenerator::ToBytes(const FloatImage& image, MipColorSpace colorSpace, bool simd)
+{
+    MipImage result{ vector<uint8_t>(static_cast<size_t>(image.width) * image.height * 4), image.width, image.height };
+
+    JobSystem::ParallelFor(image.height, RowsPerJob(image.width), [&](size_t begin, size_t end)
+        {
+            const size_t first = begin * image.width;
+            const size_t last = end * image.width;
+            size_t i = first;
+
+#if defined(__AVX2__)
+            if (simd)
+            {
+                const __m256 zero = _mm256_setzero_ps();
+                const __m256 one = _mm256_set1_ps(1.0f);
+                const __m256 scale = _mm256_set1_ps(255.0f);
+                const __m256 half = _mm256_set1_ps(0.5f);
+
+                for (; i + 8 <= last; i += 8)
+                {
+                    __m256i texels = _mm256_setzero_si256();
+
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const __m256 value = _mm256_loadu_ps(&image.planes[c][i]);
+                        __m256i converted;
+
+                        if (colorSpace == MipColorSpace::Srgb && c < 3)
+                        {
+                            //same binary search as LinearToSrgb, one gather per step for all 8 texels
+                            converted = _mm256_setzero_si256();
+
+                            for (int step = 128; step > 0; step >>= 1)
+                            {
+                                const __m256i candidate = _mm256_add_epi32(converted, _mm256_set1_epi32(step));
+                                const __m256 threshold = _mm256_i32gather_ps(SRGB_THRESHOLDS.data(), candidate, 4);
+                                const __m256 above = _mm256_cmp_ps(value, threshold, _CMP_GE_OQ);
+
+                                converted = _mm256_blendv_epi8(converted, candidate, _mm256_castps_si256(above));
+                            }
+                        }
+                        else
+                        {
+                            const __m256 clamped = _mm256_min_ps(_mm256_max_ps(value, zero), one);
+                            converted = _mm256_cvttps_epi32(_mm256_fmadd_ps(clamped, scale, half));
+                        }
+
+                        texels = _mm256_or_si256(texels, _mm256_slli_epi32(converted, c * 8));
+                    }
+
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&result.rgba[i * 4]), texels);
+                }
+            }
+#endif
+
+            for (; i < last; ++i)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float value = image.planes[c][i];
+                    result.rgba[i * 4 + c] = colorSpace == MipColorSpace::Srgb && c < 3 ? LinearToSrgb(value) : FloatToUnorm(value);
+                }
+            }
+        });
+
+    return result;
+}
+
+MipGenerator::FloatImage MipGenerator::Downsample(const FloatImage& image, const Kernel& kernel, bool simd)
+{
+    const uint32_t width = std::max(image.width / 2, 1u);
+    const uint32_t height = std::max(image.height / 2, 1u);
+
+    //horizontal pass first, the vertical one then only has half as many columns to filter
+    FloatImage horizontal;
+    horizontal.width = width;
+    horizontal.height = image.height;
+
+    if (image.width == 1)
+    {
+        horizontal.planes = image.planes;
+    }
+    else
+    {
+        for (vector<float>& plane : horizontal.planes)
+        {
+            plane.resize(static_cast<size_t>(width) * image.height);
+        }
+
+        JobSystem::ParallelFor(image.height, RowsPerJob(image.width), [&](size_t begin, size_t end)
+            {
+                //splitting the row into even and odd texels turns the stride 2 taps into contiguous loads
+                vector<float> even(width + ROW_PADDING * 2);
+                vector<float> odd(width + ROW_PADDING * 2);
+                const int32_t lastX = static_cast<int32_t>(image.width) - 1;
+
+                for (size_t y = begin; y < end; ++y)
+                {
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const float* src = &image.planes[c][y * image.width];
+
+                        for (int32_t x = -ROW_PADDING; x < static_cast<int32_t>(width) + ROW_PADDING; ++x)
+                        {
+                            even[x + ROW_PADDING] = src[clamp(x * 2, 0, lastX)];
+                            odd[x + ROW_PADDING] = src[clamp(x * 2 + 1, 0, lastX)];
+                        }
+
+                        FilterRow(&even[ROW_PADDING], &odd[ROW_PADDING], &horizontal.planes[c][y * width], width, kernel, simd);
+                    }
+                }
+            });
+    }
+
+    if (image.height == 1)
+    {
+        return horizontal;
+    }
+
+    FloatImage result;
+    result.width = width;
+    result.height = height;
+
+    for (vector<float>& plane : result.planes)
+    {
+        plane.resize(static_cast<size_t>(width) * height);
+    }
+
+    JobSystem::ParallelFor(height, RowsPerJob(width), [&](size_t begin, size_t end)
+        {
+            vector<const float*> rows(kernel.offsets.size());
+            const int32_t lastY = static_cast<int32_t>(image.height) - 1;
+
+            for (size_t y = begin; y < end; ++y)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    for (size_t tap = 0; tap < rows.size(); ++tap)
+                    {
+                        const int32_t srcY = clamp(static_cast<int32_t>(y) * 2 + kernel.offsets[tap], 0, lastY);
+                        rows[tap] = &horizontal.planes[c][static_cast<size_t>(srcY) * width];
+                    }
+
+                    SumTaps(rows.data(), &result.planes[c][y * width], width, kernel, simd);
+                }
+            }
+        });
+
+    return result;
+}
+
+void MipGenerator::Renormalize(FloatImage& image, bool simd)
+{
+    const size_t texelCount = static_cast<size_t>(image.width) * image.height;
+
+    JobSystem::ParallelFor(image.height, RowsPerJob(image.width), [&](size_t begin, size_t end)
+        {
+            float* x = image.planes[0].data();
+            float* y = image.planes[1].data();
+            float* z = image.planes[2].data();
+            const size_t last = std::min(end * image.width, texelCount);
+            size_t i = begin * image.width;
+
+            if (simd)
+            {
+                const VFloat two = VSet(2.0f);
+                const VFloat one = VSet(1.0f);
+                const VFloat half = VSet(0.5f);
+                const VFloat minLength = VSet(MIN_NORMAL_LENGTH);
+
+                for (; i + SIMD_WIDTH <= last; i += SIMD_WIDTH)
+                {
+                    const VFloat nx = VSub(VMul(VLoad(x + i), two), one);
+                    const VFloat ny = VSub(VMul(VLoad(y + i), two), one);
+                    const VFloat nz = VSub(VMul(VLoad(z + i), two), one);
+                    const VFloat length = VMax(VSqrt(VMulAdd(nx, nx, VMulAdd(ny, ny, VMul(nz, nz)))), minLength);
+                    const VFloat scale = VDiv(half, length);
+
+                    VStore(x + i, VMulAdd(nx, scale, half));
+                    VStore(y + i, VMulAdd(ny, scale, half));
+                    VStore(z + i, VMulAdd(nz, scale, half));
+                }
+            }
+
+            for (; i < last; ++i)
+            {
+                const float nx = x[i] * 2.0f - 1.0f;
+                const float ny = y[i] * 2.0f - 1.0f;
+                const float nz = z[i] * 2.0f - 1.0f;
+                const float scale = 0.5f / std::max(sqrt(nx * nx + ny * ny + nz * nz), MIN_NORMAL_LENGTH);
+
+                x[i] = nx * scale + 0.5f;
+                y[i] = ny * scale + 0.5f;
+                z[i] = nz * scale + 0.5f;
+            }
+        });
+}
+
+void MipGenerator::FilterRow(const float* even, const float* odd, float* dst, uint32_t width, const Kernel& kernel, bool simd)
+{
+    //tap offset 2k lands on even[x + k], 2k + 1 on odd[x + k]
+    const float* sources[MAX_TAPS];
+    const size_t tapCount = kernel.offsets.size();
+
+    for (size_t tap = 0; tap < tapCount; ++tap)
+    {
+        const int32_t offset = kernel.offsets[tap];
+        sources[tap] = offset % 2 == 0 ? even + offset / 2 : odd + (offset - 1) / 2;
+    }
+
+    SumTaps(sources, dst, width, kernel, simd);
+}
+
+void MipGenerator::SumTaps(const float* const* sources, float* dst, uint32_t width, const Kernel& kernel, bool simd)
+{
+    const size_t tapCount = kernel.offsets.size();
+    uint32_t x = 0;
+
+    if (simd)
+    {
+        VFloat weights[MAX_TAPS];
+
+        for (size_t tap = 0; tap < tapCount; ++tap)
+        {
+            weights[tap] = VSet(kernel.weights[tap]);
+        }
+
+        for (; x + SIMD_WIDTH <= width; x += SIMD_WIDTH)
+        {
+            VFloat sum = VMul(weights[0], VLoad(sources[0] + x));
+
+            for (size_t tap = 1; tap < tapCount; ++tap)
+            {
+                sum = VMulAdd(weights[tap], VLoad(sources[tap] + x), sum);
+            }
+
+            VStore(dst + x, sum);
+        }
+    }
+
+    for (; x < width; ++x)
+    {
+        float sum = 0;
+
+        for (size_t tap = 0; tap < tapCount; ++tap)
+        {
+            sum += kernel.weights[tap] * sources[tap][x];
+        }
+
+        dst[x] = sum;
+    }
+}
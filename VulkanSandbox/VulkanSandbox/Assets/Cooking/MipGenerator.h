@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class MipFilter : uint8_t
+{
+	//2x2 average, cheapest and what the GPU blit approximates
+	Box,
+	//8 tap windowed sinc, keeps lower mips sharper without aliasing
+	Kaiser
+};
+
+enum class MipColorSpace : uint8_t
+{
+	//rgb is filtered in linear space and converted back, alpha is linear
+	Srgb,
+	Linear,
+	//rgb holds a unit vector, it gets renormalized after every level
+	Normal
+};
+
+struct MipImage
+{
+	std::vector<uint8_t> rgba;
+	uint32_t width;
+	uint32_t height;
+};
+
+//Builds full mip chains for RGBA8 images on the CPU so the result doesn't depend on the driver's blit filtering
+//Levels are filtered separably in 32 bit float with AVX2 (SSE2 without it) and every level is split into rows on the JobSystem
+//the byte <-> float conversions gather from the sRGB tables so they only have AVX2 and scalar paths
+class MipGenerator
+{
+public:
+	//every mip down to 1x1, the source is mip 0
+	//simd off runs the scalar loops, only the benchmark wants that
+	static std::vector<MipImage> Generate(MipImage source, MipFilter filter, MipColorSpace colorSpace, bool simd = true);
+
+	static uint32_t MipCount(uint32_t width, uint32_t height);
+
+private:
+	struct FloatImage
+	{
+		//one plane per channel so each pass streams through contiguous floats
+		std::array<std::vector<float>, 4> planes;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	//the kaiser kernel is the widest
+	constexpr static size_t MAX_TAPS = 8;
+
+	struct Kernel
+	{
+		//texel offsets from 2 * dst, the dst texel sits between offset 0 and 1
+		std::vector<int32_t> offsets;
+		std::vector<float> weights;
+	};
+
+	static const Kernel& GetKernel(MipFilter filter);
+
+	static FloatImage ToFloat(const MipImage& image, MipColorSpace colorSpace, bool simd);
+	static MipImage ToBytes(const FloatImage& image, MipColorSpace colorSpace, bool simd);
+	static FloatImage Downsample(const FloatImage& image, const Kernel& kernel, bool simd);
+	static void Renormalize(FloatImage& image, bool simd);
+
+	//even and odd hold a row's texels split by parity so every tap is a contiguous run
+	static void FilterRow(const float* even, const float* odd, float* dst, uint32_t width, const Kernel& kernel, bool simd);
+	//dst[x] is the weighted sum of sources[tap][x]
+	static void SumTaps(const float* const* sources, float* dst, uint32_t width, const Kernel& kernel, bool simd);
+};
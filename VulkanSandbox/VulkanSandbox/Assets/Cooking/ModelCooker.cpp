@@ -0,0 +1,76 @@
+#include "ModelCooker.h"
+
+#include <vector>
+
+#include "../Graphics/Model.h"
+#include "../Graphics/ModelFile.h"
+#include "../../Utils/CLogger.h"
+#include "../../Utils/utils.h"
+
+using namespace std;
+
+bool ModelCooker::Cook(const filesystem::path& source, const filesystem::path& dest)
+{
+    Log("Cooking model...", { {"Model", source.string()}, {"Output Dest.", dest.string()} });
+
+    vector<char> fileData;
+    loadWholeBinFile(source.string().c_str(), fileData);
+
+    //the model keeps the source path so assimp still picks its importer by extension
+    Model model(source);
+
+    if (!model.DecodeSource(fileData))
+    {
+        return false;
+    }
+
+    ModelFileHeader header;
+    header.vertexCount = static_cast<uint32_t>(model._vertices.size());
+    header.indexCount = static_cast<uint32_t>(model._indices.size());
+    header.lodCount = static_cast<uint32_t>(model._lods.size());
+    header.meshletCount = static_cast<uint32_t>(model._meshlets.Count());
+    header.meshletVertexCount = static_cast<uint32_t>(model._meshlets.vertices.size());
+    header.meshletTriangleCount = static_cast<uint32_t>(model._meshlets.triangles.size());
+    header.boundsCenter[0] = model._boundsCenter.x;
+    header.boundsCenter[1] = model._boundsCenter.y;
+    header.boundsCenter[2] = model._boundsCenter.z;
+    header.boundsRadius = model._boundsRadius;
+
+    filesystem::create_directories(dest.parent_path());
+
+    FILE* file = nullptr;
+    errno_t err = fopen_s(&file, dest.string().c_str(), "wb");
+
+    Assert(file, "Failed to open cooked model for writing", { {"file", dest.string()}, {"error code", err} });
+
+    auto write = [&]<typename T>(const vector<T>& data)
+    {
+        fwrite(data.data(), sizeof(T), data.size(), file);
+    };
+
+    fwrite(&header, sizeof(header), 1, file);
+    write(model._vertices);
+    write(model._indices);
+    write(model._lods);
+    write(model._meshlets.bounds);
+    write(model._meshlets.cones);
+    write(model._meshlets.ranges);
+    write(model._meshlets.vertices);
+    write(model._meshlets.triangles);
+
+    const long cookedBytes = ftell(file);
+    fclose(file);
+
+    Log("Cooked model", { {"Model", source.string()}, {"Vertex count", header.vertexCount}, {"LOD count", header.lodCount},
+        {"Source bytes", fileData.size()}, {"Cooked bytes", cookedBytes} });
+
+    return true;
+}
+
+filesystem::path ModelCooker::CookedPath(const filesystem::path& source)
+{
+    filesystem::path outpath = filesystem::path("Build") / source.lexically_normal();
+    outpath += ".kmdl";
+
+    return outpath;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <filesystem>
+
+//Imports source models once at cook time and writes the processed result (LODs, meshlets, bounds)
+//as a .kmdl file (see ModelFile.h) that loads with a few memcpys
+class ModelCooker
+{
+public:
+	//false when the source doesn't import, the error is logged and dest is left alone
+	static bool Cook(const std::filesystem::path& source, const std::filesystem::path& dest);
+	//mirrors the source tree under ./Build like the textures and shaders
+	static std::filesystem::path CookedPath(const std::filesystem::path& source);
+};
@@ -0,0 +1,151 @@
+#include "ShaderCooker.h"
+
+#include <shaderc/shaderc.hpp>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../../Utils/CLogger.h"
+#include "../../Utils/utils.h"
+
+using namespace std;
+
+//resolves #include "..." against the including file's directory
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
+{
+public:
+    shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
+    {
+        Include* include = new Include;
+        include->path = (filesystem::path(requestingSource).parent_path() / requestedSource).lexically_normal().string();
+
+        if (filesystem::exists(include->path))
+        {
+            loadWholeBinFile(include->path.c_str(), include->content);
+        }
+        else
+        {
+            //shaderc reports an empty source name as a failed include, with the content as the message
+            const string message = "Include not found: " + include->path;
+            include->content.assign(message.begin(), message.end());
+            include->path.clear();
+        }
+
+        include->result = { include->path.c_str(), include->path.size(), include->content.data(), include->content.size(), include };
+
+        return &include->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* data) override
+    {
+        delete static_cast<Include*>(data->user_data);
+    }
+
+private:
+    struct Include
+    {
+        string path;
+        vector<char> content;
+        shaderc_include_result result;
+    };
+};
+
+bool ShaderCooker::Cook(const filesystem::path& source, const filesystem::path& dest)
+{
+    Log("Compiling shader...", { {"Shader", source.string()}, {"Output Dest.", dest.string()} });
+
+    const unordered_map<string, shaderc_shader_kind> kinds = {
+        {".vert", shaderc_glsl_vertex_shader},
+        {".frag", shaderc_glsl_fragment_shader},
+        {".tesc", shaderc_glsl_tess_control_shader},
+        {".tese", shaderc_glsl_tess_evaluation_shader},
+        {".geom", shaderc_glsl_geometry_shader},
+        {".comp", shaderc_glsl_compute_shader} };
+
+    vector<char> inData;
+    loadWholeBinFile(source.string().c_str(), inData);
+
+    shaderc::CompileOptions options;
+    options.SetIncluder(make_unique<ShaderIncluder>());
+    options.SetOptimizationLevel(shaderc_optimization_level_performance);
+
+    //one compiler per call, cooks run on several threads at once
+    shaderc::Compiler compiler;
+    const shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(inData.data(), inData.size(),
+        kinds.at(source.extension().string()), source.string().c_str(), options);
+
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+    {
+        Error("Shader compiler returned an error", { {"Shader", source.string()}, {"Return code", result.GetCompilationStatus()} });
+        Error(result.GetErrorMessage());
+
+        return false;
+    }
+
+    filesystem::create_directories(dest.parent_path());
+
+    FILE* file = nullptr;
+    errno_t err = fopen_s(&file, dest.string().c_str(), "wb");
+
+    Assert(file, "Failed to open compiled shader for writing", { {"file", dest.string()}, {"error code", err} });
+
+    fwrite(result.cbegin(), sizeof(uint32_t), result.cend() - result.cbegin(), file);
+    fclose(file);
+
+    return true;
+}
+
+filesystem::path ShaderCooker::CookedPath(const filesystem::path& source)
+{
+    filesystem::path outpath = filesystem::path("Build") / source.lexically_normal();
+    outpath += ".spv";
+
+    return outpath;
+}
+
+vector<filesystem::path> ShaderCooker::FindIncludes(const filesystem::path& source)
+{
+    vector<filesystem::path> includes;
+    unordered_set<string> seen;
+    vector<filesystem::path> toScan = { source };
+
+    while (!toScan.empty())
+    {
+        const filesystem::path file = toScan.back();
+        toScan.pop_back();
+
+        if (!filesystem::exists(file))
+        {
+            continue;
+        }
+
+        vector<char> text;
+        loadWholeTextFile(file.string().c_str(), text);
+
+        const string_view content(text.data());
+        size_t pos = 0;
+
+        while ((pos = content.find("#include", pos)) != string_view::npos)
+        {
+            const size_t open = content.find('"', pos);
+            const size_t close = open == string_view::npos ? open : content.find('"', open + 1);
+            const size_t lineEnd = content.find('\n', pos);
+            pos += 8;
+
+            if (close == string_view::npos || close > lineEnd)
+            {
+                continue;
+            }
+
+            const filesystem::path include = (file.parent_path() / content.substr(open + 1, close - open - 1)).lexically_normal();
+
+            if (seen.insert(include.generic_string()).second)
+            {
+                includes.push_back(include);
+                toScan.push_back(include);
+            }
+        }
+    }
+
+    return includes;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+
+//Compiles GLSL to SPIR-V with shaderc, the stage comes from the extension (.vert, .frag, .comp, ...)
+class ShaderCooker
+{
+public:
+	//false when the shader doesn't compile, the errors are logged and dest is left alone
+	static bool Cook(const std::filesystem::path& source, const std::filesystem::path& dest);
+	//mirrors the source tree under ./Build, "Data/Shaders/a.vert" -> "Build/Data/Shaders/a.vert.spv"
+	static std::filesystem::path CookedPath(const std::filesystem::path& source);
+	//files pulled in with #include "...", relative to the including file, so edits to them recook the shader
+	static std::vector<std::filesystem::path> FindIncludes(const std::filesystem::path& source);
+
+	constexpr static const char* EXTENSIONS[] = { ".vert", ".frag", ".tesc", ".tese", ".geom", ".comp" };
+};
@@ -0,0 +1,177 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stb_image.h>
+#include <vulkan/vulkan_core.h>
+
+#include "../Graphics/TextureFile.h"
+#include "../../Utils/CLogger.h"
+#include "../../Utils/JobSystem.h"
+
+using namespace std;
+
+bool TextureCooker::Cook(const filesystem::path& source, const filesystem::path& dest)
+{
+    Log("Cooking texture...", { {"Texture", source.string()}, {"Output Dest.", dest.string()} });
+
+    int width;
+    int height;
+    int channels;
+    stbi_uc* pixels = stbi_load(source.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+    if (!pixels)
+    {
+        Error("Could not load texture", { {"Path", source.string()}, {"Reason", stbi_failure_reason()} });
+
+        return false;
+    }
+
+    MipImage image{ vector<uint8_t>(pixels, pixels + static_cast<size_t>(width) * height * 4),
+        static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+    stbi_image_free(pixels);
+
+    const BlockFormat format = ChooseFormat(source, image.rgba);
+    const bool normalMap = format == BlockFormat::BC5;
+    const bool srgb = !normalMap;
+
+    TextureFileHeader header;
+    header.format = GetVkFormat(format, srgb);
+    header.width = image.width;
+    header.height = image.height;
+
+    const vector<MipImage> images = MipGenerator::Generate(move(image), MIP_FILTER, normalMap ? MipColorSpace::Normal : MipColorSpace::Srgb);
+    vector<vector<uint8_t>> mips(images.size());
+
+    //the small mips are one job each, the big ones split further into block rows
+    JobSystem::ParallelFor(images.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                mips[i] = Encode(images[i], format);
+            }
+        });
+
+    header.mipCount = static_cast<uint32_t>(mips.size());
+
+    vector<TextureFileMip> mipTable(mips.size());
+    uint64_t offset = sizeof(header) + sizeof(TextureFileMip) * mipTable.size();
+
+    for (size_t i = 0; i < mips.size(); ++i)
+    {
+        mipTable[i] = { offset, mips[i].size() };
+        offset += mips[i].size();
+    }
+
+    filesystem::create_directories(dest.parent_path());
+
+    FILE* file = nullptr;
+    errno_t err = fopen_s(&file, dest.string().c_str(), "wb");
+
+    Assert(file, "Failed to open cooked texture for writing", { {"file", dest.string()}, {"error code", err} });
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(mipTable.data(), sizeof(TextureFileMip), mipTable.size(), file);
+
+    for (const vector<uint8_t>& mip : mips)
+    {
+        fwrite(mip.data(), 1, mip.size(), file);
+    }
+
+    fclose(file);
+
+    Log("Cooked texture", { {"Texture", source.string()}, {"Mip count", header.mipCount},
+        {"Source bytes", static_cast<uint64_t>(width) * height * 4}, {"Cooked bytes", offset} });
+
+    return true;
+}
+
+filesystem::path TextureCooker::CookedPath(const filesystem::path& source)
+{
+    filesystem::path outpath = filesystem::path("Build") / source.lexically_normal();
+    outpath += ".ktex";
+
+    return outpath;
+}
+
+BlockFormat TextureCooker::ChooseFormat(const filesystem::path& source, const vector<uint8_t>& rgba)
+{
+    string stem = source.stem().string();
+    transform(stem.begin(), stem.end(), stem.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+    if (stem.ends_with("_n") || stem.ends_with("_normal"))
+    {
+        return BlockFormat::BC5;
+    }
+
+    bool transparent = false;
+    bool cutout = true;
+
+    for (size_t i = 3; i < rgba.size(); i += 4)
+    {
+        transparent |= rgba[i] != 255;
+        cutout &= rgba[i] == 0 || rgba[i] == 255;
+    }
+
+    if (!transparent)
+    {
+        return BlockFormat::BC1;
+    }
+
+    //BC3's alpha block puts its endpoints on 0 and 255, so cutout edges stay exact and the colour keeps its own indices
+    //BC7 mode 6 shares one set of indices between colour and alpha, which only pays off for smooth alpha
+    return cutout ? BlockFormat::BC3 : BlockFormat::BC7;
+}
+
+vector<uint8_t> TextureCooker::Encode(const MipImage& image, BlockFormat format)
+{
+    const uint32_t blocksX = (image.width + 3) / 4;
+    const uint32_t blocksY = (image.height + 3) / 4;
+    const uint32_t blockSize = BlockCompression::BlockSize(format);
+
+    vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * blockSize);
+
+    JobSystem::ParallelFor(blocksY, 4, [&](size_t begin, size_t end)
+        {
+            uint8_t texels[16 * 4];
+
+            for (uint32_t by = static_cast<uint32_t>(begin); by < end; ++by)
+            {
+                for (uint32_t bx = 0; bx < blocksX; ++bx)
+                {
+                    //blocks hanging off the edge repeat the last texel, the GPU never samples those
+                    for (uint32_t ty = 0; ty < 4; ++ty)
+                    {
+                        for (uint32_t tx = 0; tx < 4; ++tx)
+                        {
+                            const uint32_t x = std::min(bx * 4 + tx, image.width - 1);
+                            const uint32_t y = std::min(by * 4 + ty, image.height - 1);
+
+                            memcpy(&texels[(ty * 4 + tx) * 4], &image.rgba[(static_cast<size_t>(y) * image.width + x) * 4], 4);
+                        }
+                    }
+
+                    BlockCompression::EncodeBlock(format, texels, &blocks[(static_cast<size_t>(by) * blocksX + bx) * blockSize]);
+                }
+            }
+        });
+
+    return blocks;
+}
+
+uint32_t TextureCooker::GetVkFormat(BlockFormat format, bool srgb)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case BlockFormat::BC3:
+        return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case BlockFormat::BC5:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case BlockFormat::BC7:
+        return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "MipGenerator.h"
+
+//Turns source images into .ktex files (see TextureFile.h) with every mip precomputed and block compressed,
+//so loading a texture is a single copy into VRAM at a quarter to an eighth of the RGBA8 size
+//the Cooker decides which images need cooking
+class TextureCooker
+{
+public:
+	//false when the image doesn't decode, the error is logged and dest is left alone
+	static bool Cook(const std::filesystem::path& source, const std::filesystem::path& dest);
+	//where the cooked copy of source goes, mirrors the source tree under ./Build like the shaders
+	static std::filesystem::path CookedPath(const std::filesystem::path& source);
+
+	//normal maps (named *_n or *_normal) go to BC5, alpha that is only 0 or 255 (cutouts) to BC3, any other transparency
+	//to BC7, opaque colour to BC1
+	static BlockFormat ChooseFormat(const std::filesystem::path& source, const std::vector<uint8_t>& rgba);
+
+	//cooking happens once, so it can afford the sharper filter
+	constexpr static MipFilter MIP_FILTER = MipFilter::Kaiser;
+
+private:
+	static std::vector<uint8_t> Encode(const MipImage& image, BlockFormat format);
+	static uint32_t GetVkFormat(BlockFormat format, bool srgb);
+};
@@ -0,0 +1,511 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+using namespace glm;
+
+//border planes are weighted up so open edges of the mesh hold their silhouette
+constexpr double BORDER_WEIGHT = 10.0;
+//smallest cosine between a triangle's normal before and after a collapse
+constexpr double MIN_NORMAL_COS = 0.25;
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+static uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+    return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+MeshSimplifier::Quadric MeshSimplifier::Quadric::FromPlane(const dvec3& normal, double distance, double weight)
+{
+    Quadric q;
+    q.a00 = normal.x * normal.x * weight;
+    q.a11 = normal.y * normal.y * weight;
+    q.a22 = normal.z * normal.z * weight;
+    q.a01 = normal.x * normal.y * weight;
+    q.a02 = normal.x * normal.z * weight;
+    q.a12 = normal.y * normal.z * weight;
+    q.b0 = normal.x * distance * weight;
+    q.b1 = normal.y * distance * weight;
+    q.b2 = normal.z * distance * weight;
+    q.c = distance * distance * weight;
+    q.weight = weight;
+
+    return q;
+}
+
+void MeshSimplifier::Quadric::Add(const Quadric& rhs)
+{
+    a00 += rhs.a00;
+    a11 += rhs.a11;
+    a22 += rhs.a22;
+    a01 += rhs.a01;
+    a02 += rhs.a02;
+    a12 += rhs.a12;
+    b0 += rhs.b0;
+    b1 += rhs.b1;
+    b2 += rhs.b2;
+    c += rhs.c;
+    weight += rhs.weight;
+}
+
+double MeshSimplifier::Quadric::Error(const dvec3& p) const
+{
+    if (weight <= 0)
+    {
+        return 0;
+    }
+
+    const double err = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+        2 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+        2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+
+    return std::max(err, 0.0) / weight;
+}
+
+void MeshSimplifier::BuildPositionRemap(const vector<vec3>& positions, vector<uint32_t>& remap, vector<uint32_t>& wedges)
+{
+    vector<uint32_t> order(positions.size());
+    iota(order.begin(), order.end(), 0);
+
+    sort(order.begin(), order.end(), [&positions](uint32_t lhs, uint32_t rhs)
+        {
+            const vec3& a = positions[lhs];
+            const vec3& b = positions[rhs];
+
+            if (a.x != b.x) return a.x < b.x;
+            if (a.y != b.y) return a.y < b.y;
+            if (a.z != b.z) return a.z < b.z;
+
+            return lhs < rhs;
+        });
+
+    remap.resize(positions.size());
+    wedges.resize(positions.size());
+
+    size_t groupStart = 0;
+
+    for (size_t i = 1; i <= order.size(); ++i)
+    {
+        if (i < order.size() && positions[order[i]] == positions[order[groupStart]])
+        {
+            continue;
+        }
+
+        //every vertex in the group points at the first one, wedges form a ring through the group
+        for (size_t j = groupStart; j < i; ++j)
+        {
+            remap[order[j]] = order[groupStart];
+            wedges[order[j]] = order[j + 1 < i ? j + 1 : groupStart];
+        }
+
+        groupStart = i;
+    }
+}
+
+void MeshSimplifier::ClassifyVertices(const vector<uint32_t>& indices, const vector<uint32_t>& remap,
+    const vector<uint32_t>& wedges, vector<VertexKind>& kinds, vector<uint64_t>& borderEdges)
+{
+    const size_t vertexCount = remap.size();
+
+    vector<uint64_t> positionEdges;
+    positionEdges.reserve(indices.size());
+
+    vector<uint8_t> used(vertexCount, 0);
+
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        for (int e = 0; e < 3; ++e)
+        {
+            const uint32_t a = remap[indices[i + e]];
+            const uint32_t b = remap[indices[i + (e + 1) % 3]];
+
+            used[indices[i + e]] = 1;
+
+            if (a != b)
+            {
+                positionEdges.push_back(EdgeKey(a, b));
+            }
+        }
+    }
+
+    sort(positionEdges.begin(), positionEdges.end());
+
+    vector<uint8_t> onBorder(vertexCount, 0);
+    vector<uint8_t> locked(vertexCount, 0);
+
+    borderEdges.clear();
+
+    for (size_t i = 0; i < positionEdges.size(); ++i)
+    {
+        const uint32_t a = static_cast<uint32_t>(positionEdges[i] >> 32);
+        const uint32_t b = static_cast<uint32_t>(positionEdges[i]);
+
+        //the same directed edge twice means more than two triangles meet there
+        if (i + 1 < positionEdges.size() && positionEdges[i + 1] == positionEdges[i])
+        {
+            locked[a] = 1;
+            locked[b] = 1;
+        }
+
+        if (!binary_search(positionEdges.begin(), positionEdges.end(), EdgeKey(b, a)))
+        {
+            onBorder[a] = 1;
+            onBorder[b] = 1;
+            borderEdges.push_back(positionEdges[i]);
+        }
+    }
+
+    borderEdges.erase(unique(borderEdges.begin(), borderEdges.end()), borderEdges.end());
+
+    kinds.assign(vertexCount, VertexKind::Locked);
+
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        if (remap[v] != v)
+        {
+            continue;
+        }
+
+        uint32_t wedgeCount = 0;
+        uint32_t w = v;
+
+        do
+        {
+            wedgeCount += used[w];
+            w = wedges[w];
+        } while (w != v);
+
+        if (locked[v])
+        {
+            kinds[v] = VertexKind::Locked;
+        }
+        else if (onBorder[v])
+        {
+            kinds[v] = wedgeCount == 1 ? VertexKind::Border : VertexKind::Locked;
+        }
+        else if (wedgeCount == 1)
+        {
+            kinds[v] = VertexKind::Manifold;
+        }
+        else
+        {
+            kinds[v] = wedgeCount == 2 ? VertexKind::Seam : VertexKind::Locked;
+        }
+    }
+}
+
+bool MeshSimplifier::HasEdge(const vector<uint64_t>& sortedEdges, uint32_t a, uint32_t b)
+{
+    return binary_search(sortedEdges.begin(), sortedEdges.end(), EdgeKey(a, b));
+}
+
+bool MeshSimplifier::CollapseFlipsTriangle(const vector<vec3>& positions, const vector<uint32_t>& indices,
+    const vector<uint32_t>& remap, const vector<uint32_t>& adjOffsets, const vector<uint32_t>& adjTris,
+    uint32_t from, uint32_t to)
+{
+    for (uint32_t i = adjOffsets[from]; i < adjOffsets[from + 1]; ++i)
+    {
+        const uint32_t tri = adjTris[i];
+        uint32_t corners[3] = { remap[indices[tri * 3]], remap[indices[tri * 3 + 1]], remap[indices[tri * 3 + 2]] };
+
+        //triangles on the collapsing edge disappear so they can't flip
+        if (corners[0] == to || corners[1] == to || corners[2] == to)
+        {
+            continue;
+        }
+
+        const dvec3 before = cross(dvec3(positions[corners[1]] - positions[corners[0]]), dvec3(positions[corners[2]] - positions[corners[0]]));
+
+        for (uint32_t& corner : corners)
+        {
+            if (corner == from)
+            {
+                corner = to;
+            }
+        }
+
+        const dvec3 after = cross(dvec3(positions[corners[1]] - positions[corners[0]]), dvec3(positions[corners[2]] - positions[corners[0]]));
+
+        if (dot(before, after) <= MIN_NORMAL_COS * length(before) * length(after))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+vector<uint32_t> MeshSimplifier::Simplify(const vector<vec3>& positions, const vector<uint32_t>& indices,
+    size_t targetIndexCount, float maxError, float* outError)
+{
+    vector<uint32_t> result = indices;
+    float acceptedError = 0;
+
+    if (outError)
+    {
+        *outError = 0;
+    }
+
+    if (result.size() <= targetIndexCount || positions.empty())
+    {
+        return result;
+    }
+
+    vector<uint32_t> remap;
+    vector<uint32_t> wedges;
+    BuildPositionRemap(positions, remap, wedges);
+
+    vector<VertexKind> kinds;
+    vector<uint64_t> borderEdges;
+    ClassifyVertices(result, remap, wedges, kinds, borderEdges);
+
+    vector<Quadric> quadrics(positions.size());
+
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        const uint32_t r[3] = { remap[result[i]], remap[result[i + 1]], remap[result[i + 2]] };
+        const dvec3 p[3] = { dvec3(positions[r[0]]), dvec3(positions[r[1]]), dvec3(positions[r[2]]) };
+
+        dvec3 normal = cross(p[1] - p[0], p[2] - p[0]);
+        const double doubleArea = length(normal);
+
+        if (doubleArea <= 0)
+        {
+            continue;
+        }
+
+        normal /= doubleArea;
+
+        const Quadric face = Quadric::FromPlane(normal, -dot(normal, p[0]), doubleArea * 0.5);
+
+        for (int e = 0; e < 3; ++e)
+        {
+            quadrics[r[e]].Add(face);
+
+            const uint32_t next = (e + 1) % 3;
+
+            if (HasEdge(borderEdges, r[e], r[next]))
+            {
+                //plane through the open edge perpendicular to the face keeps the border in place
+                const dvec3 edge = p[next] - p[e];
+                const double edgeLength = length(edge);
+
+                if (edgeLength > 0)
+                {
+                    const dvec3 edgeNormal = normalize(cross(edge, normal));
+                    const Quadric border = Quadric::FromPlane(edgeNormal, -dot(edgeNormal, p[e]), edgeLength * edgeLength * BORDER_WEIGHT);
+
+                    quadrics[r[e]].Add(border);
+                    quadrics[r[next]].Add(border);
+                }
+            }
+        }
+    }
+
+    vector<uint32_t> adjOffsets(positions.size() + 1);
+    vector<uint32_t> adjTris;
+    vector<Collapse> candidates;
+    vector<uint8_t> locked(positions.size());
+    vector<uint32_t> collapseTarget(positions.size());
+    vector<pair<uint32_t, uint32_t>> wedgeMap;
+    vector<uint32_t> compacted;
+
+    while (result.size() > targetIndexCount)
+    {
+        //triangles around every position for this pass
+        fill(adjOffsets.begin(), adjOffsets.end(), 0);
+
+        for (uint32_t index : result)
+        {
+            adjOffsets[remap[index] + 1]++;
+        }
+
+        partial_sum(adjOffsets.begin(), adjOffsets.end(), adjOffsets.begin());
+        adjTris.resize(result.size());
+
+        {
+            vector<uint32_t> fillPos(adjOffsets.begin(), adjOffsets.end() - 1);
+
+            for (uint32_t i = 0; i < result.size(); ++i)
+            {
+                adjTris[fillPos[remap[result[i]]]++] = i / 3;
+            }
+        }
+
+        candidates.clear();
+
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                const uint32_t i0 = result[i + e];
+                const uint32_t i1 = result[i + (e + 1) % 3];
+
+                for (int dir = 0; dir < 2; ++dir)
+                {
+                    const uint32_t from = dir ? i1 : i0;
+                    const uint32_t to = dir ? i0 : i1;
+                    const uint32_t u = remap[from];
+                    const uint32_t v = remap[to];
+
+                    if (u == v || kinds[u] == VertexKind::Locked)
+                    {
+                        continue;
+                    }
+
+                    if (kinds[u] == VertexKind::Border && !HasEdge(borderEdges, u, v) && !HasEdge(borderEdges, v, u))
+                    {
+                        continue;
+                    }
+
+                    const float error = static_cast<float>(sqrt(quadrics[u].Error(dvec3(positions[v]))));
+
+                    if (error <= maxError)
+                    {
+                        candidates.push_back({ from, to, error });
+                    }
+                }
+            }
+        }
+
+        if (candidates.empty())
+        {
+            break;
+        }
+
+        sort(candidates.begin(), candidates.end(), [](const Collapse& lhs, const Collapse& rhs)
+            {
+                return lhs.error < rhs.error;
+            });
+
+        fill(locked.begin(), locked.end(), 0);
+        iota(collapseTarget.begin(), collapseTarget.end(), 0);
+
+        const size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+        size_t trianglesRemoved = 0;
+        bool collapsed = false;
+
+        for (const Collapse& candidate : candidates)
+        {
+            if (trianglesRemoved >= trianglesToRemove && collapsed)
+            {
+                break;
+            }
+
+            const uint32_t u = remap[candidate.from];
+            const uint32_t v = remap[candidate.to];
+
+            if (locked[u] || locked[v])
+            {
+                continue;
+            }
+
+            //every wedge of u needs an edge to a wedge of v so attributes stay continuous
+            wedgeMap.clear();
+            uint32_t removedHere = 0;
+
+            for (uint32_t a = adjOffsets[u]; a < adjOffsets[u + 1]; ++a)
+            {
+                const uint32_t tri = adjTris[a];
+                bool touchesV = false;
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (remap[result[tri * 3 + k]] != u)
+                    {
+                        continue;
+                    }
+
+                    const uint32_t wedge = result[tri * 3 + k];
+                    auto it = find_if(wedgeMap.begin(), wedgeMap.end(), [wedge](const auto& entry) { return entry.first == wedge; });
+
+                    if (it == wedgeMap.end())
+                    {
+                        wedgeMap.emplace_back(wedge, INVALID_INDEX);
+                        it = wedgeMap.end() - 1;
+                    }
+
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        const uint32_t other = result[tri * 3 + j];
+
+                        if (remap[other] == v)
+                        {
+                            touchesV = true;
+
+                            if (it->second == INVALID_INDEX)
+                            {
+                                it->second = other;
+                            }
+                        }
+                    }
+                }
+
+                removedHere += touchesV;
+            }
+
+            const bool wedgesMatch = all_of(wedgeMap.begin(), wedgeMap.end(), [](const auto& entry) { return entry.second != INVALID_INDEX; });
+
+            if (!wedgesMatch || CollapseFlipsTriangle(positions, result, remap, adjOffsets, adjTris, u, v))
+            {
+                continue;
+            }
+
+            for (const auto& [wedge, target] : wedgeMap)
+            {
+                collapseTarget[wedge] = target;
+            }
+
+            quadrics[v].Add(quadrics[u]);
+
+            //anything touching u changes shape this pass, so leave it for the next one
+            for (uint32_t a = adjOffsets[u]; a < adjOffsets[u + 1]; ++a)
+            {
+                const uint32_t tri = adjTris[a];
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    locked[remap[result[tri * 3 + k]]] = 1;
+                }
+            }
+
+            trianglesRemoved += removedHere;
+            acceptedError = std::max(acceptedError, candidate.error);
+            collapsed = true;
+        }
+
+        if (!collapsed)
+        {
+            break;
+        }
+
+        compacted.clear();
+
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            const uint32_t a = collapseTarget[result[i]];
+            const uint32_t b = collapseTarget[result[i + 1]];
+            const uint32_t c = collapseTarget[result[i + 2]];
+
+            if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a])
+            {
+                continue;
+            }
+
+            compacted.push_back(a);
+            compacted.push_back(b);
+            compacted.push_back(c);
+        }
+
+        result.swap(compacted);
+    }
+
+    if (outError)
+    {
+        *outError = acceptedError;
+    }
+
+    return result;
+}
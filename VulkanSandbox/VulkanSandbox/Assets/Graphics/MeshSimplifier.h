@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+//Quadric error edge collapse simplification (Garland & Heckbert)
+//Vertices are never moved or created, a collapse just re-points the indices of one vertex at
+//an existing neighbour so every LOD can index into the same vertex buffer as the base mesh
+class MeshSimplifier
+{
+public:
+	//returns the simplified triangle list, stopping at targetIndexCount or once the next collapse
+	//would move the surface by more than maxError (in model units)
+	//outError receives the largest error that was actually accepted
+	static std::vector<uint32_t> Simplify(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+		size_t targetIndexCount, float maxError, float* outError = nullptr);
+
+private:
+	enum class VertexKind : uint8_t
+	{
+		Manifold, //interior vertex with a single set of attributes, can collapse anywhere
+		Border,   //on an open edge, can only slide along that edge
+		Seam,     //attribute seam with two wedges, can only slide along the seam
+		Locked    //anything more complex, never moves
+	};
+
+	struct Quadric
+	{
+		double a00 = 0, a11 = 0, a22 = 0;
+		double a01 = 0, a02 = 0, a12 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double weight = 0;
+
+		static Quadric FromPlane(const glm::dvec3& normal, double distance, double weight);
+		void Add(const Quadric& rhs);
+		//weighted mean squared distance to the accumulated planes
+		double Error(const glm::dvec3& point) const;
+	};
+
+	struct Collapse
+	{
+		uint32_t from; //index (not position) being removed
+		uint32_t to;   //index it gets replaced with
+		float error;
+	};
+
+	static void BuildPositionRemap(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& remap, std::vector<uint32_t>& wedges);
+	static void ClassifyVertices(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& remap,
+		const std::vector<uint32_t>& wedges, std::vector<VertexKind>& kinds, std::vector<uint64_t>& borderEdges);
+	static bool HasEdge(const std::vector<uint64_t>& sortedEdges, uint32_t a, uint32_t b);
+	static bool CollapseFlipsTriangle(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+		const std::vector<uint32_t>& remap, const std::vector<uint32_t>& adjOffsets, const std::vector<uint32_t>& adjTris,
+		uint32_t from, uint32_t to);
+};
@@ -0,0 +1,247 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+using namespace std;
+using namespace glm;
+
+constexpr uint8_t NOT_IN_MESHLET = 0xFF;
+constexpr uint32_t INVALID_TRIANGLE = ~0u;
+
+static uint32_t PackTriangle(uint32_t a, uint32_t b, uint32_t c)
+{
+    return a | (b << 8) | (c << 16);
+}
+
+MeshletData MeshletBuilder::Build(const vector<vec3>& positions, const vector<uint32_t>& indices)
+{
+    MeshletData data;
+    const size_t triangleCount = indices.size() / 3;
+
+    if (triangleCount == 0)
+    {
+        return data;
+    }
+
+    //triangles around each vertex
+    vector<uint32_t> adjOffsets(positions.size() + 1, 0);
+
+    for (uint32_t index : indices)
+    {
+        adjOffsets[index + 1]++;
+    }
+
+    partial_sum(adjOffsets.begin(), adjOffsets.end(), adjOffsets.begin());
+
+    vector<uint32_t> adjTris(indices.size());
+
+    {
+        vector<uint32_t> fillPos(adjOffsets.begin(), adjOffsets.end() - 1);
+
+        for (uint32_t i = 0; i < indices.size(); ++i)
+        {
+            adjTris[fillPos[indices[i]]++] = i / 3;
+        }
+    }
+
+    vector<uint8_t> emitted(triangleCount, 0);
+    vector<uint8_t> localIndex(positions.size(), NOT_IN_MESHLET);
+
+    vector<uint32_t> meshletVertices;
+    vector<uint32_t> meshletTriangles;
+    meshletVertices.reserve(MeshletData::MAX_VERTICES);
+    meshletTriangles.reserve(MeshletData::MAX_TRIANGLES);
+
+    vec3 centroidSum(0.0f);
+    size_t seedCursor = 0;
+    size_t emittedCount = 0;
+
+    auto newVertexCount = [&](uint32_t tri)
+        {
+            uint32_t count = 0;
+
+            for (int k = 0; k < 3; ++k)
+            {
+                count += localIndex[indices[tri * 3 + k]] == NOT_IN_MESHLET;
+            }
+
+            return count;
+        };
+
+    auto flush = [&]()
+        {
+            AppendMeshlet(data, positions, meshletVertices, meshletTriangles);
+
+            for (uint32_t vertex : meshletVertices)
+            {
+                localIndex[vertex] = NOT_IN_MESHLET;
+            }
+
+            meshletVertices.clear();
+            meshletTriangles.clear();
+            centroidSum = vec3(0.0f);
+        };
+
+    while (emittedCount < triangleCount)
+    {
+        uint32_t best = INVALID_TRIANGLE;
+        uint32_t bestNew = numeric_limits<uint32_t>::max();
+        float bestDistance = numeric_limits<float>::max();
+
+        //prefer neighbours that bring in the fewest new vertices, then the ones closest to the middle
+        if (!meshletVertices.empty())
+        {
+            const vec3 centroid = centroidSum / static_cast<float>(meshletVertices.size());
+
+            for (uint32_t vertex : meshletVertices)
+            {
+                for (uint32_t a = adjOffsets[vertex]; a < adjOffsets[vertex + 1]; ++a)
+                {
+                    const uint32_t tri = adjTris[a];
+
+                    if (emitted[tri])
+                    {
+                        continue;
+                    }
+
+                    const uint32_t added = newVertexCount(tri);
+
+                    if (meshletVertices.size() + added > MeshletData::MAX_VERTICES || added > bestNew)
+                    {
+                        continue;
+                    }
+
+                    const vec3 triCenter = (positions[indices[tri * 3]] + positions[indices[tri * 3 + 1]] + positions[indices[tri * 3 + 2]]) / 3.0f;
+                    const vec3 offset = triCenter - centroid;
+                    const float distance = dot(offset, offset);
+
+                    if (added < bestNew || distance < bestDistance)
+                    {
+                        best = tri;
+                        bestNew = added;
+                        bestDistance = distance;
+                    }
+                }
+            }
+        }
+
+        //nothing connected fits, start from the next unused triangle
+        if (best == INVALID_TRIANGLE)
+        {
+            while (emitted[seedCursor])
+            {
+                seedCursor++;
+            }
+
+            best = static_cast<uint32_t>(seedCursor);
+
+            if (meshletVertices.size() + newVertexCount(best) > MeshletData::MAX_VERTICES)
+            {
+                flush();
+            }
+        }
+
+        uint32_t local[3];
+
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint32_t vertex = indices[best * 3 + k];
+
+            if (localIndex[vertex] == NOT_IN_MESHLET)
+            {
+                localIndex[vertex] = static_cast<uint8_t>(meshletVertices.size());
+                meshletVertices.push_back(vertex);
+                centroidSum += positions[vertex];
+            }
+
+            local[k] = localIndex[vertex];
+        }
+
+        meshletTriangles.push_back(PackTriangle(local[0], local[1], local[2]));
+        emitted[best] = 1;
+        emittedCount++;
+
+        if (meshletTriangles.size() == MeshletData::MAX_TRIANGLES)
+        {
+            flush();
+        }
+    }
+
+    if (!meshletTriangles.empty())
+    {
+        flush();
+    }
+
+    return data;
+}
+
+void MeshletBuilder::AppendMeshlet(MeshletData& data, const vector<vec3>& positions,
+    const vector<uint32_t>& vertices, const vector<uint32_t>& triangles)
+{
+    vec3 boundsMin(numeric_limits<float>::max());
+    vec3 boundsMax(-numeric_limits<float>::max());
+
+    for (uint32_t vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, positions[vertex]);
+        boundsMax = glm::max(boundsMax, positions[vertex]);
+    }
+
+    const vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0;
+
+    for (uint32_t vertex : vertices)
+    {
+        radius = std::max(radius, distance(center, positions[vertex]));
+    }
+
+    //area weighted average normal is the cone axis, the widest normal sets the angle
+    vector<vec3> normals;
+    normals.reserve(triangles.size());
+    vec3 axis(0.0f);
+
+    for (uint32_t tri : triangles)
+    {
+        const vec3& p0 = positions[vertices[tri & 0xFF]];
+        const vec3& p1 = positions[vertices[(tri >> 8) & 0xFF]];
+        const vec3& p2 = positions[vertices[(tri >> 16) & 0xFF]];
+        const vec3 normal = cross(p1 - p0, p2 - p0);
+        const float area = length(normal);
+
+        if (area > 0)
+        {
+            axis += normal;
+            normals.push_back(normal / area);
+        }
+    }
+
+    vec4 cone(0.0f, 0.0f, 0.0f, 1.0f);
+    const float axisLength = length(axis);
+
+    if (axisLength > 0 && !normals.empty())
+    {
+        axis /= axisLength;
+
+        float minCos = 1.0f;
+
+        for (const vec3& normal : normals)
+        {
+            minCos = std::min(minCos, dot(axis, normal));
+        }
+
+        //normals spread over more than a hemisphere can always be seen from somewhere
+        if (minCos > 0)
+        {
+            cone = vec4(axis, sqrt(1.0f - minCos * minCos));
+        }
+    }
+
+    data.bounds.push_back(vec4(center, radius));
+    data.cones.push_back(cone);
+    data.ranges.push_back(uvec4(static_cast<uint32_t>(data.vertices.size()), static_cast<uint32_t>(data.triangles.size()),
+        static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(triangles.size())));
+    data.vertices.insert(data.vertices.end(), vertices.begin(), vertices.end());
+    data.triangles.insert(data.triangles.end(), triangles.begin(), triangles.end());
+}
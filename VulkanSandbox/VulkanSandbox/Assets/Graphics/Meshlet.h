@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+//Meshlets for one mesh, kept as separate arrays so each one can go straight into
+//its own section of a storage buffer and be read by culling/mesh shaders one field at a time
+struct MeshletData
+{
+	constexpr static uint32_t MAX_VERTICES = 64;
+	constexpr static uint32_t MAX_TRIANGLES = 124;
+
+	//xyz = center, w = radius, in model space
+	std::vector<glm::vec4> bounds;
+	//xyz = average normal, w = sin of the cone's half angle (1 when it can't be culled)
+	//the whole meshlet is backfacing if dot(center - eye, axis) >= w * |center - eye| + radius
+	std::vector<glm::vec4> cones;
+	//x = first entry in vertices, y = first entry in triangles, z = vertex count, w = triangle count
+	std::vector<glm::uvec4> ranges;
+	//indices into the model's vertex buffer
+	std::vector<uint32_t> vertices;
+	//three 8 bit meshlet-local vertex indices per triangle
+	std::vector<uint32_t> triangles;
+
+	size_t Count() const { return ranges.size(); }
+};
+
+class MeshletBuilder
+{
+public:
+	//greedily grows meshlets across shared vertices so each one stays compact and reuses as many
+	//vertices as it can before hitting MAX_VERTICES or MAX_TRIANGLES
+	static MeshletData Build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+private:
+	static void AppendMeshlet(MeshletData& data, const std::vector<glm::vec3>& positions,
+		const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& triangles);
+};
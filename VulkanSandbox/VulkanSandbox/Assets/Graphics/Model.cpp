@@ -1,13 +1,21 @@
 #include "Model.h"
+#include "MeshSimplifier.h"
+#include "ModelFile.h"
 #include "../../Utils/CLogger.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/mesh.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <cstring>
+#include <limits>
 #include "../../Graphics/Graphics.h"
+#include "../../Graphics/UploadBatch.h"
 
-Model::Model(const std::filesystem::path& path) : _modelPath(path)
+using namespace std;
+using namespace glm;
+
+Model::Model(const std::filesystem::path& path) : Asset(path)
 {
 }
 
@@ -19,20 +27,84 @@ Model::~Model()
 	}
 }
 
-void Model::DrawCmd()
+void Model::DrawInstanced(vk::CommandBuffer commandBuffer, uint32_t lod, uint32_t firstInstance, uint32_t instanceCount) const
+{
+    const Lod& drawn = _lods[std::min(lod, static_cast<uint32_t>(_lods.size() - 1))];
+
+    commandBuffer.drawIndexed(drawn.indexCount, instanceCount, drawn.indexOffset, 0, firstInstance);
+}
+
+std::unique_ptr<Model> Model::CreateCube()
+{
+    auto model = std::make_unique<Model>("");
+
+    //four vertices per face so every face gets the full texture
+    const vec3 normals[] = { {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1} };
+
+    for (const vec3& normal : normals)
+    {
+        const vec3 tangent = normal.x != 0 ? vec3(0, normal.x, 0) : (normal.y != 0 ? vec3(0, 0, normal.y) : vec3(normal.z, 0, 0));
+        const vec3 bitangent = cross(normal, tangent);
+        const uint32_t baseVertex = static_cast<uint32_t>(model->_vertices.size());
+
+        for (const vec2 corner : { vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, 1) })
+        {
+            Vertex vertex{};
+            vertex.pos = (normal + tangent * corner.x + bitangent * corner.y) * 0.5f;
+            vertex.color = { 1, 1, 1 };
+            vertex.texCoord = corner * 0.5f + 0.5f;
+
+            model->_vertices.push_back(vertex);
+        }
+
+        for (uint32_t index : { 0u, 1u, 2u, 2u, 3u, 0u })
+        {
+            model->_indices.push_back(baseVertex + index);
+        }
+    }
+
+    model->ProcessGeometry();
+
+    return model;
+}
+
+void Model::DecodeFromMemory(std::span<const char> fileData)
 {
+    ModelFileHeader header;
+
+    if (fileData.size() >= sizeof(header) && memcmp(fileData.data(), &header.magic, sizeof(header.magic)) == 0)
+    {
+        DecodeCooked(fileData);
+        return;
+    }
+
+    const bool decoded = DecodeSource(fileData);
+    Assert(decoded, "Could not load model", { {"Path", _path.string()} });
 }
 
-void Model::Load()
+bool Model::DecodeSource(std::span<const char> fileData)
 {
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile("Data/Models/viking_room.obj", aiProcess_Triangulate | aiProcess_FlipUVs);
+    //the extension tells assimp which importer to use since there's no file name
+    const string extension = _path.extension().string();
+    //joining identical vertices gives the simplifier real connectivity to collapse along
+    const aiScene* scene = importer.ReadFileFromMemory(fileData.data(), fileData.size(),
+        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices, extension.empty() ? "" : extension.c_str() + 1);
+
+    if (!scene)
+    {
+        Error("Could not import model", { {"Path", _path.string()}, {"Error", importer.GetErrorString()} });
+
+        return false;
+    }
 
-    Assert(scene, "Could not load model");
+    _vertices.clear();
+    _indices.clear();
 
     for (unsigned i = 0; i < scene->mNumMeshes; ++i)
     {
         aiMesh* curMesh = scene->mMeshes[i];
+        const uint32_t baseVertex = static_cast<uint32_t>(_vertices.size());
 
         for (unsigned j = 0; j < curMesh->mNumVertices; ++j)
         {
@@ -49,18 +121,128 @@ void Model::Load()
         {
             aiFace face = curMesh->mFaces[i];
             for (unsigned int j = 0; j < face.mNumIndices; j++)
-                _indices.push_back(face.mIndices[j]);
+                _indices.push_back(baseVertex + face.mIndices[j]);
         }
     }
 
-    CreateVertexBuffer();
-    CreateIndexBuffer();
+    //a file cut off mid write can still parse, just without anything in it
+    if (_indices.empty())
+    {
+        Error("Model has no triangles", { {"Path", _path.string()} });
+
+        return false;
+    }
+
+    ProcessGeometry();
+
+    return true;
+}
+
+void Model::DecodeCooked(span<const char> fileData)
+{
+    ModelFileHeader header;
+    memcpy(&header, fileData.data(), sizeof(header));
+
+    Assert(header.version == ModelFileHeader::VERSION, "Cooked model is from another version!",
+        { {"Path", _path.string()}, {"Version", header.version} });
+
+    size_t offset = sizeof(header);
+
+    //every array is checked against the file size before it is copied out
+    auto read = [&]<typename T>(vector<T>& dest, uint32_t count)
+    {
+        const size_t size = sizeof(T) * count;
+
+        Assert(size <= fileData.size() - offset, "Cooked model is truncated!", { {"Path", _path.string()} });
+
+        dest.resize(count);
+        memcpy(dest.data(), fileData.data() + offset, size);
+        offset += size;
+    };
+
+    read(_vertices, header.vertexCount);
+    read(_indices, header.indexCount);
+    read(_lods, header.lodCount);
+    read(_meshlets.bounds, header.meshletCount);
+    read(_meshlets.cones, header.meshletCount);
+    read(_meshlets.ranges, header.meshletCount);
+    read(_meshlets.vertices, header.meshletVertexCount);
+    read(_meshlets.triangles, header.meshletTriangleCount);
+
+    _boundsCenter = { header.boundsCenter[0], header.boundsCenter[1], header.boundsCenter[2] };
+    _boundsRadius = header.boundsRadius;
+}
+
+void Model::ProcessGeometry()
+{
+    vec3 boundsMin(numeric_limits<float>::max());
+    vec3 boundsMax(-numeric_limits<float>::max());
+
+    for (const Vertex& vertex : _vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+
+    _boundsCenter = (boundsMin + boundsMax) * 0.5f;
+    _boundsRadius = 0;
+
+    for (const Vertex& vertex : _vertices)
+    {
+        _boundsRadius = std::max(_boundsRadius, distance(vertex.pos, _boundsCenter));
+    }
+
+    vector<vec3> positions(_vertices.size());
+
+    for (size_t i = 0; i < _vertices.size(); ++i)
+    {
+        positions[i] = _vertices[i].pos;
+    }
+
+    BuildLods(positions);
+
+    _meshlets = MeshletBuilder::Build(positions, vector<uint32_t>(_indices.begin(), _indices.begin() + _lods[0].indexCount));
+
+    Log("Built model meshlets", { {"Model", _path.string()}, {"Meshlet count", _meshlets.Count()} });
+}
+
+void Model::Upload(UploadBatch& batch)
+{
+    batch.UploadBuffer(_vertices.data(), sizeof(_vertices[0]) * _vertices.size(),
+        vk::BufferUsageFlagBits::eVertexBuffer, _vertexBuffer, _vertexBufferMemory);
+
+    vector<vec3> positions(_vertices.size());
+
+    for (size_t i = 0; i < _vertices.size(); ++i)
+    {
+        positions[i] = _vertices[i].pos;
+    }
+
+    batch.UploadBuffer(positions.data(), sizeof(positions[0]) * positions.size(),
+        vk::BufferUsageFlagBits::eVertexBuffer, _positionBuffer, _positionBufferMemory);
+    batch.UploadBuffer(_indices.data(), sizeof(_indices[0]) * _indices.size(),
+        vk::BufferUsageFlagBits::eIndexBuffer, _indexBuffer, _indexBufferMemory);
+    UploadMeshlets(batch);
+
+    _loaded = true;
 }
 
 void Model::Unload()
 {
+    vmaDestroyBuffer(Graphics::_allocator, _meshletBuffer, _meshletBufferMemory);
     vmaDestroyBuffer(Graphics::_allocator, _indexBuffer, _indexBufferMemory);
+    vmaDestroyBuffer(Graphics::_allocator, _positionBuffer, _positionBufferMemory);
     vmaDestroyBuffer(Graphics::_allocator, _vertexBuffer, _vertexBufferMemory);
+
+    _meshletBuffer = nullptr;
+    _meshletBufferMemory = nullptr;
+    _indexBuffer = nullptr;
+    _indexBufferMemory = nullptr;
+    _positionBuffer = nullptr;
+    _positionBufferMemory = nullptr;
+    _vertexBuffer = nullptr;
+    _vertexBufferMemory = nullptr;
+    _loaded = false;
 }
 
 bool Model::IsLoaded() const
@@ -68,64 +250,159 @@ bool Model::IsLoaded() const
     return _loaded;
 }
 
-void Model::CreateVertexBuffer()
+uint64_t Model::GetGpuMemorySize() const
 {
-    vk::DeviceSize bufferSize = sizeof(_vertices[0]) * _vertices.size();
+    if (!_loaded)
+    {
+        return 0;
+    }
 
-    vk::Buffer stagingBuffer;
-    VmaAllocation stagingBufferMemory;
-    Graphics::CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-        stagingBuffer, stagingBufferMemory, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    uint64_t size = 0;
 
-    void* data;
-    VkResult result = vmaMapMemory(Graphics::_allocator, stagingBufferMemory, &data);
+    for (VmaAllocation allocation : { _vertexBufferMemory, _positionBufferMemory, _indexBufferMemory, _meshletBufferMemory })
+    {
+        //models without meshlets never allocate that buffer
+        if (allocation)
+        {
+            VmaAllocationInfo allocationInfo;
+            vmaGetAllocationInfo(Graphics::_allocator, allocation, &allocationInfo);
+            size += allocationInfo.size;
+        }
+    }
+
+    return size;
+}
+
+uint64_t Model::Evict(UploadBatch& batch)
+{
+    const uint64_t size = GetGpuMemorySize();
 
-    if (result != VK_SUCCESS)
+    if (!_loaded)
     {
-        Error("Failed to map vertex memory!");
-        return;
+        return 0;
     }
 
-    memcpy(data, _vertices.data(), bufferSize);
-    vmaUnmapMemory(Graphics::_allocator, stagingBufferMemory);
+    Graphics::DeferDestroy([vertexBuffer = _vertexBuffer, vertexBufferMemory = _vertexBufferMemory,
+        positionBuffer = _positionBuffer, positionBufferMemory = _positionBufferMemory,
+        indexBuffer = _indexBuffer, indexBufferMemory = _indexBufferMemory,
+        meshletBuffer = _meshletBuffer, meshletBufferMemory = _meshletBufferMemory]()
+        {
+            vmaDestroyBuffer(Graphics::_allocator, meshletBuffer, meshletBufferMemory);
+            vmaDestroyBuffer(Graphics::_allocator, indexBuffer, indexBufferMemory);
+            vmaDestroyBuffer(Graphics::_allocator, positionBuffer, positionBufferMemory);
+            vmaDestroyBuffer(Graphics::_allocator, vertexBuffer, vertexBufferMemory);
+        });
+
+    _meshletBuffer = nullptr;
+    _meshletBufferMemory = nullptr;
+    _indexBuffer = nullptr;
+    _indexBufferMemory = nullptr;
+    _positionBuffer = nullptr;
+    _positionBufferMemory = nullptr;
+    _vertexBuffer = nullptr;
+    _vertexBufferMemory = nullptr;
+    _loaded = false;
 
-    Graphics::CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
-        vk::MemoryPropertyFlagBits::eDeviceLocal, _vertexBuffer,
-        _vertexBufferMemory);
+    return size;
+}
 
-    Graphics::CopyBuffer(stagingBuffer, _vertexBuffer, bufferSize);
+uint32_t Model::SelectLod(float pixelsPerUnit, uint32_t currentLod) const
+{
+    if (_lods.empty())
+    {
+        return 0;
+    }
 
-    vmaDestroyBuffer(Graphics::_allocator, stagingBuffer, stagingBufferMemory);
+    currentLod = std::min(currentLod, static_cast<uint32_t>(_lods.size() - 1));
+
+    uint32_t lod = 0;
+
+    while (lod + 1 < _lods.size() && _lods[lod + 1].error * pixelsPerUnit <= LOD_PIXEL_ERROR)
+    {
+        lod++;
+    }
+
+    if (lod > currentLod)
+    {
+        //only go coarser once the new level is comfortably under the threshold
+        while (lod > currentLod && _lods[lod].error * pixelsPerUnit > LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS))
+        {
+            lod--;
+        }
+    }
+    else if (lod < currentLod && _lods[currentLod].error * pixelsPerUnit <= LOD_PIXEL_ERROR * (1.0f + LOD_HYSTERESIS))
+    {
+        //stay coarse until the current level is clearly over the threshold
+        lod = currentLod;
+    }
+
+    return lod;
 }
 
-void Model::CreateIndexBuffer()
+void Model::BuildLods(const vector<vec3>& positions)
 {
-    vk::DeviceSize bufferSize = sizeof(_indices[0]) * _indices.size();
+    _lods.clear();
+    _lods.push_back({ 0, static_cast<uint32_t>(_indices.size()), 0.0f });
 
-    vk::Buffer stagingBuffer;
-    VmaAllocation stagingBufferMemory;
-    Graphics::CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-        stagingBuffer, stagingBufferMemory, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    vector<uint32_t> lodIndices = _indices;
+    float lodError = 0;
 
-    void* data;
-    VkResult result = vmaMapMemory(Graphics::_allocator, stagingBufferMemory, &data);
+    while (_lods.size() < MAX_LODS)
+    {
+        float stepError = 0;
+        vector<uint32_t> simplified = MeshSimplifier::Simplify(positions, lodIndices, lodIndices.size() / 6 * 3,
+            _boundsRadius * LOD_MAX_STEP_ERROR, &stepError);
 
-    if (result != VK_SUCCESS)
+        if (simplified.empty() || simplified.size() > lodIndices.size() * LOD_MIN_REDUCTION)
+        {
+            break;
+        }
+
+        //each level is simplified from the one before it so the errors stack
+        lodError += stepError;
+
+        _lods.push_back({ static_cast<uint32_t>(_indices.size()), static_cast<uint32_t>(simplified.size()), lodError });
+        _indices.insert(_indices.end(), simplified.begin(), simplified.end());
+        lodIndices.swap(simplified);
+    }
+
+    Log("Built model LODs", { {"Model", _path.string()}, {"LOD count", _lods.size()},
+        {"Base triangles", _lods.front().indexCount / 3}, {"Lowest triangles", _lods.back().indexCount / 3} });
+}
+
+void Model::UploadMeshlets(UploadBatch& batch)
+{
+    if (_meshlets.Count() == 0)
     {
-        Error("Failed to map index memory!");
         return;
     }
 
-    memcpy(data, _indices.data(), bufferSize);
-    vmaUnmapMemory(Graphics::_allocator, stagingBufferMemory);
+    vk::PhysicalDeviceProperties properties{};
+    Graphics::_physicalDevice.getProperties(&properties);
+    const vk::DeviceSize alignment = std::max<vk::DeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 16);
 
-    Graphics::CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
-        vk::MemoryPropertyFlagBits::eDeviceLocal, _indexBuffer,
-        _indexBufferMemory);
+    const std::array<std::pair<const void*, vk::DeviceSize>, MESHLET_SECTION_COUNT> sections = { {
+        { _meshlets.bounds.data(), sizeof(_meshlets.bounds[0]) * _meshlets.bounds.size() },
+        { _meshlets.cones.data(), sizeof(_meshlets.cones[0]) * _meshlets.cones.size() },
+        { _meshlets.ranges.data(), sizeof(_meshlets.ranges[0]) * _meshlets.ranges.size() },
+        { _meshlets.vertices.data(), sizeof(_meshlets.vertices[0]) * _meshlets.vertices.size() },
+        { _meshlets.triangles.data(), sizeof(_meshlets.triangles[0]) * _meshlets.triangles.size() },
+    } };
 
-    Graphics::CopyBuffer(stagingBuffer, _indexBuffer, bufferSize);
+    vk::DeviceSize bufferSize = 0;
+
+    for (size_t i = 0; i < sections.size(); ++i)
+    {
+        _meshletSectionOffsets[i] = bufferSize;
+        bufferSize = (bufferSize + sections[i].second + alignment - 1) / alignment * alignment;
+    }
+
+    vector<char> packed(bufferSize, 0);
+
+    for (size_t i = 0; i < sections.size(); ++i)
+    {
+        memcpy(packed.data() + _meshletSectionOffsets[i], sections[i].first, sections[i].second);
+    }
 
-    vmaDestroyBuffer(Graphics::_allocator, stagingBuffer, stagingBufferMemory);
+    batch.UploadBuffer(packed.data(), bufferSize, vk::BufferUsageFlagBits::eStorageBuffer, _meshletBuffer, _meshletBufferMemory);
 }
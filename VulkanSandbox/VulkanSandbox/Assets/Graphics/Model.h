@@ -2,7 +2,9 @@
 #include <vk_mem_alloc.h>
 
 #include "../Asset.h"
+#include "Meshlet.h"
 #include <glm/glm.hpp>
+#include <memory>
 #include <vulkan/vulkan.hpp>
 
 class Model : public Asset
@@ -11,10 +13,36 @@ class Model : public Asset
 	Model(const std::filesystem::path &path);
 	~Model();
 
-	void Load() override;
+	//unit cube that is already decoded, the AssetDB draws it in place of models that are still streaming
+	static std::unique_ptr<Model> CreateCube();
+
+	void DecodeFromMemory(std::span<const char> fileData) override;
+	void Upload(UploadBatch& batch) override;
 	void Unload() override;
 	bool IsLoaded() const override;
+	uint64_t GetGpuMemorySize() const override;
+	//models can't be partially resident, eviction drops the buffers and the model streams back in when drawn
+	uint64_t Evict(UploadBatch& batch) override;
+
+	//picks the coarsest LOD whose simplification error stays under LOD_PIXEL_ERROR on screen
+	//pixelsPerUnit is how many pixels one model unit covers at the bounding sphere's distance
+	uint32_t SelectLod(float pixelsPerUnit, uint32_t currentLod) const;
+
+	struct Lod
+	{
+		uint32_t indexOffset;
+		uint32_t indexCount;
+		float error; //root of the largest quadric error the simplifier accepted, in model units; scaled to screen-space pixels for LOD selection
+	};
 
+	constexpr static uint32_t MAX_LODS = 6;
+	//stop building the chain once a level can't drop at least this fraction of the previous one
+	constexpr static float LOD_MIN_REDUCTION = 0.9f;
+	//largest error a single simplification step may add, as a fraction of the bounding radius
+	constexpr static float LOD_MAX_STEP_ERROR = 0.1f;
+	constexpr static float LOD_PIXEL_ERROR = 1.0f;
+	//a coarser LOD has to beat the threshold by this fraction before we switch to it, stops popping back and forth
+	constexpr static float LOD_HYSTERESIS = 0.25f;
 
 	struct Vertex
 	{
@@ -53,23 +81,120 @@ class Model : public Asset
 
 			return attributeDescriptions;
 		}
+
+		//the position only stream depth only pipelines read instead, tightly packed so they fetch a third of the bytes
+		static vk::VertexInputBindingDescription getPositionBindingDescription()
+		{
+			vk::VertexInputBindingDescription bindingDescription{};
+			bindingDescription.binding = 0;
+			bindingDescription.stride = sizeof(glm::vec3);
+			bindingDescription.inputRate = vk::VertexInputRate::eVertex;
+
+			return bindingDescription;
+		}
+
+		static vk::VertexInputAttributeDescription getPositionAttributeDescription()
+		{
+			vk::VertexInputAttributeDescription attributeDescription{};
+			attributeDescription.binding = 0;
+			attributeDescription.location = 0;
+			attributeDescription.format = vk::Format::eR32G32B32Sfloat;
+			attributeDescription.offset = 0;
+
+			return attributeDescription;
+		}
+	};
+
+	//one copy of the model, read per instance from binding 1 so a single draw covers any number of copies
+	//std430 compatible, GPU culling reads the same buffer as a storage buffer
+	struct Instance
+	{
+		glm::mat4 transform{ 1.0f };
+		uint32_t materialIndex = 0;
+		uint32_t pad[3]{};
+
+		static vk::VertexInputBindingDescription getBindingDescription()
+		{
+			vk::VertexInputBindingDescription bindingDescription{};
+			bindingDescription.binding = 1;
+			bindingDescription.stride = sizeof(Instance);
+			bindingDescription.inputRate = vk::VertexInputRate::eInstance;
+
+			return bindingDescription;
+		}
+
+		//a mat4 input takes one location per column
+		static std::array<vk::VertexInputAttributeDescription, 5> getAttributeDescriptions()
+		{
+			std::array<vk::VertexInputAttributeDescription, 5> attributeDescriptions{};
+
+			for (uint32_t column = 0; column < 4; column++)
+			{
+				attributeDescriptions[column].binding = 1;
+				attributeDescriptions[column].location = 3 + column;
+				attributeDescriptions[column].format = vk::Format::eR32G32B32A32Sfloat;
+				attributeDescriptions[column].offset = offsetof(Instance, transform) + sizeof(glm::vec4) * column;
+			}
+
+			attributeDescriptions[4].binding = 1;
+			attributeDescriptions[4].location = 7;
+			attributeDescriptions[4].format = vk::Format::eR32Uint;
+			attributeDescriptions[4].offset = offsetof(Instance, materialIndex);
+
+			return attributeDescriptions;
+		}
 	};
+
+	//one draw of instanceCount copies of the LOD, taking instances firstInstance on from the stream bound at binding 1
+	void DrawInstanced(vk::CommandBuffer commandBuffer, uint32_t lod, uint32_t firstInstance, uint32_t instanceCount) const;
+
 	friend class Graphics;
+	friend class ModelCooker;
+	friend class GpuCulling;
+	friend class DrawList;
 private:
-	void DrawCmd();
+	//.kmdl files written by the ModelCooker, see ModelFile.h
+	void DecodeCooked(std::span<const char> fileData);
+	//imports a source model with assimp, false with an Error when it doesn't parse or has no triangles
+	bool DecodeSource(std::span<const char> fileData);
+	//bounds, LODs and meshlets from _vertices and _indices
+	void ProcessGeometry();
+	void BuildLods(const std::vector<glm::vec3>& positions);
+
 	//TODO: Use one vk buffer per model for vertices and indices
 	std::vector<Vertex> _vertices;
+	//all LODs back to back, LOD 0 first
 	std::vector<uint32_t> _indices;
+	std::vector<Lod> _lods;
+
+	glm::vec3 _boundsCenter{};
+	float _boundsRadius = 0;
+
+	//meshlets of LOD 0, the GPU copy keeps each array in its own aligned section of one storage buffer
+	enum MeshletSection
+	{
+		MESHLET_BOUNDS,
+		MESHLET_CONES,
+		MESHLET_RANGES,
+		MESHLET_VERTICES,
+		MESHLET_TRIANGLES,
+		MESHLET_SECTION_COUNT
+	};
+
+	MeshletData _meshlets;
+	vk::Buffer _meshletBuffer;
+	VmaAllocation _meshletBufferMemory{};
+	std::array<vk::DeviceSize, MESHLET_SECTION_COUNT> _meshletSectionOffsets{};
 
 	vk::Buffer _vertexBuffer;
-	VmaAllocation _vertexBufferMemory;
+	VmaAllocation _vertexBufferMemory{};
+	//just the positions of _vertices, see Vertex::getPositionBindingDescription
+	vk::Buffer _positionBuffer;
+	VmaAllocation _positionBufferMemory{};
 	vk::Buffer _indexBuffer;
-	VmaAllocation _indexBufferMemory;
-	
-	std::filesystem::path _modelPath;
+	VmaAllocation _indexBufferMemory{};
 
 	bool _loaded = false;
 
-	void CreateVertexBuffer();
-	void CreateIndexBuffer();
+	void UploadMeshlets(UploadBatch& batch);
 };
\ No newline at end of file
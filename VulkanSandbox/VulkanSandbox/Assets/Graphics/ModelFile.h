@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+//Cooked model layout, written by the ModelCooker so loading skips the importer, simplifier and meshlet builder
+//[ModelFileHeader][Model::Vertex x vertexCount][uint32_t index x indexCount, all LODs][Model::Lod x lodCount]
+//[meshlet bounds][meshlet cones][meshlet ranges][uint32_t x meshletVertexCount][uint32_t x meshletTriangleCount]
+struct ModelFileHeader
+{
+	constexpr static uint32_t MAGIC = 0x4C444D4B; //"KMDL"
+	constexpr static uint32_t VERSION = 1;
+
+	uint32_t magic = MAGIC;
+	uint32_t version = VERSION;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	uint32_t lodCount = 0;
+	uint32_t meshletCount = 0;
+	uint32_t meshletVertexCount = 0;
+	uint32_t meshletTriangleCount = 0;
+	float boundsCenter[3] = {};
+	float boundsRadius = 0;
+};
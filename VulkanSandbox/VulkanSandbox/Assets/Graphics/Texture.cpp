@@ -1,9 +1,15 @@
 #include "Texture.h"
 
 #include <stb_image.h>
-#include "../../Utils/CLogger.h""
+#include "../../Utils/CLogger.h"
+#include "../../Graphics/UploadBatch.h"
+#include "TextureFile.h"
+#include "../Package.h"
+#include "../Cooking/MipGenerator.h"
 
-Texture::Texture(const std::filesystem::path& path) : _path(path)
+#include <cstring>
+
+Texture::Texture(const std::filesystem::path& path) : Asset(path)
 {
 }
 
@@ -15,39 +21,217 @@ Texture::~Texture()
     }
 }
 
-void Texture::Load()
+std::unique_ptr<Texture> Texture::CreateSolid(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(_path.string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    const vk::DeviceSize imageSize = static_cast<vk::DeviceSize>(texWidth) * texHeight * 4;
+    auto texture = std::make_unique<Texture>("");
 
-    Assert(pixels, "Could not load texture!");
+    texture->_width = 1;
+    texture->_height = 1;
+    texture->_data = { r, g, b, a };
+    texture->_mipData = texture->_data;
+    texture->_mipOffsets = { 0 };
 
-    Graphics::_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+    return texture;
+}
 
-    Graphics::CreateBuffer(imageSize, vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-        Graphics::_stagingBuffer, Graphics::_stagingBufferMemory, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+void Texture::DecodeFromMemory(std::span<const char> fileData)
+{
+    TextureFileHeader header;
 
-    void* data;
-    VkResult result = vmaMapMemory(Graphics::_allocator, Graphics::_stagingBufferMemory, &data);
-    Assert(result == VK_SUCCESS, "Failed to map texture memory!", { {"Error Code", static_cast<uint32_t>(result)} });
-    memcpy(data, pixels, imageSize);
-    vmaUnmapMemory(Graphics::_allocator, Graphics::_stagingBufferMemory);
+    if (fileData.size() >= sizeof(header))
+    {
+        memcpy(&header, fileData.data(), sizeof(header));
 
+        if (header.magic == TextureFileHeader::MAGIC)
+        {
+            DecodeCooked(fileData);
+            return;
+        }
+    }
+
+    int texChannels;
+    stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(fileData.data()), static_cast<int>(fileData.size()),
+        &_width, &_height, &texChannels, STBI_rgb_alpha);
+
+    Assert(pixels, "Could not load texture!", { {"Path", _path.string()} });
+
+    MipImage image{ std::vector<uint8_t>(pixels, pixels + static_cast<size_t>(_width) * _height * 4),
+        static_cast<uint32_t>(_width), static_cast<uint32_t>(_height) };
     stbi_image_free(pixels);
 
-    Graphics::CreateImage(texWidth, texHeight, Graphics::_mipLevels, vk::SampleCountFlagBits::e1, vk::Format::eR8G8B8A8Srgb,
+    //we're already on a worker, so the mips get built here rather than blitted on the GPU at upload
+    const std::vector<MipImage> mips = MipGenerator::Generate(std::move(image), MipFilter::Box, MipColorSpace::Srgb);
+
+    _data.clear();
+    _mipOffsets.resize(mips.size());
+
+    for (size_t i = 0; i < mips.size(); ++i)
+    {
+        _mipOffsets[i] = i == 0 ? 0 : _mipOffsets[i - 1] + mips[i - 1].rgba.size();
+    }
+
+    _data.reserve(_mipOffsets.back() + mips.back().rgba.size());
+
+    for (size_t i = 0; i < mips.size(); ++i)
+    {
+        _data.insert(_data.end(), mips[i].rgba.begin(), mips[i].rgba.end());
+    }
+
+    _mipData = _data;
+    _format = vk::Format::eR8G8B8A8Srgb;
+    _mipLevels = static_cast<uint32_t>(mips.size());
+}
+
+void Texture::DecodeCooked(std::span<const char> fileData)
+{
+    TextureFileHeader header;
+    memcpy(&header, fileData.data(), sizeof(header));
+
+    Assert(header.version == TextureFileHeader::VERSION, "Cooked texture is from another version of the cooker!",
+        { {"Path", _path.string()}, {"Version", header.version} });
+    Assert(header.mipCount > 0 && fileData.size() >= sizeof(header) + sizeof(TextureFileMip) * header.mipCount,
+        "Cooked texture is truncated!", { {"Path", _path.string()} });
+
+    std::vector<TextureFileMip> mips(header.mipCount);
+    memcpy(mips.data(), fileData.data() + sizeof(header), sizeof(TextureFileMip) * mips.size());
+
+    //the cooker writes the mips back to back, so they go up in one piece
+    const uint64_t dataBegin = mips.front().offset;
+    const uint64_t dataEnd = mips.back().offset + mips.back().size;
+
+    Assert(dataEnd <= fileData.size(), "Cooked texture is truncated!", { {"Path", _path.string()} });
+
+    //a packaged texture streams its mips straight from the mapping, a loose file's bytes go away after decoding
+    if (Package::IsMapped(fileData.data()))
+    {
+        _data.clear();
+        _mipData = { reinterpret_cast<const uint8_t*>(fileData.data() + dataBegin), dataEnd - dataBegin };
+    }
+    else
+    {
+        _data.assign(fileData.begin() + dataBegin, fileData.begin() + dataEnd);
+        _mipData = _data;
+    }
+
+    _mipOffsets.resize(mips.size());
+
+    for (size_t i = 0; i < mips.size(); ++i)
+    {
+        _mipOffsets[i] = mips[i].offset - dataBegin;
+    }
+
+    _format = static_cast<vk::Format>(header.format);
+    _width = static_cast<int>(header.width);
+    _height = static_cast<int>(header.height);
+    _mipLevels = header.mipCount;
+}
+
+void Texture::Upload(UploadBatch& batch)
+{
+    uint32_t firstMip = 0;
+
+    while (firstMip + 1 < _mipLevels && std::max(_width >> firstMip, _height >> firstMip) > MIP_TAIL_SIZE)
+    {
+        firstMip++;
+    }
+
+    //streaming back in over an evicted copy that frames in flight may still be sampling
+    //start from the detail it already shows so the texture never gets blurrier on the way back up
+    if (IsLoaded())
+    {
+        while (firstMip > 0 && std::max(_width >> firstMip, 1) < _visibleWidth)
+        {
+            firstMip--;
+        }
+
+        RetireImage();
+    }
+
+    const vk::DeviceSize tailOffset = _mipOffsets[firstMip];
+    vk::Buffer stagingBuffer = batch.Stage(_mipData.data() + tailOffset, _mipData.size() - tailOffset);
+
+    std::vector<vk::DeviceSize> tailOffsets(_mipOffsets.begin() + firstMip, _mipOffsets.end());
+
+    for (vk::DeviceSize& offset : tailOffsets)
+    {
+        offset -= tailOffset;
+    }
+
+    Graphics::CreateImage(_width, _height, _mipLevels, vk::SampleCountFlagBits::e1, _format,
         vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
         vk::MemoryPropertyFlagBits::eDeviceLocal,
         _textureImage, _textureImageMemory);
 
-    Graphics::TransitionImageLayout(_textureImage, vk::Format::eR8G8B8A8Srgb, Graphics::_mipLevels,
+    vk::CommandBuffer commandBuffer = batch.GetCommandBuffer();
+
+    Graphics::TransitionImageLayout(commandBuffer, _textureImage, _format, _mipLevels,
         vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-    Graphics::CopyBufferToImage(Graphics::_stagingBuffer, _textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-    Graphics::GenerateMipmaps(_textureImage, vk::Format::eR8G8B8A8Srgb, texWidth, texHeight, Graphics::_mipLevels);
+    Graphics::CopyBufferToImageMips(commandBuffer, stagingBuffer, _textureImage, static_cast<uint32_t>(_width), static_cast<uint32_t>(_height),
+        tailOffsets, firstMip);
+    Graphics::TransitionImageLayout(commandBuffer, _textureImage, _format, _mipLevels - firstMip,
+        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, firstMip);
+
+    _residentMip = firstMip;
+    _streamMip = firstMip;
+
+    if (firstMip == 0)
+    {
+        ReleaseData();
+    }
+
+    CreateImageView();
+}
+
+bool Texture::HasMoreToStream() const
+{
+    return IsLoaded() && _streamMip > 0;
+}
+
+uint64_t Texture::StreamNext(UploadBatch& batch)
+{
+    if (!HasMoreToStream())
+    {
+        return 0;
+    }
+
+    _streamMip--;
+
+    //the tail went up first, so the next mip always has data after it
+    const vk::DeviceSize offset = _mipOffsets[_streamMip];
+    const vk::DeviceSize size = _mipOffsets[_streamMip + 1] - offset;
+    vk::Buffer stagingBuffer = batch.Stage(_mipData.data() + offset, size);
+
+    vk::CommandBuffer commandBuffer = batch.GetCommandBuffer();
+
+    //the other mips stay in whatever layout they're in, the view doesn't reach this one yet
+    Graphics::CopyBufferToImageMips(commandBuffer, stagingBuffer, _textureImage, static_cast<uint32_t>(_width), static_cast<uint32_t>(_height),
+        { 0 }, _streamMip);
+    Graphics::TransitionImageLayout(commandBuffer, _textureImage, _format, 1,
+        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, _streamMip);
+
+    if (_streamMip == 0)
+    {
+        ReleaseData();
+    }
+
+    return size;
+}
+
+void Texture::OnStreamed()
+{
+    //a reupload since the mip was recorded already covers it
+    if (_residentMip == _streamMip)
+    {
+        return;
+    }
+
+    _residentMip--;
+
+    Graphics::DeferDestroy([imageView = _textureImageView]()
+        {
+            Graphics::_device.destroyImageView(imageView, nullptr);
+        });
 
-    vmaDestroyBuffer(Graphics::_allocator, Graphics::_stagingBuffer, Graphics::_stagingBufferMemory);
     CreateImageView();
 }
 
@@ -55,6 +239,9 @@ void Texture::Unload()
 {
 	Graphics::_device.destroyImageView(_textureImageView, nullptr);
     vmaDestroyImage(Graphics::_allocator, _textureImage, _textureImageMemory);
+
+    _textureImageView = nullptr;
+    _textureImage = nullptr;
 }
 
 bool Texture::IsLoaded() const
@@ -62,12 +249,116 @@ bool Texture::IsLoaded() const
     return _textureImage;
 }
 
+uint64_t Texture::GetGpuMemorySize() const
+{
+    if (!IsLoaded())
+    {
+        return 0;
+    }
+
+    VmaAllocationInfo allocationInfo;
+    vmaGetAllocationInfo(Graphics::_allocator, _textureImageMemory, &allocationInfo);
+
+    return allocationInfo.size;
+}
+
+uint64_t Texture::Evict(UploadBatch& batch)
+{
+    //still streaming, the lower mips aren't all in a layout we can copy from yet
+    if (!IsLoaded() || _residentMip > 0 || _mipLevels <= 1 || std::max(_width, _height) / 2 < MIN_RESIDENT_SIZE)
+    {
+        return 0;
+    }
+
+    const uint64_t oldSize = GetGpuMemorySize();
+    const int width = std::max(_width / 2, 1);
+    const int height = std::max(_height / 2, 1);
+    const uint32_t mipLevels = _mipLevels - 1;
+
+    vk::Image image;
+    VmaAllocation imageMemory;
+    Graphics::CreateImage(width, height, mipLevels, vk::SampleCountFlagBits::e1, _format,
+        vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        image, imageMemory);
+
+    vk::CommandBuffer commandBuffer = batch.GetCommandBuffer();
+
+    Graphics::TransitionImageLayout(commandBuffer, _textureImage, _format, _mipLevels,
+        vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal);
+    Graphics::TransitionImageLayout(commandBuffer, image, _format, mipLevels,
+        vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+    Graphics::CopyImageMips(commandBuffer, _textureImage, 1, image, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipLevels);
+    Graphics::TransitionImageLayout(commandBuffer, image, _format, mipLevels,
+        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    RetireImage();
+
+    _textureImage = image;
+    _textureImageMemory = imageMemory;
+    _width = width;
+    _height = height;
+    _mipLevels = mipLevels;
+
+    CreateImageView();
+
+    return oldSize - GetGpuMemorySize();
+}
+
+void Texture::RetireImage()
+{
+    Graphics::DeferDestroy([imageView = _textureImageView, image = _textureImage, imageMemory = _textureImageMemory]()
+        {
+            Graphics::_device.destroyImageView(imageView, nullptr);
+            vmaDestroyImage(Graphics::_allocator, image, imageMemory);
+        });
+
+    _textureImageView = nullptr;
+    _textureImage = nullptr;
+    _textureImageMemory = nullptr;
+}
+
+void Texture::ReleaseData()
+{
+    _data.clear();
+    _data.shrink_to_fit();
+    _mipData = {};
+    _mipOffsets.clear();
+}
+
 void Texture::CreateImageView()
 {
-    _textureImageView = Graphics::CreateImageView(_textureImage, vk::Format::eR8G8B8A8Srgb,
-        Graphics::_mipLevels, vk::ImageAspectFlagBits::eColor);
+    _textureImageView = Graphics::CreateImageView(_textureImage, _format,
+        _mipLevels - _residentMip, vk::ImageAspectFlagBits::eColor, _residentMip);
+    _visibleWidth = std::max(_width >> _residentMip, 1);
+
+    CreateTextureSampler();
 }
 
 void Texture::CreateTextureSampler()
 {
+    SamplerDesc desc = _samplerDesc;
+    desc.minLod = std::max(std::max(desc.minLod, _lodClamp) - static_cast<float>(_residentMip), 0.0f);
+
+    _sampler = SamplerCache::Get(desc);
+}
+
+void Texture::SetSampler(const SamplerDesc& desc)
+{
+    _samplerDesc = desc;
+
+    if (IsLoaded())
+    {
+        CreateTextureSampler();
+    }
+}
+
+void Texture::SetLodClamp(float finestMip)
+{
+    _lodClamp = finestMip;
+
+    if (IsLoaded())
+    {
+        CreateTextureSampler();
+    }
 }
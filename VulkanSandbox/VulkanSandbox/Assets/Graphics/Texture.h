@@ -1,21 +1,75 @@
 #pragma once
 #include "../Asset.h"
 #include "../../Graphics/Graphics.h"
+#include "../../Graphics/SamplerCache.h"
 
-class Texture : Asset
+#include <memory>
+#include <span>
+
+class Texture : public Asset
 {
 public:
 	Texture(const std::filesystem::path& path);
 	~Texture();
-	void Load() override;
+	//a texture that is already decoded, the AssetDB shows it in place of textures that are still streaming
+	static std::unique_ptr<Texture> CreateSolid(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+	void DecodeFromMemory(std::span<const char> fileData) override;
+	void Upload(UploadBatch& batch) override;
 	void Unload() override;
 	[[nodiscard]] bool IsLoaded() const override;
+	uint64_t GetGpuMemorySize() const override;
+	//drops the top mip, the rest stays sampleable so the texture only gets blurrier
+	uint64_t Evict(UploadBatch& batch) override;
+	//Upload only brings the mip tail, the bigger mips follow one per call, smallest first
+	bool HasMoreToStream() const override;
+	uint64_t StreamNext(UploadBatch& batch) override;
+	//moves the view's base mip up to the mip that just landed
+	void OnStreamed() override;
+
+	//filtering and addressing for this texture, the sampler itself comes from the SamplerCache
+	void SetSampler(const SamplerDesc& desc);
+	//never samples mips finer than finestMip (of the full chain), for quality tiers and for easing streamed mips in
+	//without evicting anything, 0 lifts the clamp
+	void SetLodClamp(float finestMip);
+	vk::Sampler GetSampler() const { return _sampler; }
+
+	//eviction stops once the top mip would be smaller than this
+	constexpr static int MIN_RESIDENT_SIZE = 64;
+	//every mip this size and smaller goes up with Upload, so the texture can be drawn right away
+	constexpr static int MIP_TAIL_SIZE = 64;
 	friend class Graphics;
 private:
+	//covers the resident mips only, sampling can't reach mips that are still streaming
 	void CreateImageView();
+	//the view's base mip moved or the desc changed, the LOD clamp is relative to the view
 	void CreateTextureSampler();
+	//drops the CPU copy once every mip is on the GPU
+	void ReleaseData();
+	//hands the current image to Graphics::DeferDestroy
+	void RetireImage();
+	//.ktex files from the TextureCooker, everything else goes through stb_image and the MipGenerator
+	void DecodeCooked(std::span<const char> fileData);
 	vk::Image _textureImage;
 	VmaAllocation _textureImageMemory{};
 	vk::ImageView _textureImageView;
-	const std::filesystem::path _path;
-};
\ No newline at end of file
+	vk::Sampler _sampler;
+	SamplerDesc _samplerDesc;
+	float _lodClamp = 0.0f;
+	vk::Format _format = vk::Format::eR8G8B8A8Srgb;
+	uint32_t _mipLevels = 1;
+
+	//decoded mips back to back, held from Decode until the last mip has streamed
+	//they live in _data, or straight in the package mapping for packaged cooked textures
+	std::span<const uint8_t> _mipData;
+	std::vector<uint8_t> _data;
+	std::vector<vk::DeviceSize> _mipOffsets;
+	//first mip the view shows, everything below it in the chain is uploaded
+	uint32_t _residentMip = 0;
+	//first mip recorded for upload, the ones between it and _residentMip are still in flight
+	uint32_t _streamMip = 0;
+	//size of the most detailed mip the view shows, decoding a reload doesn't touch it
+	int _visibleWidth = 0;
+	//size of mip 0 of the image
+	int _width = 0;
+	int _height = 0;
+};
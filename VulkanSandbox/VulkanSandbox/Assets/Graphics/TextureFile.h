@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+
+//Cooked texture layout, written by the TextureCooker and read straight into a staging buffer at runtime
+//[TextureFileHeader][TextureFileMip x mipCount][mip data, largest mip first]
+//every mip is already in the GPU's block layout, tightly packed rows of 4x4 blocks
+struct TextureFileHeader
+{
+	constexpr static uint32_t MAGIC = 0x5845544B; //"KTEX"
+	constexpr static uint32_t VERSION = 1;
+
+	uint32_t magic = MAGIC;
+	uint32_t version = VERSION;
+	uint32_t format = 0; //VkFormat
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mipCount = 0;
+};
+
+struct TextureFileMip
+{
+	uint64_t offset; //from the start of the file
+	uint64_t size;
+};
@@ -0,0 +1,83 @@
+#include "LiveReload.h"
+
+#include "AssetDB.h"
+#include "Package.h"
+#include "Cooking/Cooker.h"
+#include "../Utils/CLogger.h"
+
+using namespace std;
+
+void LiveReload::Init(const vector<filesystem::path>& roots)
+{
+    _watcher = make_unique<FileWatcher>();
+    _roots = roots;
+    _dirty = false;
+
+    for (const filesystem::path& root : roots)
+    {
+        if (!_watcher->Watch(root))
+        {
+            Error("Can't watch source directory, changes to it won't be reloaded", { {"Path", root.string()} });
+        }
+    }
+}
+
+void LiveReload::DeInit()
+{
+    //the cook job writes into the Build tree and _cooked
+    JobSystem::Wait(_cookCounter);
+
+    _watcher.reset();
+    _cooked.clear();
+}
+
+void LiveReload::Update()
+{
+    if (!_watcher)
+    {
+        return;
+    }
+
+    vector<filesystem::path> changed;
+    _watcher->Poll(changed);
+
+    //any change cooks, shader includes have no rule of their own and the manifest knows which outputs depend on what
+    for (const filesystem::path& path : changed)
+    {
+        Log("Source changed", { {"Path", path.string()} });
+        _dirty = true;
+    }
+
+    vector<filesystem::path> cooked;
+
+    {
+        scoped_lock lock(_cookedMutex);
+        cooked.swap(_cooked);
+    }
+
+    for (const filesystem::path& output : cooked)
+    {
+        //the package still has the copy from startup
+        Package::OverrideWithLooseFile(output);
+        AssetDB::Reload(output);
+    }
+
+    //one cook at a time, they share the manifest, changes that land meanwhile wait for the next one
+    if (_dirty && _cookCounter.Done())
+    {
+        StartCook();
+    }
+}
+
+void LiveReload::StartCook()
+{
+    _dirty = false;
+
+    JobSystem::Submit([]()
+        {
+            vector<filesystem::path> cooked = Cooker::CookAll(_roots);
+
+            scoped_lock lock(_cookedMutex);
+            _cooked.insert(_cooked.end(), cooked.begin(), cooked.end());
+        }, _cookCounter);
+}
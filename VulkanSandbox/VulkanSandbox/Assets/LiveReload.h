@@ -0,0 +1,34 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../Utils/FileWatcher.h"
+#include "../Utils/JobSystem.h"
+
+//Watches the source data while the game runs. A changed source gets recooked on the job system,
+//then every loaded asset cooked from it is reloaded by the AssetDB and swapped in at a frame boundary
+class LiveReload
+{
+public:
+	//roots are the same source directories the Cooker cooks at startup
+	static void Init(const std::vector<std::filesystem::path>& roots);
+	static void DeInit();
+
+	//main thread, once per frame before AssetDB::Update
+	static void Update();
+
+private:
+	static void StartCook();
+
+	inline static std::unique_ptr<FileWatcher> _watcher;
+	inline static std::vector<std::filesystem::path> _roots;
+
+	inline static JobCounter _cookCounter;
+	//sources changed while a cook was already running, they get a cook of their own after it
+	inline static bool _dirty = false;
+	//outputs the last cook wrote, filled by the cook job and drained by Update
+	inline static std::vector<std::filesystem::path> _cooked;
+	inline static std::mutex _cookedMutex;
+};
@@ -0,0 +1,289 @@
+#include "Package.h"
+
+#include <algorithm>
+#include <cstring>
+#include <lz4.h>
+#include <lz4hc.h>
+
+#include "../Utils/CLogger.h"
+#include "../Utils/JobSystem.h"
+#include "../Utils/utils.h"
+
+using namespace std;
+
+static uint64_t AlignBlob(uint64_t offset)
+{
+    return (offset + PackageFileHeader::BLOB_ALIGNMENT - 1) & ~(PackageFileHeader::BLOB_ALIGNMENT - 1);
+}
+
+static vector<filesystem::path> CollectFiles(const vector<filesystem::path>& roots)
+{
+    vector<filesystem::path> files;
+
+    for (const filesystem::path& root : roots)
+    {
+        if (!filesystem::exists(root))
+        {
+            continue;
+        }
+
+        for (const filesystem::directory_entry& fileIt : filesystem::recursive_directory_iterator(root))
+        {
+            if (fileIt.is_regular_file())
+            {
+                files.push_back(fileIt.path());
+            }
+        }
+    }
+
+    return files;
+}
+
+void Package::BuildIfStale(const vector<filesystem::path>& roots, const filesystem::path& dest)
+{
+    if (filesystem::exists(dest))
+    {
+        const filesystem::file_time_type packageTime = filesystem::last_write_time(dest);
+        const vector<filesystem::path> files = CollectFiles(roots);
+
+        if (none_of(files.begin(), files.end(), [&](const filesystem::path& file) { return filesystem::last_write_time(file) > packageTime; }))
+        {
+            return;
+        }
+    }
+
+    Build(roots, dest);
+}
+
+void Package::Build(const vector<filesystem::path>& roots, const filesystem::path& dest)
+{
+    Log("Building package...", { {"Output Dest.", dest.string()} });
+
+    struct Blob
+    {
+        PackageFileEntry entry;
+        vector<char> data;
+    };
+
+    const vector<filesystem::path> files = CollectFiles(roots);
+    vector<Blob> blobs(files.size());
+
+    JobSystem::ParallelFor(files.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                Blob& blob = blobs[i];
+                loadWholeBinFile(files[i].string().c_str(), blob.data);
+
+                blob.entry = { HashPath(files[i]), 0, blob.data.size(), blob.data.size(), PackageCompression::None, 0 };
+
+                if (blob.data.empty() || blob.data.size() > LZ4_MAX_INPUT_SIZE)
+                {
+                    continue;
+                }
+
+                const int sourceSize = static_cast<int>(blob.data.size());
+                vector<char> compressed(LZ4_compressBound(sourceSize));
+                const int compressedSize = LZ4_compress_HC(blob.data.data(), compressed.data(), sourceSize,
+                    static_cast<int>(compressed.size()), LZ4HC_CLEVEL_DEFAULT);
+
+                //already compressed data (block compressed mips, jpgs) barely shrinks, keep that mappable
+                if (compressedSize > 0 && static_cast<uint64_t>(compressedSize) <= blob.data.size() - blob.data.size() / COMPRESSION_MIN_SAVING)
+                {
+                    compressed.resize(compressedSize);
+                    blob.data = move(compressed);
+                    blob.entry.storedSize = blob.data.size();
+                    blob.entry.compression = PackageCompression::LZ4;
+                }
+            }
+        });
+
+    sort(blobs.begin(), blobs.end(), [](const Blob& a, const Blob& b) { return a.entry.pathHash < b.entry.pathHash; });
+
+    for (size_t i = 1; i < blobs.size(); ++i)
+    {
+        Assert(blobs[i - 1].entry.pathHash != blobs[i].entry.pathHash, "Two packaged paths hash the same!", { {"Hash", blobs[i].entry.pathHash} });
+    }
+
+    PackageFileHeader header;
+    header.entryCount = static_cast<uint32_t>(blobs.size());
+
+    vector<PackageFileEntry> entries(blobs.size());
+    uint64_t offset = AlignBlob(sizeof(header) + sizeof(PackageFileEntry) * entries.size());
+    uint64_t storedBytes = 0;
+    uint64_t sourceBytes = 0;
+
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+        blobs[i].entry.offset = offset;
+        entries[i] = blobs[i].entry;
+        offset = AlignBlob(offset + blobs[i].entry.storedSize);
+
+        storedBytes += blobs[i].entry.storedSize;
+        sourceBytes += blobs[i].entry.size;
+    }
+
+    filesystem::create_directories(dest.parent_path());
+
+    FILE* file = nullptr;
+    errno_t err = fopen_s(&file, dest.string().c_str(), "wb");
+
+    Assert(file, "Failed to open package for writing", { {"file", dest.string()}, {"error code", err} });
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(entries.data(), sizeof(PackageFileEntry), entries.size(), file);
+
+    const vector<char> padding(PackageFileHeader::BLOB_ALIGNMENT, 0);
+    uint64_t written = sizeof(header) + sizeof(PackageFileEntry) * entries.size();
+
+    for (const Blob& blob : blobs)
+    {
+        fwrite(padding.data(), 1, blob.entry.offset - written, file);
+        fwrite(blob.data.data(), 1, blob.data.size(), file);
+        written = blob.entry.offset + blob.data.size();
+    }
+
+    fclose(file);
+
+    Log("Built package", { {"File count", blobs.size()}, {"Source bytes", sourceBytes}, {"Stored bytes", storedBytes}, {"Package bytes", written} });
+}
+
+bool Package::Mount(const filesystem::path& path)
+{
+    Unmount();
+
+    if (!_file.Open(path))
+    {
+        return false;
+    }
+
+    PackageFileHeader header;
+    bool valid = _file.GetSize() >= sizeof(header);
+
+    if (valid)
+    {
+        memcpy(&header, _file.GetData(), sizeof(header));
+        valid = header.magic == PackageFileHeader::MAGIC && header.version == PackageFileHeader::VERSION
+            && _file.GetSize() >= sizeof(header) + sizeof(PackageFileEntry) * header.entryCount;
+    }
+
+    //every blob gets bounds checked once here so reads never have to
+    const PackageFileEntry* entries = reinterpret_cast<const PackageFileEntry*>(_file.GetData() + sizeof(header));
+
+    for (uint32_t i = 0; valid && i < header.entryCount; ++i)
+    {
+        valid = entries[i].offset <= _file.GetSize() && entries[i].storedSize <= _file.GetSize() - entries[i].offset
+            && (entries[i].compression == PackageCompression::None ? entries[i].storedSize == entries[i].size : entries[i].compression == PackageCompression::LZ4);
+    }
+
+    if (!valid)
+    {
+        Error("Package is corrupt or from another version, reading loose files instead", { {"Path", path.string()} });
+        _file.Close();
+        return false;
+    }
+
+    _entries = entries;
+    _entryCount = header.entryCount;
+
+    Log("Mounted package", { {"Path", path.string()}, {"File count", _entryCount}, {"Package bytes", _file.GetSize()} });
+
+    return true;
+}
+
+void Package::Unmount()
+{
+    _file.Close();
+    _entries = nullptr;
+    _entryCount = 0;
+
+    scoped_lock lock(_overrideMutex);
+    _overridden.clear();
+}
+
+span<const char> Package::ReadFile(const filesystem::path& path, vector<char>& storage)
+{
+    if (optional<span<const char>> packaged = ReadPackaged(path, storage))
+    {
+        return *packaged;
+    }
+
+    loadWholeBinFile(path.string().c_str(), storage);
+    return storage;
+}
+
+optional<span<const char>> Package::ReadPackaged(const filesystem::path& path, vector<char>& storage)
+{
+    const PackageFileEntry* entry = Find(path);
+
+    if (!entry)
+    {
+        return nullopt;
+    }
+
+    const char* blob = _file.GetData() + entry->offset;
+
+    if (entry->compression == PackageCompression::None)
+    {
+        return span<const char>(blob, entry->size);
+    }
+
+    storage.resize(entry->size);
+
+    const int size = LZ4_decompress_safe(blob, storage.data(), static_cast<int>(entry->storedSize), static_cast<int>(entry->size));
+
+    Assert(size >= 0 && static_cast<uint64_t>(size) == entry->size, "Packaged file failed to decompress!", { {"Path", path.string()} });
+
+    return span<const char>(storage);
+}
+
+bool Package::IsMapped(const void* ptr)
+{
+    return _file.Contains(ptr);
+}
+
+void Package::OverrideWithLooseFile(const filesystem::path& path)
+{
+    scoped_lock lock(_overrideMutex);
+    _overridden.insert(HashPath(path));
+}
+
+uint64_t Package::HashPath(const filesystem::path& path)
+{
+    string key = path.lexically_normal().generic_string();
+    transform(key.begin(), key.end(), key.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+    uint64_t hash = 14695981039346656037ull;
+
+    for (char c : key)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+const PackageFileEntry* Package::Find(const filesystem::path& path)
+{
+    if (!_entries)
+    {
+        return nullptr;
+    }
+
+    const uint64_t hash = HashPath(path);
+
+    {
+        scoped_lock lock(_overrideMutex);
+
+        if (_overridden.contains(hash))
+        {
+            return nullptr;
+        }
+    }
+
+    const PackageFileEntry* end = _entries + _entryCount;
+    const PackageFileEntry* entry = lower_bound(_entries, end, hash, [](const PackageFileEntry& e, uint64_t h) { return e.pathHash < h; });
+
+    return entry != end && entry->pathHash == hash ? entry : nullptr;
+}
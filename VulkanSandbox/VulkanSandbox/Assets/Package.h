@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_set>
+#include <vector>
+
+#include "PackageFile.h"
+#include "../Utils/MappedFile.h"
+
+//Every file the game reads at runtime packed into one memory mapped file (see PackageFile.h)
+//Files are looked up by a hash of their path, so callers keep using the same paths as for loose files
+//and anything missing from the package is read from disk instead
+class Package
+{
+public:
+	//packs every file under roots into dest when dest is missing or older than any of them
+	static void BuildIfStale(const std::vector<std::filesystem::path>& roots, const std::filesystem::path& dest);
+	static void Build(const std::vector<std::filesystem::path>& roots, const std::filesystem::path& dest);
+
+	//maps the package for the lifetime of the game, false if there isn't a usable one
+	static bool Mount(const std::filesystem::path& path);
+	static void Unmount();
+
+	//the file's bytes, straight from the mapping when the package stores it uncompressed
+	//otherwise it is decompressed or read from disk into storage and the span points there
+	//thread safe while the package stays mounted
+	static std::span<const char> ReadFile(const std::filesystem::path& path, std::vector<char>& storage);
+	//same as ReadFile but empty for files that aren't in the package, for callers that read loose files their own way
+	static std::optional<std::span<const char>> ReadPackaged(const std::filesystem::path& path, std::vector<char>& storage);
+	//bytes handed out from the mapping stay valid until Unmount, anything else the caller has to copy
+	static bool IsMapped(const void* ptr);
+	//the loose file was rewritten after the package was built (live reload), later reads of path go to disk
+	static void OverrideWithLooseFile(const std::filesystem::path& path);
+
+	//FNV-1a over the normalized, lower case generic path, "./Data/a.png" and "data/A.png" hash the same
+	static uint64_t HashPath(const std::filesystem::path& path);
+
+	//default package location, next to the cooked data it is built from
+	inline static const std::filesystem::path PACKAGE_PATH = "Build/Data.kpak";
+	//blobs are only stored compressed when it saves at least 1/COMPRESSION_MIN_SAVING of them
+	constexpr static uint64_t COMPRESSION_MIN_SAVING = 8;
+
+private:
+	static const PackageFileEntry* Find(const std::filesystem::path& path);
+
+	inline static MappedFile _file;
+	inline static const PackageFileEntry* _entries = nullptr;
+	inline static uint32_t _entryCount = 0;
+	//path hashes Find skips, guarded since reads come from the I/O thread
+	inline static std::unordered_set<uint64_t> _overridden;
+	inline static std::mutex _overrideMutex;
+};
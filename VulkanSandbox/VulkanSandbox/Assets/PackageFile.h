@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+//Asset package layout, written by Package::Build and mapped into memory at runtime
+//[PackageFileHeader][PackageFileEntry x entryCount, sorted by pathHash][blobs, each starting on a BLOB_ALIGNMENT boundary]
+//blobs that are stored uncompressed can be read straight out of the mapping
+struct PackageFileHeader
+{
+	constexpr static uint32_t MAGIC = 0x4B41504B; //"KPAK"
+	constexpr static uint32_t VERSION = 1;
+	//page size, so a blob never shares a page with the one before it
+	constexpr static uint64_t BLOB_ALIGNMENT = 4096;
+
+	uint32_t magic = MAGIC;
+	uint32_t version = VERSION;
+	uint32_t entryCount = 0;
+	uint32_t reserved = 0;
+};
+
+enum class PackageCompression : uint32_t
+{
+	None,
+	LZ4
+};
+
+struct PackageFileEntry
+{
+	uint64_t pathHash; //Package::HashPath of the path the file is opened with
+	uint64_t offset; //from the start of the file
+	uint64_t storedSize; //bytes in the package
+	uint64_t size; //bytes once decompressed
+	PackageCompression compression;
+	uint32_t reserved;
+};
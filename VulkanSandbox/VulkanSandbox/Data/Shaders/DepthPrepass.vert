@@ -0,0 +1,22 @@
+#version 450
+
+//Depth only pass ahead of the color pass, positions are their own stream and there's no fragment shader
+//gl_Position has to come out bit for bit the same as VertShader.vert's, the color pass tests depth for equal
+
+layout(binding = 0) uniform MVP
+{   
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} mvp;
+
+layout(location = 0) in vec3 inPosition;
+
+//per instance, see Model::Instance
+layout(location = 3) in mat4 inTransform;
+
+invariant gl_Position;
+
+void main() {
+    gl_Position = mvp.proj * mvp.view * mvp.model * inTransform * vec4(inPosition, 1.0);
+}
@@ -2,6 +2,8 @@
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+//there is a single texture for now, this picks the material once there is a table of them
+layout(location = 2) flat in uint fragMaterialIndex;
 
 layout(location = 0) out vec4 outColor;
 
@@ -7,16 +7,24 @@ layout(binding = 0) uniform MVP
     mat4 proj;
 } mvp;
 
-
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+//per instance, see Model::Instance
+layout(location = 3) in mat4 inTransform;
+layout(location = 7) in uint inMaterialIndex;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterialIndex;
+
+//the depth prepass has to produce the same depth, see DepthPrepass.vert
+invariant gl_Position;
 
 void main() {
-    gl_Position = mvp.proj * mvp.view * mvp.model * vec4(inPosition, 1.0);
+    gl_Position = mvp.proj * mvp.view * mvp.model * inTransform * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
+    fragMaterialIndex = inMaterialIndex;
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "DrawList.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include "../Assets/Graphics/Model.h"
+
+using namespace std;
+
+static_assert(DrawList::PASS_BITS + DrawList::PIPELINE_BITS + DrawList::MATERIAL_BITS + DrawList::MESH_BITS + DrawList::DEPTH_BITS == 64,
+    "Sort key fields have to fill 64 bits");
+
+static uint64_t FieldMask(uint32_t bits)
+{
+    return (1ull << bits) - 1;
+}
+
+uint64_t DrawList::MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth)
+{
+    uint64_t key = pass & FieldMask(PASS_BITS);
+    key = (key << PIPELINE_BITS) | (pipeline & FieldMask(PIPELINE_BITS));
+    key = (key << MATERIAL_BITS) | (material & FieldMask(MATERIAL_BITS));
+    key = (key << MESH_BITS) | (mesh & FieldMask(MESH_BITS));
+    key = (key << DEPTH_BITS) | (depth & FieldMask(DEPTH_BITS));
+
+    return key;
+}
+
+uint32_t DrawList::QuantizeDepth(float depth)
+{
+    return static_cast<uint32_t>(clamp(depth, 0.0f, 1.0f) * static_cast<float>(FieldMask(DEPTH_BITS)));
+}
+
+void DrawList::Add(uint64_t key, const Draw& draw)
+{
+    _order.push_back(static_cast<uint32_t>(_draws.size()));
+    _keys.push_back(key);
+    _draws.push_back(draw);
+    _sorted = false;
+}
+
+void DrawList::Clear()
+{
+    _keys.clear();
+    _order.clear();
+    _draws.clear();
+    _sorted = true;
+    _stats = { .sortMs = _stats.sortMs };
+}
+
+void DrawList::Reserve(size_t count)
+{
+    _keys.reserve(count);
+    _order.reserve(count);
+    _draws.reserve(count);
+}
+
+void DrawList::Sort()
+{
+    const auto start = chrono::steady_clock::now();
+    const size_t count = _keys.size();
+
+    //every byte's histogram in one read of the keys
+    array<array<uint32_t, 256>, sizeof(uint64_t)> histograms{};
+
+    for (uint64_t key : _keys)
+    {
+        for (uint32_t byte = 0; byte < sizeof(uint64_t); byte++)
+        {
+            histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+        }
+    }
+
+    _scratchKeys.resize(count);
+    _scratchOrder.resize(count);
+
+    for (uint32_t byte = 0; byte < sizeof(uint64_t); byte++)
+    {
+        array<uint32_t, 256>& histogram = histograms[byte];
+
+        //all keys in one bucket, the pass wouldn't move anything
+        if (count == 0 || histogram[(_keys[0] >> (byte * 8)) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+
+        for (uint32_t& bucket : histogram)
+        {
+            const uint32_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint32_t destination = histogram[(_keys[i] >> (byte * 8)) & 0xFF]++;
+
+            _scratchKeys[destination] = _keys[i];
+            _scratchOrder[destination] = _order[i];
+        }
+
+        _keys.swap(_scratchKeys);
+        _order.swap(_scratchOrder);
+    }
+
+    _sorted = true;
+    _stats.sortMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+uint32_t DrawList::ChangedState(const Draw& previous, const Draw& draw)
+{
+    uint32_t binds = 0;
+
+    if (draw.pipeline != previous.pipeline)
+    {
+        binds |= BIND_PIPELINE;
+    }
+
+    if (draw.descriptorSet != previous.descriptorSet)
+    {
+        binds |= BIND_DESCRIPTOR_SET;
+    }
+
+    if (draw.model != previous.model || draw.instanceBuffer != previous.instanceBuffer || draw.positionsOnly != previous.positionsOnly)
+    {
+        binds |= BIND_VERTEX_BUFFERS;
+    }
+
+    if (draw.model != previous.model)
+    {
+        binds |= BIND_INDEX_BUFFER;
+    }
+
+    return binds;
+}
+
+pair<size_t, size_t> DrawList::PassRange(uint32_t pass) const
+{
+    const uint64_t passStart = MakeKey(pass, 0, 0, 0, 0);
+    const auto begin = lower_bound(_keys.begin(), _keys.end(), passStart);
+    const auto end = find_if(begin, _keys.end(), [pass](uint64_t key) { return KeyPass(key) != pass; });
+
+    return { begin - _keys.begin(), end - _keys.begin() };
+}
+
+void DrawList::CountBinds(uint32_t binds)
+{
+    _stats.draws++;
+    _stats.pipelineBinds += (binds & BIND_PIPELINE) != 0;
+    _stats.descriptorSetBinds += (binds & BIND_DESCRIPTOR_SET) != 0;
+    _stats.vertexBufferBinds += (binds & BIND_VERTEX_BUFFERS) != 0;
+    _stats.indexBufferBinds += (binds & BIND_INDEX_BUFFER) != 0;
+}
+
+void DrawList::Record(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t pass)
+{
+    if (!_sorted)
+    {
+        Sort();
+    }
+
+    const auto [begin, end] = PassRange(pass);
+    const Draw* previous = nullptr;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        const Draw& draw = _draws[_order[i]];
+        //nothing is bound when a render pass begins as far as we know
+        const uint32_t binds = previous ? ChangedState(*previous, draw) : BIND_ALL;
+
+        if (binds & BIND_PIPELINE)
+        {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, draw.pipeline);
+        }
+
+        //a new pipeline can keep the sets bound as long as the layout is the same, which it is for all of ours
+        if (binds & BIND_DESCRIPTOR_SET)
+        {
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, 1, &draw.descriptorSet, 0, nullptr);
+        }
+
+        if (binds & BIND_VERTEX_BUFFERS)
+        {
+            vk::Buffer vertexBuffers[] = { draw.positionsOnly ? draw.model->_positionBuffer : draw.model->_vertexBuffer, draw.instanceBuffer };
+            vk::DeviceSize offsets[] = { 0, 0 };
+            commandBuffer.bindVertexBuffers(0, 2, vertexBuffers, offsets);
+        }
+
+        if (binds & BIND_INDEX_BUFFER)
+        {
+            commandBuffer.bindIndexBuffer(draw.model->_indexBuffer, 0, vk::IndexType::eUint32);
+        }
+
+        draw.model->DrawInstanced(commandBuffer, draw.lod, draw.firstInstance, draw.instanceCount);
+        CountBinds(binds);
+        previous = &draw;
+    }
+}
+
+void DrawList::CountStateChanges(uint32_t pass)
+{
+    if (!_sorted)
+    {
+        Sort();
+    }
+
+    const auto [begin, end] = PassRange(pass);
+
+    for (size_t i = begin; i < end; i++)
+    {
+        CountBinds(i == begin ? BIND_ALL : ChangedState(_draws[_order[i - 1]], _draws[_order[i]]));
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+class Model;
+
+//Draws collected over a frame, each with a 64 bit key. Sorting by the key groups draws that share state, so
+//recording them in order binds a pipeline, descriptor set or mesh only when it actually changes
+//Key from the top bits down: pass | pipeline | material | mesh | depth, a lower field only breaks ties of the ones above it
+class DrawList
+{
+public:
+	constexpr static uint32_t PASS_BITS = 4;
+	constexpr static uint32_t PIPELINE_BITS = 10;
+	constexpr static uint32_t MATERIAL_BITS = 14;
+	constexpr static uint32_t MESH_BITS = 16;
+	constexpr static uint32_t DEPTH_BITS = 20;
+
+	//fields are masked to their width, so ids that don't fit alias instead of spilling into the next field
+	static uint64_t MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth);
+	//depth from 0 to 1, lower sorts first, so pass 1 - depth for back to front
+	static uint32_t QuantizeDepth(float depth);
+	static uint32_t KeyPass(uint64_t key) { return static_cast<uint32_t>(key >> (64 - PASS_BITS)); }
+
+	struct Draw
+	{
+		vk::Pipeline pipeline;
+		vk::DescriptorSet descriptorSet;
+		const Model* model = nullptr;
+		//bound at binding 1, see Model::Instance
+		vk::Buffer instanceBuffer;
+		uint32_t lod = 0;
+		uint32_t firstInstance = 0;
+		uint32_t instanceCount = 0;
+		//binds the model's position only stream instead of its vertices, for depth only pipelines
+		bool positionsOnly = false;
+	};
+
+	//summed over every Record or CountStateChanges since the last Clear, so a frame's passes add up
+	//binds are how many of each the draws needed
+	struct Stats
+	{
+		uint32_t draws = 0;
+		uint32_t pipelineBinds = 0;
+		uint32_t descriptorSetBinds = 0;
+		uint32_t vertexBufferBinds = 0;
+		uint32_t indexBufferBinds = 0;
+		double sortMs = 0.0;
+
+		uint32_t StateChanges() const { return pipelineBinds + descriptorSetBinds + vertexBufferBinds + indexBufferBinds; }
+	};
+
+	void Add(uint64_t key, const Draw& draw);
+	void Clear();
+	void Reserve(size_t count);
+	size_t Count() const { return _draws.size(); }
+
+	//stable LSD radix sort of the keys, a byte every key shares costs no pass
+	void Sort();
+
+	//records the draws of pass in key order, skipping binds the previous draw already made
+	//the render pass has to be begun, with viewport and scissor set
+	void Record(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t pass);
+	//adds the stats Record would, without a command buffer
+	void CountStateChanges(uint32_t pass);
+
+	const Stats& GetStats() const { return _stats; }
+	//keys in the order the draws get recorded
+	const std::vector<uint64_t>& GetKeys() const { return _keys; }
+
+private:
+	enum BindFlags : uint32_t
+	{
+		BIND_PIPELINE = 1 << 0,
+		BIND_DESCRIPTOR_SET = 1 << 1,
+		BIND_VERTEX_BUFFERS = 1 << 2,
+		BIND_INDEX_BUFFER = 1 << 3,
+		BIND_ALL = BIND_PIPELINE | BIND_DESCRIPTOR_SET | BIND_VERTEX_BUFFERS | BIND_INDEX_BUFFER
+	};
+
+	//what has to be bound for draw when previous was recorded right before it
+	static uint32_t ChangedState(const Draw& previous, const Draw& draw);
+	//first and one past the last sorted draw of pass
+	std::pair<size_t, size_t> PassRange(uint32_t pass) const;
+	void CountBinds(uint32_t binds);
+
+	std::vector<uint64_t> _keys;
+	//index into _draws of every key, sorted along with them
+	std::vector<uint32_t> _order;
+	std::vector<Draw> _draws;
+
+	//the other half of every radix pass
+	std::vector<uint64_t> _scratchKeys;
+	std::vector<uint32_t> _scratchOrder;
+
+	bool _sorted = true;
+	Stats _stats;
+};
@@ -0,0 +1,44 @@
+#include "Frustum.h"
+
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+Frustum Frustum::FromMatrix(const mat4& viewProj)
+{
+    //glm is column major, row i of the matrix is the i-th component of every column
+    const vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+    const vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+    const vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+    const vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+    Frustum frustum;
+    frustum.planes[PLANE_LEFT] = row3 + row0;
+    frustum.planes[PLANE_RIGHT] = row3 - row0;
+    frustum.planes[PLANE_BOTTOM] = row3 + row1;
+    frustum.planes[PLANE_TOP] = row3 - row1;
+    //z already starts at 0 in clip space, there is no -w side to add
+    frustum.planes[PLANE_NEAR] = row2;
+    frustum.planes[PLANE_FAR] = row3 - row2;
+
+    for (vec4& plane : frustum.planes)
+    {
+        plane /= length(vec3(plane));
+    }
+
+    return frustum;
+}
+
+bool Frustum::IntersectsSphere(const vec3& center, float radius) const
+{
+    for (const vec4& plane : planes)
+    {
+        if (dot(vec3(plane), center) + plane.w < -radius)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
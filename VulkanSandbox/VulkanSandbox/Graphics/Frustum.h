@@ -0,0 +1,28 @@
+#pragma once
+#include <array>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+//Six planes pointing inwards, a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+//Normalized, so the same sum is the signed distance and spheres test against their radius
+struct Frustum
+{
+	enum Plane
+	{
+		PLANE_LEFT,
+		PLANE_RIGHT,
+		PLANE_BOTTOM,
+		PLANE_TOP,
+		PLANE_NEAR,
+		PLANE_FAR,
+		PLANE_COUNT
+	};
+
+	std::array<glm::vec4, PLANE_COUNT> planes{};
+
+	//planes of whatever space viewProj maps into clip space, expects Vulkan's 0 to 1 depth range
+	static Frustum FromMatrix(const glm::mat4& viewProj);
+
+	bool IntersectsSphere(const glm::vec3& center, float radius) const;
+};
@@ -0,0 +1,652 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+#include "Frustum.h"
+#include "SamplerCache.h"
+#include "UploadBatch.h"
+#include "../Assets/Package.h"
+#include "../Utils/CLogger.h"
+
+using namespace std;
+using namespace glm;
+
+constexpr vk::Format PYRAMID_FORMAT = vk::Format::eR32Sfloat;
+
+void GpuCulling::Init()
+{
+    CreateDescriptorSetLayouts();
+    CreatePipelines();
+
+    for (uint32_t i = 0; i < Graphics::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        Graphics::CreateBuffer(sizeof(CullParams), vk::BufferUsageFlagBits::eUniformBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            _paramBuffers[i], _paramBuffersMemory[i], VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+        VkResult result = vmaMapMemory(Graphics::_allocator, _paramBuffersMemory[i], &_paramBuffersMapped[i]);
+        Assert(result == VK_SUCCESS, "Failed to map cull parameters!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+        Graphics::CreateBuffer(sizeof(CullCounts), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer
+            | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal,
+            _countBuffers[i], _countBuffersMemory[i]);
+
+        Graphics::CreateBuffer(sizeof(CullCounts), vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            _readbackBuffers[i], _readbackBuffersMemory[i], VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+        result = vmaMapMemory(Graphics::_allocator, _readbackBuffersMemory[i], &_readbackBuffersMapped[i]);
+        Assert(result == VK_SUCCESS, "Failed to map cull counts!", { {"Error Code", static_cast<uint32_t>(result)} });
+        //read before the frame ever ran
+        memset(_readbackBuffersMapped[i], 0, sizeof(CullCounts));
+    }
+
+    SamplerDesc pointDesc{};
+    pointDesc.magFilter = vk::Filter::eNearest;
+    pointDesc.minFilter = vk::Filter::eNearest;
+    pointDesc.mipmapMode = vk::SamplerMipmapMode::eNearest;
+    pointDesc.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+    pointDesc.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+    pointDesc.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+    pointDesc.maxAnisotropy = 1.0f;
+    _pointSampler = SamplerCache::Get(pointDesc);
+
+    CreateDescriptorSets();
+    CreateDepthPyramid();
+}
+
+void GpuCulling::DeInit()
+{
+    DestroyDepthPyramid();
+
+    for (uint32_t i = 0; i < Graphics::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vmaUnmapMemory(Graphics::_allocator, _paramBuffersMemory[i]);
+        vmaDestroyBuffer(Graphics::_allocator, _paramBuffers[i], _paramBuffersMemory[i]);
+        vmaDestroyBuffer(Graphics::_allocator, _countBuffers[i], _countBuffersMemory[i]);
+        vmaUnmapMemory(Graphics::_allocator, _readbackBuffersMemory[i]);
+        vmaDestroyBuffer(Graphics::_allocator, _readbackBuffers[i], _readbackBuffersMemory[i]);
+
+        if (_drawBuffers[i])
+        {
+            vmaDestroyBuffer(Graphics::_allocator, _drawBuffers[i], _drawBuffersMemory[i]);
+        }
+    }
+
+    if (_instanceBuffer)
+    {
+        vmaDestroyBuffer(Graphics::_allocator, _instanceBuffer, _instanceBufferMemory);
+        vmaDestroyBuffer(Graphics::_allocator, _stateBuffer, _stateBufferMemory);
+    }
+
+    _drawBuffers = {};
+    _instanceBuffer = nullptr;
+    _stateBuffer = nullptr;
+    _instanceCount = 0;
+    _capacity = 0;
+    _boundInstanceBuffers = {};
+    _boundDrawBuffers = {};
+    _boundPyramidViews = {};
+
+    Graphics::_device.destroyDescriptorPool(_descriptorPool, nullptr);
+    Graphics::_device.destroyPipeline(_pipeline, nullptr);
+    Graphics::_device.destroyPipelineLayout(_pipelineLayout, nullptr);
+    Graphics::_device.destroyDescriptorSetLayout(_descriptorSetLayout, nullptr);
+    Graphics::_device.destroyPipeline(_pyramidPipeline, nullptr);
+    Graphics::_device.destroyPipeline(_pyramidPipelineMS, nullptr);
+    Graphics::_device.destroyPipelineLayout(_pyramidPipelineLayout, nullptr);
+    Graphics::_device.destroyDescriptorSetLayout(_pyramidSetLayout, nullptr);
+}
+
+void GpuCulling::CreateDepthPyramid()
+{
+    //without occlusion culling the depth buffer is a transient attachment nothing samples
+    if (Graphics::AttachmentsStayInRenderPass())
+    {
+        return;
+    }
+
+    //power of two levels halve exactly, level 0 is at most the depth buffer's size
+    //sized for the full render scale, so the scale can change without rebuilding it
+    _pyramidWidth = bit_floor(Graphics::_swapChainExtent.width);
+    _pyramidHeight = bit_floor(Graphics::_swapChainExtent.height);
+    _pyramidLevels = bit_width(std::max(_pyramidWidth, _pyramidHeight));
+
+    Graphics::CreateImage(_pyramidWidth, _pyramidHeight, _pyramidLevels, vk::SampleCountFlagBits::e1, PYRAMID_FORMAT,
+        vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, _pyramidImage, _pyramidImageMemory);
+    _pyramidView = Graphics::CreateImageView(_pyramidImage, PYRAMID_FORMAT, _pyramidLevels, vk::ImageAspectFlagBits::eColor);
+
+    _pyramidLevelViews.resize(_pyramidLevels);
+
+    for (uint32_t level = 0; level < _pyramidLevels; level++)
+    {
+        _pyramidLevelViews[level] = Graphics::CreateImageView(_pyramidImage, PYRAMID_FORMAT, 1, vk::ImageAspectFlagBits::eColor, level);
+    }
+
+    //written and sampled by compute only, so it never leaves the general layout
+    Graphics::TransitionImageLayout(_pyramidImage, PYRAMID_FORMAT, _pyramidLevels, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+
+    array<vk::DescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = vk::DescriptorType::eCombinedImageSampler;
+    poolSizes[0].descriptorCount = _pyramidLevels;
+    poolSizes[1].type = vk::DescriptorType::eStorageImage;
+    poolSizes[1].descriptorCount = _pyramidLevels;
+
+    vk::DescriptorPoolCreateInfo poolInfo{};
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = _pyramidLevels;
+
+    vk::Result result = Graphics::_device.createDescriptorPool(&poolInfo, nullptr, &_pyramidDescriptorPool);
+    Assert(result == vk::Result::eSuccess, "Failed to create depth pyramid descriptor pool!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    vector layouts(_pyramidLevels, _pyramidSetLayout);
+    vk::DescriptorSetAllocateInfo allocInfo{};
+    allocInfo.descriptorPool = _pyramidDescriptorPool;
+    allocInfo.descriptorSetCount = _pyramidLevels;
+    allocInfo.pSetLayouts = layouts.data();
+
+    _pyramidSets.resize(_pyramidLevels);
+    result = Graphics::_device.allocateDescriptorSets(&allocInfo, _pyramidSets.data());
+    Assert(result == vk::Result::eSuccess, "Failed to allocate depth pyramid descriptor sets!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    for (uint32_t level = 0; level < _pyramidLevels; level++)
+    {
+        //level 0 reduces the depth buffer the first pass just wrote
+        vk::DescriptorImageInfo sourceInfo{};
+        sourceInfo.sampler = _pointSampler;
+        sourceInfo.imageView = level == 0 ? Graphics::_depthImageView : _pyramidLevelViews[level - 1];
+        sourceInfo.imageLayout = level == 0 ? vk::ImageLayout::eDepthStencilReadOnlyOptimal : vk::ImageLayout::eGeneral;
+
+        vk::DescriptorImageInfo destinationInfo{};
+        destinationInfo.imageView = _pyramidLevelViews[level];
+        destinationInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+        array<vk::WriteDescriptorSet, 2> writes{};
+        writes[0].dstSet = _pyramidSets[level];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        writes[0].pImageInfo = &sourceInfo;
+        writes[1].dstSet = _pyramidSets[level];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = vk::DescriptorType::eStorageImage;
+        writes[1].pImageInfo = &destinationInfo;
+
+        Graphics::_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void GpuCulling::DestroyDepthPyramid()
+{
+    if (!_pyramidImage)
+    {
+        return;
+    }
+
+    Graphics::_device.destroyDescriptorPool(_pyramidDescriptorPool, nullptr);
+    _pyramidSets.clear();
+
+    for (vk::ImageView view : _pyramidLevelViews)
+    {
+        Graphics::_device.destroyImageView(view, nullptr);
+    }
+
+    _pyramidLevelViews.clear();
+    Graphics::_device.destroyImageView(_pyramidView, nullptr);
+    vmaDestroyImage(Graphics::_allocator, _pyramidImage, _pyramidImageMemory);
+    _pyramidImage = nullptr;
+    _pyramidView = nullptr;
+}
+
+void GpuCulling::SetInstances(span<const Model::Instance> instances)
+{
+    Assert(!instances.empty(), "GPU culling needs at least one instance!");
+
+    UploadBatch batch;
+
+    //frames in flight keep drawing from the old buffer until their sets get rewritten
+    if (_instanceBuffer)
+    {
+        Graphics::DeferDestroy([buffer = _instanceBuffer, memory = _instanceBufferMemory]()
+        {
+            vmaDestroyBuffer(Graphics::_allocator, buffer, memory);
+        });
+    }
+
+    batch.UploadBuffer(instances.data(), instances.size_bytes(), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer,
+        _instanceBuffer, _instanceBufferMemory);
+
+    _instanceCount = static_cast<uint32_t>(instances.size());
+
+    if (_instanceCount > _capacity)
+    {
+        Reserve(bit_ceil(_instanceCount), batch.GetCommandBuffer());
+    }
+    else
+    {
+        batch.GetCommandBuffer().fillBuffer(_stateBuffer, 0, VK_WHOLE_SIZE, 0);
+    }
+
+    batch.Submit();
+}
+
+void GpuCulling::Reserve(uint32_t capacity, vk::CommandBuffer commandBuffer)
+{
+    vk::PhysicalDeviceProperties properties{};
+    Graphics::_physicalDevice.getProperties(&properties);
+
+    //the draw count can't cover more than this, and without the count buffer every slot is one draw
+    Assert(capacity <= properties.limits.maxDrawIndirectCount, "More instances than the device can draw indirectly!",
+        { {"Instances", capacity}, {"Device limit", properties.limits.maxDrawIndirectCount} });
+
+    if (_stateBuffer)
+    {
+        Graphics::DeferDestroy([buffer = _stateBuffer, memory = _stateBufferMemory, drawBuffers = _drawBuffers, drawMemory = _drawBuffersMemory]()
+        {
+            vmaDestroyBuffer(Graphics::_allocator, buffer, memory);
+
+            for (uint32_t i = 0; i < Graphics::MAX_FRAMES_IN_FLIGHT; i++)
+            {
+                vmaDestroyBuffer(Graphics::_allocator, drawBuffers[i], drawMemory[i]);
+            }
+        });
+    }
+
+    //lod and visible flag, see InstanceState in Cull.comp
+    Graphics::CreateBuffer(sizeof(uint32_t) * 2 * capacity, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, _stateBuffer, _stateBufferMemory);
+    commandBuffer.fillBuffer(_stateBuffer, 0, VK_WHOLE_SIZE, 0);
+
+    for (uint32_t i = 0; i < Graphics::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        Graphics::CreateBuffer(sizeof(vk::DrawIndexedIndirectCommand) * CULL_PASS_COUNT * capacity, vk::BufferUsageFlagBits::eStorageBuffer
+            | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, _drawBuffers[i], _drawBuffersMemory[i]);
+    }
+
+    _capacity = capacity;
+}
+
+void GpuCulling::PrepareFrame(uint32_t frame, const Model& model, const mat4& world)
+{
+    //the frame's fence has signalled, so the counts its last run copied out are complete
+    CullCounts counts;
+    memcpy(&counts, _readbackBuffersMapped[frame], sizeof(CullCounts));
+    _stats = counts.stats;
+
+    UpdateDescriptorSet(frame);
+
+    CullParams params{};
+    params.world = world;
+    params.view = Graphics::_view;
+    params.proj = Graphics::_proj;
+    params.planes = Frustum::FromMatrix(Graphics::_proj * Graphics::_view).planes;
+    params.bounds = vec4(model._boundsCenter, model._boundsRadius);
+    params.lodCount = static_cast<uint32_t>(std::min(model._lods.size(), params.lods.size()));
+
+    for (uint32_t i = 0; i < params.lodCount; i++)
+    {
+        params.lods[i] = { model._lods[i].indexOffset, model._lods[i].indexCount, model._lods[i].error, 0.0f };
+    }
+
+    //near plane distance from the 0 to 1 depth projection
+    const float nearPlane = Graphics::_proj[3][2] / Graphics::_proj[2][2];
+    params.pyramid = vec4(static_cast<float>(_pyramidWidth), static_cast<float>(_pyramidHeight), static_cast<float>(_pyramidLevels), nearPlane);
+    params.instanceCount = _instanceCount;
+    params.instanceCapacity = _capacity;
+    params.pixelScale = std::abs(Graphics::_proj[1][1]) * 0.5f * static_cast<float>(Graphics::_renderExtent.height);
+    params.pixelError = Model::LOD_PIXEL_ERROR;
+    params.hysteresis = Model::LOD_HYSTERESIS;
+    memcpy(_paramBuffersMapped[frame], &params, sizeof(CullParams));
+}
+
+GpuCulling::GraphResources GpuCulling::ImportResources(RenderGraph& graph, uint32_t frame)
+{
+    GraphResources resources{};
+
+    //SetInstances waits for its upload, and the per frame buffers were last used before the frame's fence
+    resources.instances = graph.ImportBuffer("Cull instances", _instanceBuffer, RenderGraph::ACCESS_NONE);
+    resources.draws = graph.ImportBuffer("Cull draws", _drawBuffers[frame], RenderGraph::ACCESS_NONE);
+    resources.counts = graph.ImportBuffer("Cull counts", _countBuffers[frame], RenderGraph::ACCESS_NONE);
+    resources.readback = graph.ImportBuffer("Cull readback", _readbackBuffers[frame], RenderGraph::ACCESS_NONE);
+    //shared by the frames in flight, the last frame's second cull pass is the last to touch them
+    resources.states = graph.ImportBuffer("Cull states", _stateBuffer, RenderGraph::ACCESS_COMPUTE_WRITE);
+    resources.pyramid = graph.ImportImage("Depth pyramid", _pyramidImage, vk::ImageAspectFlagBits::eColor, _pyramidLevels,
+        RenderGraph::ACCESS_COMPUTE_READ);
+
+    graph.Export(resources.states, RenderGraph::ACCESS_NONE);
+    graph.Export(resources.readback, RenderGraph::ACCESS_HOST_READ);
+
+    return resources;
+}
+
+uint32_t GpuCulling::AddResetPass(RenderGraph& graph, uint32_t frame, const GraphResources& resources)
+{
+    const uint32_t pass = graph.AddPass("Cull reset", [frame](vk::CommandBuffer commandBuffer)
+        {
+            commandBuffer.fillBuffer(_countBuffers[frame], 0, sizeof(CullCounts), 0);
+
+            //plain indirect draws every slot, the ones nobody wrote this frame have to be empty draws
+            if (!Graphics::_drawIndirectCountSupported)
+            {
+                commandBuffer.fillBuffer(_drawBuffers[frame], 0, VK_WHOLE_SIZE, 0);
+            }
+        });
+
+    graph.Write(pass, resources.counts, RenderGraph::ACCESS_TRANSFER_WRITE, true);
+
+    if (!Graphics::_drawIndirectCountSupported)
+    {
+        graph.Write(pass, resources.draws, RenderGraph::ACCESS_TRANSFER_WRITE, true);
+    }
+
+    return pass;
+}
+
+uint32_t GpuCulling::AddCullPass(RenderGraph& graph, uint32_t frame, const GraphResources& resources, CullPass cullPass)
+{
+    const uint32_t pass = graph.AddPass(cullPass == CULL_PASS_PREVIOUSLY_VISIBLE ? "Cull previously visible" : "Cull newly visible",
+        [frame, cullPass](vk::CommandBuffer commandBuffer)
+        {
+            const uint32_t passIndex = cullPass;
+
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, _pipeline);
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipelineLayout, 0, 1, &_descriptorSets[frame], 0, nullptr);
+            commandBuffer.pushConstants(_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &passIndex);
+            commandBuffer.dispatch((_instanceCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        });
+
+    graph.Read(pass, resources.instances, RenderGraph::ACCESS_COMPUTE_READ);
+    graph.Write(pass, resources.states, RenderGraph::ACCESS_COMPUTE_WRITE);
+    graph.Write(pass, resources.draws, RenderGraph::ACCESS_COMPUTE_WRITE);
+    graph.Write(pass, resources.counts, RenderGraph::ACCESS_COMPUTE_WRITE);
+
+    //only the second pass tests occlusion
+    if (cullPass == CULL_PASS_NEWLY_VISIBLE)
+    {
+        graph.Read(pass, resources.pyramid, RenderGraph::ACCESS_COMPUTE_READ);
+    }
+
+    return pass;
+}
+
+uint32_t GpuCulling::AddReadbackPass(RenderGraph& graph, uint32_t frame, const GraphResources& resources)
+{
+    const uint32_t pass = graph.AddPass("Cull readback", [frame](vk::CommandBuffer commandBuffer)
+        {
+            vk::BufferCopy copyRegion{};
+            copyRegion.size = sizeof(CullCounts);
+            commandBuffer.copyBuffer(_countBuffers[frame], _readbackBuffers[frame], 1, &copyRegion);
+        });
+
+    graph.Read(pass, resources.counts, RenderGraph::ACCESS_TRANSFER_READ);
+    graph.Write(pass, resources.readback, RenderGraph::ACCESS_TRANSFER_WRITE, true);
+
+    return pass;
+}
+
+uint32_t GpuCulling::AddDepthPyramidPass(RenderGraph& graph, const GraphResources& resources, uint32_t depth)
+{
+    const uint32_t pass = graph.AddPass("Depth pyramid", [](vk::CommandBuffer commandBuffer)
+        {
+            const bool multisampled = Graphics::_msaaSamples != vk::SampleCountFlagBits::e1;
+
+            for (uint32_t level = 0; level < _pyramidLevels; level++)
+            {
+                const vk::Pipeline pipeline = level == 0 && multisampled ? _pyramidPipelineMS : _pyramidPipeline;
+                const uint32_t width = std::max(_pyramidWidth >> level, 1u);
+                const uint32_t height = std::max(_pyramidHeight >> level, 1u);
+                //the scene only rendered into the top left of the depth buffer, the pyramid covers just that
+                const uint32_t sourceSize[] = {
+                    level == 0 ? Graphics::_renderExtent.width : std::max(_pyramidWidth >> (level - 1), 1u),
+                    level == 0 ? Graphics::_renderExtent.height : std::max(_pyramidHeight >> (level - 1), 1u)
+                };
+
+                //the next level reads the one before it, inside the pass so the graph only sees the whole pyramid
+                if (level > 0)
+                {
+                    vk::MemoryBarrier levelBarrier{};
+                    levelBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+                    levelBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+                    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                        {}, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+                }
+
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pyramidPipelineLayout, 0, 1, &_pyramidSets[level], 0, nullptr);
+                commandBuffer.pushConstants(_pyramidPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(sourceSize), sourceSize);
+                commandBuffer.dispatch((width + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE,
+                    (height + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE, 1);
+            }
+        });
+
+    graph.Read(pass, depth, RenderGraph::ACCESS_COMPUTE_SAMPLED);
+    graph.Write(pass, resources.pyramid, RenderGraph::ACCESS_COMPUTE_WRITE, true);
+
+    return pass;
+}
+
+void GpuCulling::ReadDraws(RenderGraph& graph, uint32_t pass, const GraphResources& resources)
+{
+    graph.Read(pass, resources.instances, RenderGraph::ACCESS_VERTEX_READ);
+    graph.Read(pass, resources.draws, RenderGraph::ACCESS_INDIRECT_READ);
+    graph.Read(pass, resources.counts, RenderGraph::ACCESS_INDIRECT_READ);
+}
+
+void GpuCulling::RecordDraw(vk::CommandBuffer commandBuffer, uint32_t frame, CullPass pass)
+{
+    constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+    const vk::DeviceSize drawOffset = static_cast<vk::DeviceSize>(stride) * _capacity * pass;
+
+    if (Graphics::_drawIndirectCountSupported)
+    {
+        commandBuffer.drawIndexedIndirectCountKHR(_drawBuffers[frame], drawOffset, _countBuffers[frame], sizeof(uint32_t) * pass,
+            _instanceCount, stride);
+    }
+    else
+    {
+        commandBuffer.drawIndexedIndirect(_drawBuffers[frame], drawOffset, _instanceCount, stride);
+    }
+}
+
+void GpuCulling::CreateDescriptorSetLayouts()
+{
+    //parameters, instances, instance states, draws, counts and the depth pyramid
+    array<vk::DescriptorSetLayoutBinding, 6> bindings{};
+
+    for (uint32_t i = 0; i < bindings.size(); i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+        bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    }
+
+    bindings[0].descriptorType = vk::DescriptorType::eUniformBuffer;
+    bindings[5].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    vk::Result result = Graphics::_device.createDescriptorSetLayout(&layoutInfo, nullptr, &_descriptorSetLayout);
+    Assert(result == vk::Result::eSuccess, "Failed to create cull descriptor set layout!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    //the level above (or the depth buffer) and the level being written
+    array<vk::DescriptorSetLayoutBinding, 2> pyramidBindings{};
+    pyramidBindings[0].binding = 0;
+    pyramidBindings[0].descriptorCount = 1;
+    pyramidBindings[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    pyramidBindings[0].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    pyramidBindings[1].binding = 1;
+    pyramidBindings[1].descriptorCount = 1;
+    pyramidBindings[1].descriptorType = vk::DescriptorType::eStorageImage;
+    pyramidBindings[1].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    layoutInfo.bindingCount = static_cast<uint32_t>(pyramidBindings.size());
+    layoutInfo.pBindings = pyramidBindings.data();
+
+    result = Graphics::_device.createDescriptorSetLayout(&layoutInfo, nullptr, &_pyramidSetLayout);
+    Assert(result == vk::Result::eSuccess, "Failed to create depth pyramid descriptor set layout!", { {"Error Code", static_cast<uint32_t>(result)} });
+}
+
+void GpuCulling::CreatePipelines()
+{
+    vk::PushConstantRange passRange{};
+    passRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    passRange.offset = 0;
+    passRange.size = sizeof(uint32_t);
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &passRange;
+
+    vk::Result result = Graphics::_device.createPipelineLayout(&pipelineLayoutInfo, nullptr, &_pipelineLayout);
+    Assert(result == vk::Result::eSuccess, "Failed to create cull pipeline layout!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    vk::PushConstantRange sourceSizeRange{};
+    sourceSizeRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    sourceSizeRange.offset = 0;
+    sourceSizeRange.size = sizeof(uint32_t) * 2;
+
+    vk::PipelineLayoutCreateInfo pyramidLayoutInfo{};
+    pyramidLayoutInfo.setLayoutCount = 1;
+    pyramidLayoutInfo.pSetLayouts = &_pyramidSetLayout;
+    pyramidLayoutInfo.pushConstantRangeCount = 1;
+    pyramidLayoutInfo.pPushConstantRanges = &sourceSizeRange;
+
+    result = Graphics::_device.createPipelineLayout(&pyramidLayoutInfo, nullptr, &_pyramidPipelineLayout);
+    Assert(result == vk::Result::eSuccess, "Failed to create depth pyramid pipeline layout!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    _pipeline = CreateComputePipeline("./Build/Data/Shaders/Cull.comp.spv", _pipelineLayout);
+    _pyramidPipeline = CreateComputePipeline("./Build/Data/Shaders/DepthPyramid.comp.spv", _pyramidPipelineLayout);
+    _pyramidPipelineMS = CreateComputePipeline("./Build/Data/Shaders/DepthPyramidMS.comp.spv", _pyramidPipelineLayout);
+}
+
+vk::Pipeline GpuCulling::CreateComputePipeline(const char* path, vk::PipelineLayout layout)
+{
+    vector<char> storage;
+    span<const char> code = Package::ReadFile(path, storage);
+    vk::ShaderModule shaderModule = Graphics::CreateShaderModule(code);
+
+    vk::ComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = layout;
+
+    vk::Pipeline pipeline;
+    vk::Result result = Graphics::_device.createComputePipelines(VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    Assert(result == vk::Result::eSuccess, "Failed to create compute pipeline!", { {"Error Code", static_cast<uint32_t>(result)}, {"Shader", path} });
+
+    Graphics::_device.destroyShaderModule(shaderModule, nullptr);
+
+    return pipeline;
+}
+
+void GpuCulling::CreateDescriptorSets()
+{
+    array<vk::DescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = vk::DescriptorType::eUniformBuffer;
+    poolSizes[0].descriptorCount = Graphics::MAX_FRAMES_IN_FLIGHT;
+    poolSizes[1].type = vk::DescriptorType::eStorageBuffer;
+    poolSizes[1].descriptorCount = Graphics::MAX_FRAMES_IN_FLIGHT * 4;
+    poolSizes[2].type = vk::DescriptorType::eCombinedImageSampler;
+    poolSizes[2].descriptorCount = Graphics::MAX_FRAMES_IN_FLIGHT;
+
+    vk::DescriptorPoolCreateInfo poolInfo{};
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = Graphics::MAX_FRAMES_IN_FLIGHT;
+
+    vk::Result result = Graphics::_device.createDescriptorPool(&poolInfo, nullptr, &_descriptorPool);
+    Assert(result == vk::Result::eSuccess, "Failed to create cull descriptor pool!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    array<vk::DescriptorSetLayout, Graphics::MAX_FRAMES_IN_FLIGHT> layouts;
+    layouts.fill(_descriptorSetLayout);
+
+    vk::DescriptorSetAllocateInfo allocInfo{};
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = Graphics::MAX_FRAMES_IN_FLIGHT;
+    allocInfo.pSetLayouts = layouts.data();
+
+    result = Graphics::_device.allocateDescriptorSets(&allocInfo, _descriptorSets.data());
+    Assert(result == vk::Result::eSuccess, "Failed to allocate cull descriptor sets!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    //the parameters and the counts never move, the rest is written once SetInstances made the buffers
+    for (uint32_t i = 0; i < Graphics::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        array<vk::DescriptorBufferInfo, 2> bufferInfos{};
+        bufferInfos[0] = { _paramBuffers[i], 0, sizeof(CullParams) };
+        bufferInfos[1] = { _countBuffers[i], 0, sizeof(CullCounts) };
+
+        array<vk::WriteDescriptorSet, 2> writes{};
+        writes[0].dstSet = _descriptorSets[i];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = vk::DescriptorType::eUniformBuffer;
+        writes[0].pBufferInfo = &bufferInfos[0];
+        writes[1].dstSet = _descriptorSets[i];
+        writes[1].dstBinding = 4;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = vk::DescriptorType::eStorageBuffer;
+        writes[1].pBufferInfo = &bufferInfos[1];
+
+        Graphics::_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void GpuCulling::UpdateDescriptorSet(uint32_t frame)
+{
+    if (_boundInstanceBuffers[frame] != _instanceBuffer || _boundDrawBuffers[frame] != _drawBuffers[frame])
+    {
+        array<vk::DescriptorBufferInfo, 3> bufferInfos{};
+        bufferInfos[0] = { _instanceBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[1] = { _stateBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[2] = { _drawBuffers[frame], 0, VK_WHOLE_SIZE };
+
+        array<vk::WriteDescriptorSet, 3> writes{};
+
+        for (uint32_t i = 0; i < writes.size(); i++)
+        {
+            writes[i].dstSet = _descriptorSets[frame];
+            writes[i].dstBinding = i + 1;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+
+        Graphics::_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+        _boundInstanceBuffers[frame] = _instanceBuffer;
+        _boundDrawBuffers[frame] = _drawBuffers[frame];
+    }
+
+    //swap chain recreation replaces the pyramid
+    if (_boundPyramidViews[frame] != _pyramidView)
+    {
+        vk::DescriptorImageInfo imageInfo{};
+        imageInfo.sampler = _pointSampler;
+        imageInfo.imageView = _pyramidView;
+        imageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+        vk::WriteDescriptorSet write{};
+        write.dstSet = _descriptorSets[frame];
+        write.dstBinding = 5;
+        write.descriptorCount = 1;
+        write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        write.pImageInfo = &imageInfo;
+
+        Graphics::_device.updateDescriptorSets(1, &write, 0, nullptr);
+
+        _boundPyramidViews[frame] = _pyramidView;
+    }
+}
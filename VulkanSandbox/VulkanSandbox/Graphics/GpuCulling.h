@@ -0,0 +1,174 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "Graphics.h"
+#include "RenderGraph.h"
+#include "../Assets/Graphics/Model.h"
+
+//Culls instances and picks their LODs in a compute pass, which writes one indirect draw per drawn instance
+//plus the draw count. The CPU only writes a few hundred bytes of parameters per frame, whatever the instance count
+//Occlusion culling takes two passes a frame: the first draws what was visible last frame, the depth of that
+//becomes a max depth pyramid, and the second tests every instance against it and draws the ones that came into view
+class GpuCulling
+{
+public:
+	enum CullPass
+	{
+		CULL_PASS_PREVIOUSLY_VISIBLE,
+		CULL_PASS_NEWLY_VISIBLE,
+		CULL_PASS_COUNT
+	};
+
+	//what neither pass drew because it was occluded, read back a frame in flight later
+	struct Stats
+	{
+		uint32_t occludedInstances;
+		uint32_t occludedTriangles;
+	};
+
+	//a frame's culling buffers and the depth pyramid, as imported into its render graph
+	struct GraphResources
+	{
+		uint32_t instances;
+		uint32_t states;
+		uint32_t draws;
+		uint32_t counts;
+		uint32_t readback;
+		uint32_t pyramid;
+	};
+
+	//needs the device, the command pool, the depth buffer and the cooked Cull.comp and DepthPyramid shaders
+	static void Init();
+	static void DeInit();
+	//the pyramid follows the depth buffer's size and sample count, Graphics calls these around swap chain recreation
+	static void CreateDepthPyramid();
+	static void DestroyDepthPyramid();
+
+	//uploads the instances and blocks until they are on the GPU, every instance starts at LOD 0 and not visible
+	//an instance's bounds are the model's bounding sphere moved by its transform
+	static void SetInstances(std::span<const Model::Instance> instances);
+	static uint32_t InstanceCount() { return _instanceCount; }
+	//bound as the per-instance vertex stream, the draws pick instances through firstInstance
+	//changes whenever SetInstances uploads
+	static vk::Buffer GetInstanceBuffer() { return _instanceBuffer; }
+
+	//reads back the stats the frame's last run left and writes its parameters, culling is against world * instance transforms
+	//once the frame's fence has signalled and before its graph executes
+	static void PrepareFrame(uint32_t frame, const Model& model, const glm::mat4& world);
+	//imports the frame's buffers and the pyramid, the instance states are exported since the next frame reads them
+	static GraphResources ImportResources(RenderGraph& graph, uint32_t frame);
+	//resets the counts, has to come before the first cull pass
+	static uint32_t AddResetPass(RenderGraph& graph, uint32_t frame, const GraphResources& resources);
+	static uint32_t AddCullPass(RenderGraph& graph, uint32_t frame, const GraphResources& resources, CullPass pass);
+	//reduces depth, the first pass's depth buffer, into the pyramid the second cull pass tests against
+	static uint32_t AddDepthPyramidPass(RenderGraph& graph, const GraphResources& resources, uint32_t depth);
+	//copies the counts to where the CPU reads them as stats, after the second cull pass
+	static uint32_t AddReadbackPass(RenderGraph& graph, uint32_t frame, const GraphResources& resources);
+	//declares the draws' indirect reads on a graph pass that calls RecordDraw
+	static void ReadDraws(RenderGraph& graph, uint32_t pass, const GraphResources& resources);
+	//inside the render pass, with the model's buffers bound
+	static void RecordDraw(vk::CommandBuffer commandBuffer, uint32_t frame, CullPass pass);
+
+	static Stats GetStats() { return _stats; }
+
+	constexpr static uint32_t WORKGROUP_SIZE = 64;
+	constexpr static uint32_t PYRAMID_WORKGROUP_SIZE = 8;
+
+private:
+	//std140, mirrors CullParams in Cull.comp
+	struct alignas(16) Lod
+	{
+		uint32_t indexOffset;
+		uint32_t indexCount;
+		float error;
+		float pad;
+	};
+
+	struct CullParams
+	{
+		glm::mat4 world;
+		glm::mat4 view;
+		glm::mat4 proj;
+		std::array<glm::vec4, 6> planes;
+		glm::vec4 bounds;
+		std::array<Lod, Model::MAX_LODS> lods;
+		glm::vec4 pyramid;
+		uint32_t instanceCount;
+		uint32_t instanceCapacity;
+		uint32_t lodCount;
+		float pixelScale;
+		float pixelError;
+		float hysteresis;
+	};
+
+	//mirrors CullCounts in Cull.comp
+	struct CullCounts
+	{
+		std::array<uint32_t, CULL_PASS_COUNT> drawCounts;
+		Stats stats;
+	};
+
+	static void CreateDescriptorSetLayouts();
+	static void CreatePipelines();
+	static vk::Pipeline CreateComputePipeline(const char* path, vk::PipelineLayout layout);
+	static void CreateDescriptorSets();
+	//grows the instance state and draw buffers to hold capacity instances, the old ones go through DeferDestroy
+	static void Reserve(uint32_t capacity, vk::CommandBuffer commandBuffer);
+	//points the frame's set at the current buffers, only writes when they changed since the frame last ran
+	static void UpdateDescriptorSet(uint32_t frame);
+
+	inline static vk::DescriptorSetLayout _descriptorSetLayout;
+	inline static vk::DescriptorPool _descriptorPool;
+	inline static vk::PipelineLayout _pipelineLayout;
+	inline static vk::Pipeline _pipeline;
+	inline static std::array<vk::DescriptorSet, Graphics::MAX_FRAMES_IN_FLIGHT> _descriptorSets{};
+
+	inline static uint32_t _instanceCount = 0;
+	inline static uint32_t _capacity = 0;
+	inline static vk::Buffer _instanceBuffer;
+	inline static VmaAllocation _instanceBufferMemory{};
+	inline static vk::Buffer _stateBuffer;
+	inline static VmaAllocation _stateBufferMemory{};
+
+	inline static std::array<vk::Buffer, Graphics::MAX_FRAMES_IN_FLIGHT> _paramBuffers{};
+	inline static std::array<VmaAllocation, Graphics::MAX_FRAMES_IN_FLIGHT> _paramBuffersMemory{};
+	inline static std::array<void*, Graphics::MAX_FRAMES_IN_FLIGHT> _paramBuffersMapped{};
+	//both passes' draws back to back, capacity each
+	inline static std::array<vk::Buffer, Graphics::MAX_FRAMES_IN_FLIGHT> _drawBuffers{};
+	inline static std::array<VmaAllocation, Graphics::MAX_FRAMES_IN_FLIGHT> _drawBuffersMemory{};
+	inline static std::array<vk::Buffer, Graphics::MAX_FRAMES_IN_FLIGHT> _countBuffers{};
+	inline static std::array<VmaAllocation, Graphics::MAX_FRAMES_IN_FLIGHT> _countBuffersMemory{};
+	//host visible copies of the counts, read once the frame's fence has signalled
+	inline static std::array<vk::Buffer, Graphics::MAX_FRAMES_IN_FLIGHT> _readbackBuffers{};
+	inline static std::array<VmaAllocation, Graphics::MAX_FRAMES_IN_FLIGHT> _readbackBuffersMemory{};
+	inline static std::array<void*, Graphics::MAX_FRAMES_IN_FLIGHT> _readbackBuffersMapped{};
+	inline static Stats _stats{};
+
+	//what each frame's set points at, so SetInstances never touches a set a frame in flight uses
+	inline static std::array<vk::Buffer, Graphics::MAX_FRAMES_IN_FLIGHT> _boundInstanceBuffers{};
+	inline static std::array<vk::Buffer, Graphics::MAX_FRAMES_IN_FLIGHT> _boundDrawBuffers{};
+	inline static std::array<vk::ImageView, Graphics::MAX_FRAMES_IN_FLIGHT> _boundPyramidViews{};
+
+	//max depth pyramid, power of two sized and always in the general layout
+	inline static vk::DescriptorSetLayout _pyramidSetLayout;
+	inline static vk::PipelineLayout _pyramidPipelineLayout;
+	inline static vk::Pipeline _pyramidPipeline;
+	//level 0 from a multisampled depth buffer
+	inline static vk::Pipeline _pyramidPipelineMS;
+	inline static vk::DescriptorPool _pyramidDescriptorPool;
+	//set i writes level i
+	inline static std::vector<vk::DescriptorSet> _pyramidSets;
+	inline static vk::Image _pyramidImage;
+	inline static VmaAllocation _pyramidImageMemory{};
+	inline static vk::ImageView _pyramidView;
+	inline static std::vector<vk::ImageView> _pyramidLevelViews;
+	inline static uint32_t _pyramidWidth = 0;
+	inline static uint32_t _pyramidHeight = 0;
+	inline static uint32_t _pyramidLevels = 0;
+	inline static vk::Sampler _pointSampler;
+};
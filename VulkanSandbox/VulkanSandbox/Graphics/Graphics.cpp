@@ -4,6 +4,7 @@
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
 #include <algorithm>
+#include <bit>
 #include <set>
 #include <GLFW/glfw3.h>
 #include <filesystem>
@@ -17,7 +18,6 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
-#include <shaderc/shaderc.hpp>
 #define VMA_VULKAN_VERSION 1001000 
 #define VMA_IMPLEMENTATION
 #define VMA_STATIC_VULKAN_FUNCTIONS 0
@@ -26,9 +26,22 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
 #include "../Utils/CLogger.h"
 #include "../Utils/utils.h"
+#include "../Utils/JobSystem.h"
+#include "Frustum.h"
+#include "GpuCulling.h"
+#include "RenderGraph.h"
+#include "SamplerCache.h"
+#include "SphereCuller.h"
+#include "UploadBatch.h"
 
 #include "../Assets/Graphics/Texture.h"
 #include "../Assets/Graphics/Model.h"
+#include "../Assets/AssetDB.h"
+#include "../Assets/LiveReload.h"
+#include "../Assets/Package.h"
+#include "../Assets/Cooking/Cooker.h"
+#include "../Assets/Cooking/ModelCooker.h"
+#include "../Assets/Cooking/TextureCooker.h"
 
 const auto vulkanVersion = VK_API_VERSION_1_1;
 
@@ -52,8 +65,6 @@ const vector<const char*> Graphics::_deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-Texture *Graphics::_texture = new Texture{ "Data/Textures/viking_room.png" };
-Model *Graphics::_modelAsset = new Model{""};
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -114,13 +125,27 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 
 void Graphics::Init()
 {
-    CompileShaders();
+    //assets and shaders only ever load their cooked copies, so those have to be up to date before anything reads them
+    //only outputs whose inputs, cooker version or settings changed since the last run get cooked again
+    //everything read at runtime ships in the one package, loose files are only the fallback
+    //both run on the JobSystem while the window, instance and device get created
+    JobCounter cooking;
+    JobSystem::Submit([]()
+        {
+            Cooker::CookAll(Cooker::SOURCE_ROOTS);
+            Package::BuildIfStale({ "Build/Data" }, Package::PACKAGE_PATH);
+        }, cooking);
+
+    //set before the render passes exist so they're only built once, P or SetDepthPrepass change it later
+    _depthPrepass = SCENE_DEPTH_PREPASS;
+
     glfwInit();
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
     _window = glfwCreateWindow(_width, _height, "Vulkan window", nullptr, nullptr);
     glfwSetFramebufferSizeCallback(_window, FramebufferResizeCallback);
+    glfwSetKeyCallback(_window, KeyCallback);
     
     //VkResult result = volkInitialize();
 
@@ -132,23 +157,44 @@ void Graphics::Init()
     PickPhysicalDevice();
     CreateLogicalDevice();
     CreateVMAAllocator();
+    SamplerCache::Init();
     CreateSwapChain();
-    CreateImageViews();
     CreateRenderPass();
     CreateDescriptorSetLayout();
-    CreateGraphicsPipeline();
     CreateCommandPool();
     CreateColorResources();
     CreateDepthResources();
     CreateFramebuffers();
-    CreateTextureImage();
-    CreateTextureSampler();
-    LoadModel();
+
+    //the main thread helps with whatever cook jobs are left instead of sleeping
+    JobSystem::Wait(cooking);
+    Package::Mount(Package::PACKAGE_PATH);
+
+    //reading and decoding only need the CPU, so they start while the pipelines and frame resources get created
+    AssetDB::Init();
+    //from here on saving a source recooks it and swaps the new asset in
+    LiveReload::Init(Cooker::SOURCE_ROOTS);
+    _modelAsset = AssetDB::Load<Model>(ModelCooker::CookedPath("Data/Models/viking_room.obj"));
+    _texture = AssetDB::Load<Texture>(TextureCooker::CookedPath("Data/Textures/viking_room.png"));
+
+    //the shaders come from the package
+    CreateGraphicsPipeline();
+
+    //nothing waits on the real assets, the placeholders are drawn until they stream in
+    AssetDB::CreatePlaceholders();
+
     CreateUniformBuffers();
     CreateDescriptorPool();
     CreateDescriptorSets();
     CreateCommandBuffers();
     CreateSyncObjects();
+    CreateFrameTimestamps();
+
+    _modelNode = _scene.Add(TransformHierarchy::INVALID_NODE);
+
+    GpuCulling::Init();
+    const Model::Instance instance{};
+    SetInstances({ &instance, 1 });
 }
 
 void Graphics::CreateInstance()
@@ -285,6 +331,50 @@ bool Graphics::CheckDeviceExtensionSupport(vk::PhysicalDevice device)
     return requiredExtensions.empty();
 }
 
+bool Graphics::SupportsDeviceExtension(vk::PhysicalDevice device, const char* extensionName)
+{
+    uint32_t extensionCount;
+    vk::Result result = device.enumerateDeviceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+    Assert(result == vk::Result::eSuccess, "Failed to enumerate device extension properties!", { {"Error code", static_cast<uint32_t>(result)} });
+
+    vector<vk::ExtensionProperties> availableExtensions(extensionCount);
+    result = device.enumerateDeviceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+    Assert(result == vk::Result::eSuccess, "Failed to enumerate device extension properties!", { {"Error code", static_cast<uint32_t>(result)} });
+
+    for (const auto& extension : availableExtensions)
+    {
+        if (strcmp(extension.extensionName, extensionName) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Graphics::GetDeviceLocalBudget(uint64_t& budget, uint64_t& usage)
+{
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(_allocator, &memoryProperties);
+
+    array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+    vmaGetHeapBudgets(_allocator, budgets.data());
+
+    budget = 0;
+    usage = 0;
+
+    for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++)
+    {
+        if (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            budget += budgets[i].budget;
+            usage += budgets[i].usage;
+        }
+    }
+}
+
 bool Graphics::IsPhysicalDeviceSuitable(vk::PhysicalDevice device)
 {
     vk::PhysicalDeviceProperties deviceProperties;
@@ -307,7 +397,10 @@ bool Graphics::IsPhysicalDeviceSuitable(vk::PhysicalDevice device)
         FindQueueFamilies(device).ValidForRendering() &&
         extensionsSupported &&
         swapChainAdequate &&
-        deviceFeatures.samplerAnisotropy;
+        deviceFeatures.samplerAnisotropy &&
+        deviceFeatures.textureCompressionBC &&
+        deviceFeatures.multiDrawIndirect &&
+        deviceFeatures.drawIndirectFirstInstance;
 }
 
 void Graphics::PickPhysicalDevice()
@@ -327,13 +420,24 @@ void Graphics::PickPhysicalDevice()
         if (IsPhysicalDeviceSuitable(device))
         {
             _physicalDevice = device;
-            _msaaSamples = GetMaxUsableSampleCount();
             break;
         }
     }
 
     Assert(_physicalDevice, "Failed to find a suitable GPU!");
 
+    vk::PhysicalDeviceFeatures features;
+    _physicalDevice.getFeatures(&features);
+    _sampleShadingSupported = features.sampleRateShading;
+
+    //the default tier, or the best one below it the device can do
+    while (!SupportsQuality(_quality))
+    {
+        _quality = static_cast<QualityTier>(_quality - 1);
+    }
+
+    _msaaSamples = GetQualitySettings(_quality).samples;
+
     _queueFamilyIndices = FindQueueFamilies(_physicalDevice);
 }
 
@@ -480,10 +584,9 @@ void Graphics::CreateLogicalDevice()
     }
 
     vk::PhysicalDeviceFeatures deviceFeatures{};
+    //everything the device supports, sample shading included when it has it
     _physicalDevice.getFeatures(&deviceFeatures);
 
-    deviceFeatures.sampleRateShading = VK_TRUE;
-
     vk::DeviceCreateInfo createInfo{};
 
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -491,8 +594,25 @@ void Graphics::CreateLogicalDevice()
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
     createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(_deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = _deviceExtensions.data();
+
+    vector<const char*> extensions = _deviceExtensions;
+    _memoryBudgetSupported = SupportsDeviceExtension(_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    if (_memoryBudgetSupported)
+    {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    //core only from 1.2, GpuCulling falls back to drawing every slot without it
+    _drawIndirectCountSupported = SupportsDeviceExtension(_physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+    if (_drawIndirectCountSupported)
+    {
+        extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(_validationLayers.size());
@@ -524,7 +644,21 @@ void Graphics::CreateVMAAllocator()
     allocatorInfo.pVulkanFunctions = &vulkanFunctions;
     allocatorInfo.vulkanApiVersion = vulkanVersion;
 
+    //without it VMA estimates the budget from the heap sizes
+    if (_memoryBudgetSupported)
+    {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
+
 	vmaCreateAllocator(&allocatorInfo, &_allocator);
+
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(_allocator, &memoryProperties);
+
+    for (uint32_t i = 0; i < memoryProperties->memoryTypeCount; i++)
+    {
+        _lazilyAllocatedSupported |= (memoryProperties->memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+    }
 }
 
 void Graphics::CreateSurface()
@@ -560,7 +694,10 @@ void Graphics::CreateSwapChain()
     createInfo.imageColorSpace = surfaceFormat.colorSpace;
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+    //the scene renders at its own resolution, only the upscale blit writes the swap chain images
+    Assert(static_cast<bool>(swapChainSupport.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst),
+        "Swap chain images can't be blitted to!");
+    createInfo.imageUsage = vk::ImageUsageFlagBits::eTransferDst;
 
     uint32_t queueFamilyIndices[] = { _queueFamilyIndices.graphicsFamily.value(), _queueFamilyIndices.presentFamily.value() };
 
@@ -599,17 +736,8 @@ void Graphics::CreateSwapChain()
 
     _swapChainImageFormat = surfaceFormat.format;
     _swapChainExtent = extent;
-}
-
-void Graphics::CreateImageViews()
-{
-    _swapChainImageViews.resize(_swapChainImages.size());
-
-	for (size_t i = 0; i < _swapChainImageViews.size(); i++)
-    {
-        _swapChainImageViews[i] = CreateImageView(_swapChainImages[i], _swapChainImageFormat, 
-            static_cast<uint32_t>(vk::ImageAspectFlagBits::eColor), vk::ImageAspectFlagBits::eColor);
-    }
+    //same scale of the new size
+    SetRenderScale(_renderScale);
 }
 
 void Graphics::RecreateSwapChain()
@@ -630,28 +758,34 @@ void Graphics::RecreateSwapChain()
     CreateSwapChain();
     CreateColorResources();
     CreateDepthResources();
-    CreateImageViews();
+    GpuCulling::CreateDepthPyramid();
     CreateFramebuffers();
 }
 
 void Graphics::CleanupSwapChain()
 {
-    _device.destroyImageView(_colorImageView, nullptr);
-    vmaDestroyImage(_allocator, _colorImage, _colorImageMemory);
-    _device.destroyImageView(_depthImageView, nullptr);
-    vmaDestroyImage(_allocator, _depthImage, _depthImageMemory);
+    DestroyAttachments();
+    _device.destroySwapchainKHR(_swapChain, nullptr);
+}
 
-    for (auto framebuffer : _swapChainFramebuffers)
-    {
-        _device.destroyFramebuffer(framebuffer, nullptr);
-    }
+void Graphics::DestroyAttachments()
+{
+    //its first level's descriptors point at the depth buffer
+    GpuCulling::DestroyDepthPyramid();
 
-    for (auto imageView : _swapChainImageViews)
+    if (_colorImage)
     {
-        _device.destroyImageView(imageView, nullptr);
+        _device.destroyImageView(_colorImageView, nullptr);
+        vmaDestroyImage(_allocator, _colorImage, _colorImageMemory);
+        _colorImage = nullptr;
+        _colorImageView = nullptr;
     }
 
-    _device.destroySwapchainKHR(_swapChain, nullptr);
+    _device.destroyImageView(_sceneColorImageView, nullptr);
+    vmaDestroyImage(_allocator, _sceneColorImage, _sceneColorImageMemory);
+    _device.destroyImageView(_depthImageView, nullptr);
+    vmaDestroyImage(_allocator, _depthImage, _depthImageMemory);
+    _device.destroyFramebuffer(_sceneFramebuffer, nullptr);
 }
 
 void Graphics::CreateDescriptorSetLayout()
@@ -683,14 +817,20 @@ void Graphics::CreateDescriptorSetLayout()
 
 void Graphics::CreateRenderPass()
 {
+    //every attachment starts and ends in the layout it's used in, the render graph does the transitions and the
+    //synchronization around the pass, see RecordCommandBuffer
+    //without MSAA the color attachment is the scene color image itself and there's nothing to resolve
+    const bool multisampled = _msaaSamples != vk::SampleCountFlagBits::e1;
+
     vk::AttachmentDescription colorAttachment{};
     colorAttachment.format = _swapChainImageFormat;
     colorAttachment.samples = _msaaSamples;
     colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-    colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+    //the resolve is all that's needed after the pass, unless the second pass draws on top of it
+    colorAttachment.storeOp = multisampled && AttachmentsStayInRenderPass() ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
     colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
     colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-    colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
+    colorAttachment.initialLayout = vk::ImageLayout::eColorAttachmentOptimal;
     colorAttachment.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
 
     vk::AttachmentReference colorAttachmentRef{};
@@ -704,8 +844,8 @@ void Graphics::CreateRenderPass()
     colorAttachmentResolve.storeOp = vk::AttachmentStoreOp::eStore;
     colorAttachmentResolve.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
     colorAttachmentResolve.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-    colorAttachmentResolve.initialLayout = vk::ImageLayout::eUndefined;
-    colorAttachmentResolve.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+    colorAttachmentResolve.initialLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    colorAttachmentResolve.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
 
     vk::AttachmentReference colorAttachmentResolveRef{};
     colorAttachmentResolveRef.attachment = 2;
@@ -715,10 +855,11 @@ void Graphics::CreateRenderPass()
     depthAttachment.format = FindDepthFormat();
     depthAttachment.samples = _msaaSamples;
     depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-    depthAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+    //the depth pyramid is built from it between the passes
+    depthAttachment.storeOp = AttachmentsStayInRenderPass() ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
     depthAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
     depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-    depthAttachment.initialLayout = vk::ImageLayout::eUndefined;
+    depthAttachment.initialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
     depthAttachment.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 
     vk::AttachmentReference depthAttachmentRef{};
@@ -730,37 +871,66 @@ void Graphics::CreateRenderPass()
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
-    subpass.pResolveAttachments = &colorAttachmentResolveRef;
+    subpass.pResolveAttachments = multisampled ? &colorAttachmentResolveRef : nullptr;
+
+    vector attachments = { colorAttachment, depthAttachment, colorAttachmentResolve };
 
-    vk::SubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcAccessMask = vk::AccessFlagBits::eNone;
-    dependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
-    dependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
-    dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    if (!multisampled)
+    {
+        attachments.pop_back();
+    }
+
+    //the prepass only has depth, the color subpass after it tests against what it wrote
+    vk::SubpassDescription depthSubpass{};
+    depthSubpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+    depthSubpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    vector subpasses = { subpass };
+
+    if (_depthPrepass)
+    {
+        subpasses = { depthSubpass, subpass };
+    }
+
+    vk::SubpassDependency prepassDependency{};
+    prepassDependency.srcSubpass = 0;
+    prepassDependency.dstSubpass = 1;
+    prepassDependency.srcStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+    prepassDependency.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    prepassDependency.dstStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+    prepassDependency.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead;
+    prepassDependency.dependencyFlags = vk::DependencyFlagBits::eByRegion;
 
-    std::array attachments = { colorAttachment, depthAttachment, colorAttachmentResolve };
     vk::RenderPassCreateInfo renderPassInfo{};
 
     renderPassInfo.sType = vk::StructureType::eRenderPassCreateInfo;
     renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
     renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = _depthPrepass ? 1 : 0;
+    renderPassInfo.pDependencies = &prepassDependency;
 
     vk::Result result = _device.createRenderPass(&renderPassInfo, nullptr, &_renderPass);
     Assert(result == vk::Result::eSuccess, "Failed to create render pass!", {{"Error Code", static_cast<uint32_t>(result)}});
+
+    //second pass of the frame, draws what the depth pyramid found newly visible on top of the first pass
+    //same formats and sample counts, so the pipeline and framebuffers work with either
+    attachments[0].loadOp = vk::AttachmentLoadOp::eLoad;
+    attachments[0].storeOp = multisampled ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
+    attachments[1].loadOp = vk::AttachmentLoadOp::eLoad;
+    attachments[1].storeOp = vk::AttachmentStoreOp::eDontCare;
+
+    result = _device.createRenderPass(&renderPassInfo, nullptr, &_loadRenderPass);
+    Assert(result == vk::Result::eSuccess, "Failed to create render pass!", {{"Error Code", static_cast<uint32_t>(result)}});
 }
 
 void Graphics::CreateGraphicsPipeline()
 {
-    vector<char> vertCode;
-    vector<char> fragCode;
-    loadWholeBinFile("./Build/Data/Shaders/VertShader.vert.spv", vertCode);
-    loadWholeBinFile("./Build/Data/Shaders/FragShader.frag.spv", fragCode);
+    vector<char> vertStorage;
+    vector<char> fragStorage;
+    span<const char> vertCode = Package::ReadFile("./Build/Data/Shaders/VertShader.vert.spv", vertStorage);
+    span<const char> fragCode = Package::ReadFile("./Build/Data/Shaders/FragShader.frag.spv", fragStorage);
 
     vk::ShaderModule vertShaderModule = CreateShaderModule(vertCode);
     vk::ShaderModule fragShaderModule = CreateShaderModule(fragCode);
@@ -793,12 +963,16 @@ void Graphics::CreateGraphicsPipeline()
     vertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
     vertexInputInfo.vertexAttributeDescriptionCount = 0;
     vertexInputInfo.pVertexAttributeDescriptions = nullptr; // Optional
-    auto bindingDescription = Model::Vertex::getBindingDescription();
-    auto attributeDescriptions = Model::Vertex::getAttributeDescriptions();
-
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    //per vertex data at binding 0, per instance data at binding 1
+    array bindingDescriptions = { Model::Vertex::getBindingDescription(), Model::Instance::getBindingDescription() };
+    auto vertexAttributes = Model::Vertex::getAttributeDescriptions();
+    auto instanceAttributes = Model::Instance::getAttributeDescriptions();
+    vector<vk::VertexInputAttributeDescription> attributeDescriptions(vertexAttributes.begin(), vertexAttributes.end());
+    attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     vk::PipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -839,14 +1013,14 @@ void Graphics::CreateGraphicsPipeline()
     rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
 
     vk::PipelineMultisampleStateCreateInfo multisampling{};
-    multisampling.sampleShadingEnable = VK_FALSE;
     multisampling.rasterizationSamples = _msaaSamples;
-    multisampling.minSampleShading = 1.0f; // Optional
     multisampling.pSampleMask = nullptr; // Optional
     multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
     multisampling.alphaToOneEnable = VK_FALSE; // Optional
-    multisampling.sampleShadingEnable = VK_TRUE; // enable sample shading in the pipeline
-    multisampling.minSampleShading = .2f; // min fraction for sample shading; closer to one is smoother
+    //every sample runs the fragment shader, which smooths texture aliasing inside triangles too but costs
+    //the shading of that many pixels
+    multisampling.sampleShadingEnable = GetQualitySettings(_quality).sampleShading;
+    multisampling.minSampleShading = 1.0f;
 
     vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
     colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
@@ -881,8 +1055,9 @@ void Graphics::CreateGraphicsPipeline()
 
     vk::PipelineDepthStencilStateCreateInfo depthStencil{};
     depthStencil.depthTestEnable = VK_TRUE;
-    depthStencil.depthWriteEnable = VK_TRUE;
-    depthStencil.depthCompareOp = vk::CompareOp::eLess;
+    //after a prepass depth already holds the closest surface, only the fragments that are it get shaded
+    depthStencil.depthWriteEnable = !_depthPrepass;
+    depthStencil.depthCompareOp = _depthPrepass ? vk::CompareOp::eEqual : vk::CompareOp::eLess;
     depthStencil.depthBoundsTestEnable = VK_FALSE;
     depthStencil.minDepthBounds = 0.0f; // Optional
     depthStencil.maxDepthBounds = 1.0f; // Optional
@@ -903,7 +1078,7 @@ void Graphics::CreateGraphicsPipeline()
     pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = _pipelineLayout;
     pipelineInfo.renderPass = _renderPass;
-    pipelineInfo.subpass = 0;
+    pipelineInfo.subpass = _depthPrepass ? 1 : 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
     pipelineInfo.basePipelineIndex = -1; // Optional
 	pipelineInfo.pDepthStencilState = &depthStencil;
@@ -913,63 +1088,59 @@ void Graphics::CreateGraphicsPipeline()
 
     _device.destroyShaderModule(fragShaderModule, nullptr);
     _device.destroyShaderModule(vertShaderModule, nullptr);
-}
 
-void Graphics::CompileShaders()
-{
-    const filesystem::path glslcPath = "C:\\VulkanSDK\\1.3.239.0\\Bin\\glslc.exe";
-    shaderc::Compiler compiler;
-
-    for (filesystem::directory_entry shaderIt : filesystem::directory_iterator("./Data/Shaders"))
+    if (!_depthPrepass)
     {
-        if (shaderIt.is_regular_file() && (shaderIt.path().extension() == ".vert" || shaderIt.path().extension() == ".frag"))
-        {
-            filesystem::path outpath = "./Build/";
-            outpath += shaderIt.path().parent_path().string().substr(2);
-            outpath += '/';
-            outpath += shaderIt.path().stem();
-            outpath += shaderIt.path().extension();
-            outpath += ".spv";
-
-            if (!exists(outpath))
-            {
-                makeEmptyFile(outpath.string().c_str());
-            }
-            else if (last_write_time(outpath) > last_write_time(shaderIt.path()))
-            {
-                continue;
-            }
+        return;
+    }
 
-            Log("Compiling shader...", {{"Shader", shaderIt.path().string()}, {"Output Dest.", outpath.string()}});
+    //same state apart from what the depth only subpass doesn't have
+    vector<char> depthStorage;
+    span<const char> depthCode = Package::ReadFile("./Build/Data/Shaders/DepthPrepass.vert.spv", depthStorage);
+    vk::ShaderModule depthShaderModule = CreateShaderModule(depthCode);
 
-            vector<char> inData;
-            loadWholeBinFile(shaderIt.path().string().c_str(), inData);
+    vk::PipelineShaderStageCreateInfo depthShaderStageInfo{};
+    depthShaderStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
+    depthShaderStageInfo.module = depthShaderModule;
+    depthShaderStageInfo.pName = "main";
 
-            shaderc_shader_kind shaderType = shaderc_glsl_infer_from_source;
+    //positions at binding 0, the instance stream at binding 1 as before
+    array depthBindingDescriptions = { Model::Vertex::getPositionBindingDescription(), Model::Instance::getBindingDescription() };
+    vector depthAttributeDescriptions = { Model::Vertex::getPositionAttributeDescription() };
+    depthAttributeDescriptions.insert(depthAttributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
 
-            const std::unordered_map<std::string_view, shaderc_shader_kind> defines = {
-	            {".vert", shaderc_glsl_vertex_shader},
-	            {".frag", shaderc_glsl_fragment_shader},
-	            {".tesc", shaderc_glsl_tess_control_shader},
-	            {".tese", shaderc_glsl_tess_evaluation_shader},
-	            {".geom", shaderc_glsl_geometry_shader},
-	            {".comp", shaderc_glsl_compute_shader} };
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(depthBindingDescriptions.size());
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(depthAttributeDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = depthBindingDescriptions.data();
+    vertexInputInfo.pVertexAttributeDescriptions = depthAttributeDescriptions.data();
 
-            shaderType = defines.at(shaderIt.path().extension().string());
+    //nothing to shade per sample without a fragment shader
+    multisampling.sampleShadingEnable = VK_FALSE;
+    colorBlending.attachmentCount = 0;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = vk::CompareOp::eLess;
 
-            auto ret = compiler.CompileGlslToSpv(inData.data(), inData.size(), shaderType, shaderIt.path().string().c_str());
-           
-            if (ret.GetCompilationStatus() != shaderc_compilation_status_success)
-            {
-                Error("Shader compiler returned an error",{{"Return code", ret.GetCompilationStatus()}});
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &depthShaderStageInfo;
+    pipelineInfo.subpass = 0;
 
-            	Error(ret.GetErrorMessage());
-            }
-        }
-    }
+    pipelineResult = _device.createGraphicsPipelines(VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_depthPipeline);
+    Assert(pipelineResult == vk::Result::eSuccess, "Failed to create depth prepass pipeline!", {{"Error Code", static_cast<uint32_t>(pipelineResult)}});
+
+    _device.destroyShaderModule(depthShaderModule, nullptr);
+}
+
+void Graphics::DestroyScenePipelines()
+{
+    _device.destroyPipeline(_graphicsPipeline, nullptr);
+    _device.destroyPipeline(_depthPipeline, nullptr);
+    _device.destroyPipelineLayout(_pipelineLayout, nullptr);
+    _device.destroyRenderPass(_renderPass, nullptr);
+    _device.destroyRenderPass(_loadRenderPass, nullptr);
+    _depthPipeline = nullptr;
 }
 
-vk::ShaderModule Graphics::CreateShaderModule(vector<char> &code)
+vk::ShaderModule Graphics::CreateShaderModule(span<const char> code)
 {
 	vk::ShaderModuleCreateInfo createInfo{};
     createInfo.codeSize = code.size();
@@ -985,27 +1156,28 @@ vk::ShaderModule Graphics::CreateShaderModule(vector<char> &code)
 
 void Graphics::CreateFramebuffers()
 {
-    _swapChainFramebuffers.resize(_swapChainImageViews.size());
+    vector attachments = {
+        _colorImageView,
+        _depthImageView,
+        _sceneColorImageView
+    };
 
-    for (size_t i = 0; i < _swapChainImageViews.size(); i++)
+    //the scene color image is the color attachment
+    if (!_colorImage)
     {
-        std::array attachments = {
-            _colorImageView,
-            _depthImageView,
-        	_swapChainImageViews[i]
-        };
+        attachments = { _sceneColorImageView, _depthImageView };
+    }
 
-        vk::FramebufferCreateInfo framebufferInfo{};
-        framebufferInfo.renderPass = _renderPass;
-        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferInfo.pAttachments = attachments.data();
-        framebufferInfo.width = _swapChainExtent.width;
-        framebufferInfo.height = _swapChainExtent.height;
-        framebufferInfo.layers = 1;
+    vk::FramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.renderPass = _renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = _swapChainExtent.width;
+    framebufferInfo.height = _swapChainExtent.height;
+    framebufferInfo.layers = 1;
 
-        vk::Result result = _device.createFramebuffer(&framebufferInfo, nullptr, &_swapChainFramebuffers[i]);
-        Assert(result == vk::Result::eSuccess, "Failed to create framebuffer!", {{"Error Code", static_cast<uint32_t>(result)}, {"index", i}});
-    }
+    vk::Result result = _device.createFramebuffer(&framebufferInfo, nullptr, &_sceneFramebuffer);
+    Assert(result == vk::Result::eSuccess, "Failed to create framebuffer!", {{"Error Code", static_cast<uint32_t>(result)}});
 }
 
 void Graphics::FramebufferResizeCallback(GLFWwindow* window, int width, int height)
@@ -1013,11 +1185,6 @@ void Graphics::FramebufferResizeCallback(GLFWwindow* window, int width, int heig
     _framebufferResized = true;
 }
 
-void Graphics::LoadModel()
-{
-    _modelAsset->Load();
-}
-
 void Graphics::CreateUniformBuffers()
 {
     VkDeviceSize bufferSize = sizeof(mat4) * 3;
@@ -1076,29 +1243,49 @@ void Graphics::CreateDescriptorSets()
         bufferInfo.offset = 0;
         bufferInfo.range = sizeof(mat4) * 3;
 
-        vk::DescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        imageInfo.imageView = _texture->_textureImageView;
-        imageInfo.sampler = _defaultTextureSampler;
-
-        std::array<vk::WriteDescriptorSet, 2> descriptorWrites{};
-        
-        descriptorWrites[0].dstSet = _descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = vk::DescriptorType::eUniformBuffer;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
+        vk::WriteDescriptorSet descriptorWrite{};
         
-        descriptorWrites[1].dstSet = _descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = &imageInfo;
+        descriptorWrite.dstSet = _descriptorSets[i];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = vk::DescriptorType::eUniformBuffer;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+
+        _device.updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
+
+        _boundTextureViews[i] = nullptr;
+        _boundTextureSamplers[i] = nullptr;
+        UpdateTextureDescriptor(static_cast<uint32_t>(i));
+    }
+}
+
+void Graphics::UpdateTextureDescriptor(uint32_t frame)
+{
+    const Texture* texture = AssetDB::Get(_texture);
 
-        _device.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    if (_boundTextureViews[frame] == texture->_textureImageView && _boundTextureSamplers[frame] == texture->_sampler)
+    {
+        return;
     }
+
+    vk::DescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    imageInfo.imageView = texture->_textureImageView;
+    imageInfo.sampler = texture->_sampler;
+
+    vk::WriteDescriptorSet descriptorWrite{};
+    descriptorWrite.dstSet = _descriptorSets[frame];
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    _device.updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
+
+    _boundTextureViews[frame] = texture->_textureImageView;
+    _boundTextureSamplers[frame] = texture->_sampler;
 }
 
 void Graphics::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
@@ -1184,11 +1371,178 @@ void Graphics::RecordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t ima
     vk::Result beginResult = commandBuffer.begin(&beginInfo);
     Assert(beginResult == vk::Result::eSuccess, "Failed to begin command buffer!", { {"Error Code", static_cast<uint32_t>(beginResult)} });
 
+    if (_frameTimestamps)
+    {
+        commandBuffer.resetQueryPool(_frameTimestamps, currentFrame * 2, 2);
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, _frameTimestamps, currentFrame * 2);
+    }
+
+    //TODO: Move this to model.cpp
+    Model* model = AssetDB::Get(_modelAsset);
+
+    _renderGraph.Reset();
+
+    //the color and depth buffers are cleared every frame, so whatever the last frame left in them doesn't matter
+    const uint32_t depth = _renderGraph.ImportImage("Depth", _depthImage, GetImageAspect(FindDepthFormat()), 1, RenderGraph::ACCESS_DEPTH_ATTACHMENT);
+    const uint32_t swapChainImage = _renderGraph.ImportImage("Swap chain image", _swapChainImages[imageIndex], vk::ImageAspectFlagBits::eColor, 1,
+        RenderGraph::ACCESS_PRESENT);
+    _renderGraph.Export(swapChainImage, RenderGraph::ACCESS_PRESENT);
+    //the last frame's upscale read it
+    const uint32_t sceneColor = _renderGraph.ImportImage("Scene color", _sceneColorImage, vk::ImageAspectFlagBits::eColor, 1,
+        RenderGraph::ACCESS_TRANSFER_READ);
+    //without MSAA the scene draws straight into the scene color image
+    const uint32_t color = _colorImage ? _renderGraph.ImportImage("Color", _colorImage, vk::ImageAspectFlagBits::eColor, 1, RenderGraph::ACCESS_COLOR_ATTACHMENT)
+        : sceneColor;
+
+    //the scene passes clear color and depth and resolve into the scene color image, if there's a separate color buffer
+    //only the _renderExtent corner of them is ever looked at
+    auto writeTargets = [&](uint32_t pass, bool clear)
+        {
+            _renderGraph.Write(pass, color, RenderGraph::ACCESS_COLOR_ATTACHMENT, clear);
+            _renderGraph.Write(pass, depth, RenderGraph::ACCESS_DEPTH_ATTACHMENT, clear);
+
+            if (color != sceneColor)
+            {
+                _renderGraph.Write(pass, sceneColor, RenderGraph::ACCESS_COLOR_ATTACHMENT, true);
+            }
+        };
+
+    //on the GPU culling and LOD selection don't cost recording anything per instance
+    if (_gpuCulling)
+    {
+        GpuCulling::PrepareFrame(currentFrame, *model, _model);
+        const GpuCulling::GraphResources culling = GpuCulling::ImportResources(_renderGraph, currentFrame);
+
+        //what was visible last frame goes first, its depth is what everything else gets occlusion tested against
+        GpuCulling::AddResetPass(_renderGraph, currentFrame, culling);
+        GpuCulling::AddCullPass(_renderGraph, currentFrame, culling, GpuCulling::CULL_PASS_PREVIOUSLY_VISIBLE);
+
+        //the draws a cull pass wrote, once depth only first when there's a prepass
+        auto recordDraws = [model](vk::RenderPass renderPass, GpuCulling::CullPass cullPass)
+            {
+                return [model, renderPass, cullPass](vk::CommandBuffer commandBuffer)
+                    {
+                        BeginScenePass(commandBuffer, renderPass);
+
+                        if (_depthPrepass)
+                        {
+                            BindScene(commandBuffer, *model, GpuCulling::GetInstanceBuffer(), true);
+                            GpuCulling::RecordDraw(commandBuffer, currentFrame, cullPass);
+                            commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+                        }
+
+                        BindScene(commandBuffer, *model, GpuCulling::GetInstanceBuffer());
+                        GpuCulling::RecordDraw(commandBuffer, currentFrame, cullPass);
+                        commandBuffer.endRenderPass();
+                    };
+            };
+
+        const uint32_t firstDraw = _renderGraph.AddPass("Draw previously visible", recordDraws(_renderPass, GpuCulling::CULL_PASS_PREVIOUSLY_VISIBLE));
+        writeTargets(firstDraw, true);
+        GpuCulling::ReadDraws(_renderGraph, firstDraw, culling);
+
+        GpuCulling::AddDepthPyramidPass(_renderGraph, culling, depth);
+        GpuCulling::AddCullPass(_renderGraph, currentFrame, culling, GpuCulling::CULL_PASS_NEWLY_VISIBLE);
+
+        const uint32_t secondDraw = _renderGraph.AddPass("Draw newly visible", recordDraws(_loadRenderPass, GpuCulling::CULL_PASS_NEWLY_VISIBLE));
+        writeTargets(secondDraw, false);
+        GpuCulling::ReadDraws(_renderGraph, secondDraw, culling);
+
+        GpuCulling::AddReadbackPass(_renderGraph, currentFrame, culling);
+    }
+    else
+    {
+        array<uint32_t, Model::MAX_LODS> lodCounts{};
+        CullInstances(*model, lodCounts);
+
+        //every LOD's instances are contiguous in the stream, so each LOD is one draw
+        _drawList.Clear();
+        uint32_t firstInstance = 0;
+
+        for (uint32_t lod = 0; lod < Model::MAX_LODS; lod++)
+        {
+            if (lodCounts[lod] > 0)
+            {
+                const DrawList::Draw draw{ _graphicsPipeline, _descriptorSets[currentFrame], model, _instanceStreams[currentFrame], lod,
+                    firstInstance, lodCounts[lod] };
+
+                //finer LODs are the closer instances, so LOD order is roughly front to back
+                const uint32_t depth = DrawList::QuantizeDepth(static_cast<float>(lod) / Model::MAX_LODS);
+                _drawList.Add(DrawList::MakeKey(DRAW_PASS_OPAQUE, 0, 0, _modelAsset.index, depth), draw);
+
+                if (_depthPrepass)
+                {
+                    DrawList::Draw depthDraw = draw;
+                    depthDraw.pipeline = _depthPipeline;
+                    depthDraw.positionsOnly = true;
+                    _drawList.Add(DrawList::MakeKey(DRAW_PASS_DEPTH_PREPASS, 0, 0, _modelAsset.index, depth), depthDraw);
+                }
+            }
+
+            firstInstance += lodCounts[lod];
+        }
+
+        _drawList.Sort();
+
+        //no occlusion culling, so one pass draws and resolves everything
+        const uint32_t scene = _renderGraph.AddPass("Scene", [](vk::CommandBuffer commandBuffer)
+            {
+                BeginScenePass(commandBuffer, _renderPass);
+
+                if (_depthPrepass)
+                {
+                    _drawList.Record(commandBuffer, _pipelineLayout, DRAW_PASS_DEPTH_PREPASS);
+                    commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+                }
+
+                _drawList.Record(commandBuffer, _pipelineLayout, DRAW_PASS_OPAQUE);
+                commandBuffer.endRenderPass();
+            });
+        writeTargets(scene, true);
+    }
+
+    //stretches what the scene rendered over the whole swap chain image
+    const uint32_t upscale = _renderGraph.AddPass("Upscale", [imageIndex](vk::CommandBuffer commandBuffer)
+        {
+            vk::ImageBlit blit{};
+            blit.srcOffsets[0] = vk::Offset3D{ 0, 0, 0 };
+            blit.srcOffsets[1] = vk::Offset3D{ static_cast<int32_t>(_renderExtent.width), static_cast<int32_t>(_renderExtent.height), 1 };
+            blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+            blit.srcSubresource.mipLevel = 0;
+            blit.srcSubresource.baseArrayLayer = 0;
+            blit.srcSubresource.layerCount = 1;
+            blit.dstOffsets[0] = vk::Offset3D{ 0, 0, 0 };
+            blit.dstOffsets[1] = vk::Offset3D{ static_cast<int32_t>(_swapChainExtent.width), static_cast<int32_t>(_swapChainExtent.height), 1 };
+            blit.dstSubresource = blit.srcSubresource;
+
+            commandBuffer.blitImage(
+                _sceneColorImage, vk::ImageLayout::eTransferSrcOptimal,
+                _swapChainImages[imageIndex], vk::ImageLayout::eTransferDstOptimal,
+                1, &blit,
+                _upscaleFilter);
+        });
+    _renderGraph.Read(upscale, sceneColor, RenderGraph::ACCESS_TRANSFER_READ);
+    _renderGraph.Write(upscale, swapChainImage, RenderGraph::ACCESS_TRANSFER_WRITE, true);
+
+    _renderGraph.Execute(commandBuffer);
+
+    if (_frameTimestamps)
+    {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, _frameTimestamps, currentFrame * 2 + 1);
+        _frameTimestampsWritten[currentFrame] = true;
+    }
+
+    commandBuffer.end();
+}
+
+void Graphics::BeginScenePass(vk::CommandBuffer commandBuffer, vk::RenderPass renderPass)
+{
     vk::RenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.renderPass = _renderPass;
-    renderPassInfo.framebuffer = _swapChainFramebuffers[imageIndex];
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = _sceneFramebuffer;
     renderPassInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
-    renderPassInfo.renderArea.extent = _swapChainExtent;
+    //clears, loads, stores and resolves all stay inside it
+    renderPassInfo.renderArea.extent = _renderExtent;
 
     std::array<vk::ClearValue, 2> clearValues{};
     clearValues[0].color = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
@@ -1198,32 +1552,32 @@ void Graphics::RecordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t ima
     renderPassInfo.pClearValues = clearValues.data();
 
     commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _graphicsPipeline);
-    //TODO: Move this to model.cpp
-    vk::Buffer vertexBuffers[] = { _modelAsset->_vertexBuffer };
-    vk::DeviceSize offsets[] = { 0 };
-    commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
-
-    commandBuffer.bindIndexBuffer(_modelAsset->_indexBuffer, 0, vk::IndexType::eUint32);
 
     vk::Viewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = static_cast<float>(_swapChainExtent.width);
-    viewport.height = static_cast<float>(_swapChainExtent.height);
+    viewport.width = static_cast<float>(_renderExtent.width);
+    viewport.height = static_cast<float>(_renderExtent.height);
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
     commandBuffer.setViewport(0, 1, &viewport);
 
     vk::Rect2D scissor{};
     scissor.offset = vk::Offset2D{ 0, 0 };
-    scissor.extent = _swapChainExtent;
+    scissor.extent = _renderExtent;
     commandBuffer.setScissor(0, 1, &scissor);
+}
+
+void Graphics::BindScene(vk::CommandBuffer commandBuffer, const Model& model, vk::Buffer instanceBuffer, bool depthPrepass)
+{
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, depthPrepass ? _depthPipeline : _graphicsPipeline);
+    vk::Buffer vertexBuffers[] = { depthPrepass ? model._positionBuffer : model._vertexBuffer, instanceBuffer };
+    vk::DeviceSize offsets[] = { 0, 0 };
+    commandBuffer.bindVertexBuffers(0, 2, vertexBuffers, offsets);
+
+    commandBuffer.bindIndexBuffer(model._indexBuffer, 0, vk::IndexType::eUint32);
 
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipelineLayout, 0, 1, &_descriptorSets[currentFrame], 0, nullptr);
-    commandBuffer.drawIndexed(static_cast<uint32_t>(_modelAsset->_indices.size()), 1, 0, 0, 0);
-    commandBuffer.endRenderPass();
-    commandBuffer.end();
 }
 
 vk::CommandBuffer Graphics::BeginSingleTimeCommands()
@@ -1264,10 +1618,12 @@ void Graphics::EndSingleTimeCommands(vk::CommandBuffer commandBuffer)
 void Graphics::CreateDepthResources()
 {
     vk::Format depthFormat = FindDepthFormat();
+    //only the depth pyramid samples it
+    const vk::ImageUsageFlags usage = AttachmentsStayInRenderPass() ? vk::ImageUsageFlagBits::eTransientAttachment : vk::ImageUsageFlagBits::eSampled;
 
     CreateImage(_swapChainExtent.width, _swapChainExtent.height, 1, _msaaSamples,
         depthFormat, vk::ImageTiling::eOptimal, 
-        vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal,
+        vk::ImageUsageFlagBits::eDepthStencilAttachment | usage, vk::MemoryPropertyFlagBits::eDeviceLocal,
         _depthImage, _depthImageMemory);
     _depthImageView = CreateImageView(_depthImage, depthFormat, 1, vk::ImageAspectFlagBits::eDepth);
     TransitionImageLayout(_depthImage, depthFormat, 1,
@@ -1300,7 +1656,8 @@ vk::Format Graphics::FindDepthFormat()
     return FindSupportedFormat(
         {vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint },
         vk::ImageTiling::eOptimal,
-        vk::FormatFeatureFlagBits::eDepthStencilAttachment
+        //the depth pyramid samples it
+        vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage
     );
 }
 
@@ -1309,9 +1666,20 @@ bool Graphics::HasStencilComponent(vk::Format format)
     return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
 }
 
-void Graphics::CreateTextureImage()
+vk::ImageAspectFlags Graphics::GetImageAspect(vk::Format format)
 {
-    _texture->Load();
+    switch (format)
+    {
+    case vk::Format::eD16Unorm:
+    case vk::Format::eD32Sfloat:
+        return vk::ImageAspectFlagBits::eDepth;
+    case vk::Format::eD16UnormS8Uint:
+    case vk::Format::eD24UnormS8Uint:
+    case vk::Format::eD32SfloatS8Uint:
+        return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+    default:
+        return vk::ImageAspectFlagBits::eColor;
+    }
 }
 
 void Graphics::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits samples, vk::Format format, vk::ImageTiling tiling,
@@ -1335,90 +1703,38 @@ void Graphics::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels,
 
     VmaAllocationCreateInfo allocInfo = {};
     allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocInfo.requiredFlags = static_cast<VkMemoryPropertyFlags>(properties & ~vk::MemoryPropertyFlagBits::eLazilyAllocated);
 
-    vmaCreateImage(_allocator, reinterpret_cast<VkImageCreateInfo*>(&imageInfo),
+    //memory that might never get backed, the attachment can stay in tile memory for the whole pass
+    if ((usage & vk::ImageUsageFlagBits::eTransientAttachment) && _lazilyAllocatedSupported)
+    {
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+        allocInfo.requiredFlags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    }
+
+    VkResult result = vmaCreateImage(_allocator, reinterpret_cast<VkImageCreateInfo*>(&imageInfo),
         &allocInfo, reinterpret_cast<VkImage*>(&image), &imageMemory, nullptr);
+    Assert(result == VK_SUCCESS, "Failed to create image!", { {"Error Code", static_cast<int32_t>(result)}, {"Width", width}, {"Height", height} });
 }
 
 void Graphics::TransitionImageLayout(vk::Image image, vk::Format format, uint32_t mipLevels, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
 {
     vk::CommandBuffer commandBuffer = BeginSingleTimeCommands();
 
-    vk::ImageMemoryBarrier barrier{};
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = mipLevels;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.srcAccessMask = {}; // TODO
-    barrier.dstAccessMask = {}; // TODO
-
-    vk::PipelineStageFlags sourceStage;
-    vk::PipelineStageFlags destinationStage;
-
-    if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal)
-    {
-        barrier.srcAccessMask = {};
-        barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-
-        sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-        destinationStage = vk::PipelineStageFlagBits::eTransfer;
-    }
-    else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
-    {
-        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-        sourceStage = vk::PipelineStageFlagBits::eTransfer;
-        destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
-    }
-    else if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
-    {
-        barrier.srcAccessMask = {};
-        barrier.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
-
-        sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-        destinationStage = vk::PipelineStageFlagBits::eEarlyFragmentTests;
-    }
-    else
-    {
-       Assert(false,"unsupported layout transition!");
-    }
-
-    if (newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
-    {
-        barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth;
-
-        if (HasStencilComponent(format))
-        {
-            barrier.subresourceRange.aspectMask |= vk::ImageAspectFlagBits::eStencil;
-        }
-    }
-    else
-    {
-        barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-    }
-
-    commandBuffer.pipelineBarrier(
-        sourceStage, destinationStage,
-        {},
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
-    );
+    TransitionImageLayout(commandBuffer, image, format, mipLevels, oldLayout, newLayout);
 
     EndSingleTimeCommands(commandBuffer);
 }
 
-void Graphics::CopyBufferToImage(vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height)
+void Graphics::TransitionImageLayout(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format format, uint32_t mipLevels, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+    uint32_t baseMipLevel)
 {
-    vk::CommandBuffer commandBuffer = BeginSingleTimeCommands();
+    RenderGraph::RecordTransition(commandBuffer, image, GetImageAspect(format), baseMipLevel, mipLevels, RenderGraph::GetLayoutInfo(oldLayout),
+        RenderGraph::GetLayoutInfo(newLayout));
+}
 
+void Graphics::CopyBufferToImage(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height)
+{
     vk::BufferImageCopy region{};
     region.bufferOffset = 0;
     region.bufferRowLength = 0;
@@ -1443,18 +1759,62 @@ void Graphics::CopyBufferToImage(vk::Buffer buffer, vk::Image image, uint32_t wi
         1,
         &region
     );
+}
 
-    EndSingleTimeCommands(commandBuffer);
+void Graphics::CopyBufferToImageMips(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height,
+    const vector<vk::DeviceSize>& mipOffsets, uint32_t baseMipLevel)
+{
+    vector<vk::BufferImageCopy> regions(mipOffsets.size());
+
+    for (uint32_t i = 0; i < regions.size(); i++)
+    {
+        const uint32_t mipLevel = baseMipLevel + i;
+
+        regions[i].bufferOffset = mipOffsets[i];
+        regions[i].bufferRowLength = 0;
+        regions[i].bufferImageHeight = 0;
+
+        regions[i].imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        regions[i].imageSubresource.mipLevel = mipLevel;
+        regions[i].imageSubresource.baseArrayLayer = 0;
+        regions[i].imageSubresource.layerCount = 1;
+
+        regions[i].imageOffset = vk::Offset3D{ 0, 0, 0 };
+        regions[i].imageExtent = vk::Extent3D{ std::max(width >> mipLevel, 1u), std::max(height >> mipLevel, 1u), 1 };
+    }
+
+    commandBuffer.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal,
+        static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void Graphics::CopyImageMips(vk::CommandBuffer commandBuffer, vk::Image srcImage, uint32_t srcBaseMip, vk::Image dstImage,
+    uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    vector<vk::ImageCopy> regions(mipLevels);
+
+    for (uint32_t i = 0; i < mipLevels; i++)
+    {
+        regions[i].srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        regions[i].srcSubresource.mipLevel = srcBaseMip + i;
+        regions[i].srcSubresource.baseArrayLayer = 0;
+        regions[i].srcSubresource.layerCount = 1;
+        regions[i].dstSubresource = regions[i].srcSubresource;
+        regions[i].dstSubresource.mipLevel = i;
+        regions[i].extent = vk::Extent3D{ std::max(width >> i, 1u), std::max(height >> i, 1u), 1 };
+    }
+
+    commandBuffer.copyImage(srcImage, vk::ImageLayout::eTransferSrcOptimal, dstImage, vk::ImageLayout::eTransferDstOptimal,
+        static_cast<uint32_t>(regions.size()), regions.data());
 }
 
-vk::ImageView Graphics::CreateImageView(vk::Image image, vk::Format format, uint32_t mipLevels, vk::ImageAspectFlags aspectFlags)
+vk::ImageView Graphics::CreateImageView(vk::Image image, vk::Format format, uint32_t mipLevels, vk::ImageAspectFlags aspectFlags, uint32_t baseMipLevel)
 {
     vk::ImageViewCreateInfo viewInfo{};
     viewInfo.image = image;
     viewInfo.viewType = vk::ImageViewType::e2D;
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
-    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
     viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
@@ -1466,34 +1826,7 @@ vk::ImageView Graphics::CreateImageView(vk::Image image, vk::Format format, uint
     return imageView;
 }
 
-void Graphics::CreateTextureSampler()
-{
-    vk::SamplerCreateInfo samplerInfo{};
-    samplerInfo.magFilter = vk::Filter::eLinear;
-    samplerInfo.minFilter = vk::Filter::eLinear;
-    samplerInfo.addressModeU = vk::SamplerAddressMode::eRepeat;
-    samplerInfo.addressModeV = vk::SamplerAddressMode::eRepeat;
-    samplerInfo.addressModeW = vk::SamplerAddressMode::eRepeat;
-    samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
-    samplerInfo.minLod = 0.0f; // Optional
-    samplerInfo.maxLod = static_cast<float>(_mipLevels);
-    samplerInfo.mipLodBias = 0.0f; // Optional
-
-    vk::PhysicalDeviceProperties properties{};
-    _physicalDevice.getProperties(&properties);
-
-    samplerInfo.anisotropyEnable = VK_TRUE;
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-    samplerInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = vk::CompareOp::eAlways;
-
-    vk::Result result = _device.createSampler(&samplerInfo, nullptr, &_defaultTextureSampler);
-    Assert(result == vk::Result::eSuccess, "failed to create texture image view!", { {"Error Code", static_cast<uint32_t>(result)} });
-}
-
-void Graphics::GenerateMipmaps(vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
+void Graphics::GenerateMipmaps(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
 {
 	// Check if image format supports linear blitting
     vk::FormatProperties formatProperties;
@@ -1501,33 +1834,12 @@ void Graphics::GenerateMipmaps(vk::Image image, vk::Format imageFormat, int32_t
     Assert(static_cast<bool>((formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)),
         "texture image format does not support linear blitting!");
 
-    vk::CommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-    vk::ImageMemoryBarrier barrier{};
-    barrier.image = image;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.subresourceRange.levelCount = 1;
-
     int32_t mipWidth = texWidth;
     int32_t mipHeight = texHeight;
 
     for (uint32_t i = 1; i < mipLevels; i++)
     {
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-        barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
-        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-        barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
-
-        commandBuffer.pipelineBarrier(
-            vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {},
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
+        TransitionImageLayout(commandBuffer, image, imageFormat, 1, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal, i - 1);
 
         vk::ImageBlit blit{};
         blit.srcOffsets[0] = vk::Offset3D{ 0, 0, 0 };
@@ -1549,34 +1861,14 @@ void Graphics::GenerateMipmaps(vk::Image image, vk::Format imageFormat, int32_t
             1, &blit,
             vk::Filter::eLinear);
 
-        barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
-        barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
-        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-        commandBuffer.pipelineBarrier(
-            vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {},
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
+        TransitionImageLayout(commandBuffer, image, imageFormat, 1, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, i - 1);
 
         if (mipWidth > 1) mipWidth /= 2;
         if (mipHeight > 1) mipHeight /= 2;
     }
 
-    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-    commandBuffer.pipelineBarrier(
-        vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {},
-        0, nullptr,
-        0, nullptr,
-        1, &barrier);
-
-    EndSingleTimeCommands(commandBuffer);
+    TransitionImageLayout(commandBuffer, image, imageFormat, 1, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+        mipLevels - 1);
 }
 
 void Graphics::CreateSyncObjects()
@@ -1602,29 +1894,262 @@ void Graphics::CreateSyncObjects()
 
 }
 
-vk::SampleCountFlagBits Graphics::GetMaxUsableSampleCount()
+void Graphics::CreateFrameTimestamps()
+{
+    const vector<vk::QueueFamilyProperties> queueFamilies = _physicalDevice.getQueueFamilyProperties();
+
+    if (queueFamilies[_queueFamilyIndices.graphicsFamily.value()].timestampValidBits == 0)
+    {
+        return;
+    }
+
+    _timestampPeriod = _physicalDevice.getProperties().limits.timestampPeriod;
+
+    vk::QueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.queryType = vk::QueryType::eTimestamp;
+    queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
+
+    vk::Result result = _device.createQueryPool(&queryPoolInfo, nullptr, &_frameTimestamps);
+    Assert(result == vk::Result::eSuccess, "Failed to create query pool!", { {"Error Code", static_cast<uint32_t>(result)} });
+}
+
+bool Graphics::ReadFrameTimestamps(uint32_t frame)
+{
+    if (!_frameTimestampsWritten[frame])
+    {
+        return false;
+    }
+
+    //the fence says the frame is done, so its timestamps are there without waiting
+    uint64_t timestamps[2];
+    vk::Result result = _device.getQueryPoolResults(_frameTimestamps, frame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64);
+    Assert(result == vk::Result::eSuccess, "Failed to read timestamps!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    _gpuFrameMs = (timestamps[1] - timestamps[0]) * _timestampPeriod / 1e6;
+    _frameTimestampsWritten[frame] = false;
+
+    return true;
+}
+
+Graphics::QualitySettings Graphics::GetQualitySettings(QualityTier tier)
+{
+    static const array<QualitySettings, QUALITY_COUNT> settings = { {
+        { vk::SampleCountFlagBits::e1, false, "MSAA off" },
+        { vk::SampleCountFlagBits::e2, false, "2x MSAA" },
+        { vk::SampleCountFlagBits::e2, true, "2x MSAA, sample shading" },
+        { vk::SampleCountFlagBits::e4, false, "4x MSAA" },
+        { vk::SampleCountFlagBits::e4, true, "4x MSAA, sample shading" },
+        { vk::SampleCountFlagBits::e8, false, "8x MSAA" },
+        { vk::SampleCountFlagBits::e8, true, "8x MSAA, sample shading" },
+    } };
+
+    return settings[tier];
+}
+
+vk::SampleCountFlags Graphics::GetUsableSampleCounts()
 {
     vk::PhysicalDeviceProperties physicalDeviceProperties;
     _physicalDevice.getProperties(&physicalDeviceProperties);
 
-    vk::SampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts;
-    if (counts & vk::SampleCountFlagBits::e64) { return vk::SampleCountFlagBits::e64; }
-    if (counts & vk::SampleCountFlagBits::e32) { return vk::SampleCountFlagBits::e32; }
-    if (counts & vk::SampleCountFlagBits::e16) { return vk::SampleCountFlagBits::e16; }
-    if (counts & vk::SampleCountFlagBits::e8) { return vk::SampleCountFlagBits::e8; }
-    if (counts & vk::SampleCountFlagBits::e4) { return vk::SampleCountFlagBits::e4; }
-    if (counts & vk::SampleCountFlagBits::e2) { return vk::SampleCountFlagBits::e2; }
+    //the depth pyramid reads the multisampled depth buffer in a shader
+    return physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts
+        & physicalDeviceProperties.limits.sampledImageDepthSampleCounts;
+}
+
+bool Graphics::SupportsQuality(QualityTier tier)
+{
+    const QualitySettings settings = GetQualitySettings(tier);
+
+    return (GetUsableSampleCounts() & settings.samples) && (!settings.sampleShading || _sampleShadingSupported);
+}
+
+void Graphics::SetQuality(QualityTier tier)
+{
+    if (!SupportsQuality(tier))
+    {
+        Error("Quality tier isn't supported by the device!", { {"Tier", GetQualitySettings(tier).name} });
+        return;
+    }
+
+    _device.waitIdle();
+
+    DestroyAttachments();
+    DestroyScenePipelines();
+
+    _quality = tier;
+    _msaaSamples = GetQualitySettings(tier).samples;
+
+    CreateSceneTargets();
+
+    Log("Quality tier set", { {"Tier", GetQualitySettings(tier).name} });
+}
+
+void Graphics::SetGpuCulling(bool enabled)
+{
+    _device.waitIdle();
+
+    //the attachments' store ops and usage and whether there's a depth pyramid all follow AttachmentsStayInRenderPass
+    DestroyAttachments();
+    DestroyScenePipelines();
+
+    _gpuCulling = enabled;
+
+    CreateSceneTargets();
+
+    Log("GPU culling set", { {"Enabled", _gpuCulling} });
+}
+
+void Graphics::CreateSceneTargets()
+{
+    CreateRenderPass();
+    CreateGraphicsPipeline();
+    CreateColorResources();
+    CreateDepthResources();
+    GpuCulling::CreateDepthPyramid();
+    CreateFramebuffers();
+}
+
+void Graphics::SetDepthPrepass(bool enabled)
+{
+    _device.waitIdle();
+
+    //the subpass count changes, so the framebuffer isn't compatible with the new render passes anymore
+    _device.destroyFramebuffer(_sceneFramebuffer, nullptr);
+    DestroyScenePipelines();
+
+    _depthPrepass = enabled;
+
+    CreateRenderPass();
+    CreateGraphicsPipeline();
+    CreateFramebuffers();
+
+    Log("Depth prepass set", { {"Enabled", _depthPrepass} });
+}
+
+void Graphics::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+    {
+        return;
+    }
+
+    if (key == GLFW_KEY_P)
+    {
+        SetDepthPrepass(!_depthPrepass);
+
+        return;
+    }
+
+    if (key == GLFW_KEY_C)
+    {
+        SetGpuCulling(!_gpuCulling);
+
+        return;
+    }
+
+    if (key == GLFW_KEY_R)
+    {
+        _dynamicResolution = !_dynamicResolution;
+        SetRenderScale(1.0f);
+        Log("Dynamic resolution toggled", { {"Enabled", _dynamicResolution} });
+
+        return;
+    }
+
+    if (key != GLFW_KEY_M)
+    {
+        return;
+    }
+
+    //off is always supported, so this stops
+    QualityTier tier = _quality;
+
+    do
+    {
+        tier = static_cast<QualityTier>((tier + 1) % QUALITY_COUNT);
+    } while (!SupportsQuality(tier));
+
+    SetQuality(tier);
+}
+
+void Graphics::SetRenderScale(float scale)
+{
+    _renderScale = std::clamp(scale, MIN_RENDER_SCALE, 1.0f);
+    _renderExtent.width = std::max(static_cast<uint32_t>(_swapChainExtent.width * _renderScale + 0.5f), 1u);
+    _renderExtent.height = std::max(static_cast<uint32_t>(_swapChainExtent.height * _renderScale + 0.5f), 1u);
+
+    //frames still in flight were recorded at the old scale
+    _renderScaleChangedFrame = _frameNumber;
+    _renderScaleFrameMs = 0.0;
+    _renderScaleFrames = 0;
+}
+
+void Graphics::UpdateRenderScale()
+{
+    //the frame just measured was submitted MAX_FRAMES_IN_FLIGHT frames ago
+    if (!_dynamicResolution || _frameNumber < _renderScaleChangedFrame + MAX_FRAMES_IN_FLIGHT)
+    {
+        return;
+    }
+
+    _renderScaleFrameMs += _gpuFrameMs;
+    _renderScaleFrames++;
+
+    if (_renderScaleFrames < RENDER_SCALE_INTERVAL)
+    {
+        return;
+    }
+
+    const double frameMs = _renderScaleFrameMs / _renderScaleFrames;
+    _renderScaleFrameMs = 0.0;
+    _renderScaleFrames = 0;
+
+    if (frameMs <= _targetFrameMs && (frameMs >= _targetFrameMs * RENDER_SCALE_RAISE_BELOW || _renderScale == 1.0f))
+    {
+        return;
+    }
 
-    return vk::SampleCountFlagBits::e1;
+    //most of the frame's GPU time goes with the pixel count, which goes with the square of the scale
+    const float scale = _renderScale * static_cast<float>(std::sqrt(_targetFrameMs * RENDER_SCALE_HEADROOM / frameMs));
+    SetRenderScale(std::clamp(scale, _renderScale - MAX_RENDER_SCALE_STEP, _renderScale + MAX_RENDER_SCALE_STEP));
+}
+
+bool Graphics::AttachmentsStayInRenderPass()
+{
+    //occlusion culling draws in two passes with the depth pyramid built in between
+    return !_gpuCulling;
 }
 
 void Graphics::CreateColorResources()
 {
     vk::Format colorFormat = _swapChainImageFormat;
 
+    vk::FormatProperties formatProperties;
+    _physicalDevice.getFormatProperties(colorFormat, &formatProperties);
+    Assert(static_cast<bool>(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eBlitSrc),
+        "Swap chain format can't be blitted from!");
+    _upscaleFilter = formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear ? vk::Filter::eLinear
+        : vk::Filter::eNearest;
+
+    CreateImage(_swapChainExtent.width, _swapChainExtent.height, 1,
+        vk::SampleCountFlagBits::e1, colorFormat, vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eDeviceLocal,
+        _sceneColorImage, _sceneColorImageMemory);
+    _sceneColorImageView = CreateImageView(_sceneColorImage, colorFormat, 1, vk::ImageAspectFlagBits::eColor);
+
+    //the scene renders into the scene color image
+    if (_msaaSamples == vk::SampleCountFlagBits::e1)
+    {
+        return;
+    }
+
+    //stored for the second pass otherwise, transient would still get it lazily allocated memory that then has to be backed
+    const vk::ImageUsageFlags usage = AttachmentsStayInRenderPass() ? vk::ImageUsageFlagBits::eTransientAttachment : vk::ImageUsageFlags{};
+
     CreateImage(_swapChainExtent.width, _swapChainExtent.height, 1,
         _msaaSamples, colorFormat, vk::ImageTiling::eOptimal, 
-        vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, _colorImage,
+        vk::ImageUsageFlagBits::eColorAttachment | usage, vk::MemoryPropertyFlagBits::eDeviceLocal, _colorImage,
         _colorImageMemory);
     _colorImageView = CreateImageView(_colorImage, colorFormat, 1, vk::ImageAspectFlagBits::eColor);
 }
@@ -1634,6 +2159,18 @@ void Graphics::DrawFrame()
     vk::Result result = _device.waitForFences(1, &_inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
     Assert(result == vk::Result::eSuccess, "Failed to wait for fence!", { {"Error Code", static_cast<uint32_t>(result)} });
 
+    if (ReadFrameTimestamps(currentFrame))
+    {
+        UpdateRenderScale();
+    }
+
+    //this frame's last use of its resources is over, so this is where streamed assets get swapped in
+    RunDeferredDestroys(false);
+    vmaSetCurrentFrameIndex(_allocator, static_cast<uint32_t>(_frameNumber));
+    LiveReload::Update();
+    AssetDB::Update();
+    UpdateTextureDescriptor(currentFrame);
+
     uint32_t imageIndex;
     result = _device.acquireNextImageKHR(_swapChain, UINT64_MAX, _imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
@@ -1651,15 +2188,17 @@ void Graphics::DrawFrame()
     result = _device.resetFences(1, &_inFlightFences[currentFrame]);
     Assert(result == vk::Result::eSuccess, "Failed to reset fence!", { {"Error Code", static_cast<uint32_t>(result)} });
 
+    //matrices have to be current before recording since LOD selection reads them
+    UpdateUniformBuffer(currentFrame);
+
     _commandBuffers[currentFrame].reset({});
     RecordCommandBuffer(_commandBuffers[currentFrame], imageIndex);
 
-    UpdateUniformBuffer(currentFrame);
-
     vk::SubmitInfo submitInfo{};
 
     vk::Semaphore waitSemaphores[] = { _imageAvailableSemaphores[currentFrame]};
-    vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+    //only the upscale touches the swap chain image, everything before it runs while the image is still being presented
+    vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eTransfer };
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
@@ -1672,6 +2211,7 @@ void Graphics::DrawFrame()
 
     vk::Result subResult = _graphicsQueue.submit(1, &submitInfo, _inFlightFences[currentFrame]);
     Assert(subResult == vk::Result::eSuccess, "Failed to submit draw command buffer!", { {"Error Code", static_cast<uint32_t>(subResult)} });
+    _frameNumber++;
 
     vk::PresentInfoKHR presentInfo{};
 
@@ -1699,6 +2239,21 @@ void Graphics::DrawFrame()
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
+void Graphics::DeferDestroy(function<void()> destroy)
+{
+    _deferredDestroys.emplace_back(_frameNumber, move(destroy));
+}
+
+void Graphics::RunDeferredDestroys(bool all)
+{
+    //anything queued during frame n can be used up to frame n, which is done once frame n + MAX_FRAMES_IN_FLIGHT starts
+    while (!_deferredDestroys.empty() && (all || _deferredDestroys.front().first + MAX_FRAMES_IN_FLIGHT <= _frameNumber))
+    {
+        _deferredDestroys.front().second();
+        _deferredDestroys.pop_front();
+    }
+}
+
 void Graphics::UpdateUniformBuffer(uint32_t currentImage)
 {
     static auto startTime = std::chrono::high_resolution_clock::now();
@@ -1706,7 +2261,9 @@ void Graphics::UpdateUniformBuffer(uint32_t currentImage)
     auto currentTime = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
-    _model = glm::rotate(mat4(1.0f), time * radians(90.0f), vec3(0.0f, 0.0f, 1.0f));
+    _scene.SetRotation(_modelNode, angleAxis(time * radians(90.0f), vec3(0.0f, 0.0f, 1.0f)));
+    _scene.Update();
+    _model = _scene.GetWorld(_modelNode);
     _view = lookAt(vec3(2.0f, 2.0f, 2.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f));
     _proj = perspective(radians(45.0f), _swapChainExtent.width / static_cast<float>(_swapChainExtent.height), 0.1f, 10.0f);
     _proj[1][1] *= -1;
@@ -1716,6 +2273,169 @@ void Graphics::UpdateUniformBuffer(uint32_t currentImage)
     memcpy(static_cast<char*>(_uniformBuffersMapped[currentImage]) + sizeof(mat4) * 2, &_proj, sizeof(mat4));
 }
 
+void Graphics::SetInstances(span<const Model::Instance> instances)
+{
+    GpuCulling::SetInstances(instances);
+
+    _entities.Clear();
+
+    for (const Model::Instance& instance : instances)
+    {
+        _entities.Create(TransformComponent{ instance.transform }, MeshComponent{ _modelAsset }, MaterialComponent{ instance.materialIndex },
+            BoundsXComponent{}, BoundsYComponent{}, BoundsZComponent{}, BoundsRadiusComponent{}, LodComponent{});
+    }
+}
+
+void Graphics::CullInstances(const Model& model, array<uint32_t, Model::MAX_LODS>& lodCounts)
+{
+    //planes in _model space, so the bounds don't move when the scene does
+    const Frustum frustum = Frustum::FromMatrix(_proj * _view * _model);
+
+    //both passes run the same query, so chunk indices match between them
+    const size_t chunkCount = _entities.ChunkCount<const MeshComponent, const TransformComponent, const MaterialComponent, const BoundsXComponent,
+        const BoundsYComponent, const BoundsZComponent, const BoundsRadiusComponent, LodComponent>();
+    _chunkVisibleRows.resize(chunkCount);
+    _chunkLodCounts.resize(chunkCount);
+    _chunkLodOffsets.resize(chunkCount);
+
+    _entities.ParallelForEachChunk<const MeshComponent, const TransformComponent, const MaterialComponent, BoundsXComponent,
+        BoundsYComponent, BoundsZComponent, BoundsRadiusComponent, LodComponent>(
+        [&](size_t chunk, span<const MeshComponent> meshes, span<const TransformComponent> transforms, span<const MaterialComponent>,
+            span<BoundsXComponent> xs, span<BoundsYComponent> ys, span<BoundsZComponent> zs, span<BoundsRadiusComponent> radii,
+            span<LodComponent> lods)
+        {
+            vector<uint32_t>& visibleRows = _chunkVisibleRows[chunk];
+            array<uint32_t, Model::MAX_LODS>& counts = _chunkLodCounts[chunk];
+            counts.fill(0);
+
+            //recomputed every frame while the chunk is hot, so moved transforms and a streamed in model's bounds are never stale
+            for (size_t i = 0; i < transforms.size(); i++)
+            {
+                const mat4& transform = transforms[i].transform;
+                const float scale = std::max({ length(vec3(transform[0])), length(vec3(transform[1])), length(vec3(transform[2])) });
+                const vec3 center = vec3(transform * vec4(model._boundsCenter, 1.0f));
+
+                xs[i].x = center.x;
+                ys[i].y = center.y;
+                zs[i].z = center.z;
+                radii[i].radius = model._boundsRadius * scale;
+            }
+
+            //the chunk's bounds arrays go straight into the SIMD kernel, already on this job's thread
+            const SphereCuller::Spheres spheres{ &xs.data()->x, &ys.data()->y, &zs.data()->z, &radii.data()->radius };
+            const uint32_t rowCount = static_cast<uint32_t>(meshes.size());
+            visibleRows.resize(rowCount);
+            visibleRows.resize(SphereCuller::CullRange(frustum, spheres, 0, rowCount, visibleRows.data()));
+
+            //compacts in place, rows stay ascending
+            uint32_t kept = 0;
+
+            for (uint32_t row : visibleRows)
+            {
+                //the one model Graphics draws so far
+                if (meshes[row].model != _modelAsset)
+                {
+                    continue;
+                }
+
+                lods[row].lod = model.SelectLod(PixelsPerUnit(model._boundsCenter, model._boundsRadius, _model * transforms[row].transform), lods[row].lod);
+                counts[lods[row].lod]++;
+                visibleRows[kept++] = row;
+            }
+
+            visibleRows.resize(kept);
+        });
+
+    //every LOD's instances go together, chunks keep their order within a LOD
+    lodCounts.fill(0);
+
+    for (size_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        for (uint32_t lod = 0; lod < Model::MAX_LODS; lod++)
+        {
+            _chunkLodOffsets[chunk][lod] = lodCounts[lod];
+            lodCounts[lod] += _chunkLodCounts[chunk][lod];
+        }
+    }
+
+    array<uint32_t, Model::MAX_LODS> lodFirsts{};
+    uint32_t visibleCount = 0;
+
+    for (uint32_t lod = 0; lod < Model::MAX_LODS; lod++)
+    {
+        lodFirsts[lod] = visibleCount;
+        visibleCount += lodCounts[lod];
+    }
+
+    Model::Instance* stream = MapInstanceStream(currentFrame, visibleCount);
+
+    _entities.ParallelForEachChunk<const MeshComponent, const TransformComponent, const MaterialComponent, const BoundsXComponent,
+        const BoundsYComponent, const BoundsZComponent, const BoundsRadiusComponent, LodComponent>(
+        [&](size_t chunk, span<const MeshComponent>, span<const TransformComponent> transforms, span<const MaterialComponent> materials,
+            span<const BoundsXComponent>, span<const BoundsYComponent>, span<const BoundsZComponent>, span<const BoundsRadiusComponent>,
+            span<LodComponent> lods)
+        {
+            array<uint32_t, Model::MAX_LODS> cursors = _chunkLodOffsets[chunk];
+
+            for (uint32_t row : _chunkVisibleRows[chunk])
+            {
+                const uint32_t lod = lods[row].lod;
+                Model::Instance& instance = stream[lodFirsts[lod] + cursors[lod]++];
+
+                instance.transform = transforms[row].transform;
+                instance.materialIndex = materials[row].materialIndex;
+            }
+        });
+}
+
+Model::Instance* Graphics::MapInstanceStream(uint32_t frame, uint32_t count)
+{
+    //an empty stream still has to be bindable
+    count = std::max(count, 1u);
+
+    if (count > _instanceStreamCapacities[frame])
+    {
+        if (_instanceStreams[frame])
+        {
+            DeferDestroy([buffer = _instanceStreams[frame], memory = _instanceStreamsMemory[frame]]()
+            {
+                vmaUnmapMemory(_allocator, memory);
+                vmaDestroyBuffer(_allocator, buffer, memory);
+            });
+        }
+
+        const uint32_t capacity = bit_ceil(count);
+
+        CreateBuffer(sizeof(Model::Instance) * capacity, vk::BufferUsageFlagBits::eVertexBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            _instanceStreams[frame], _instanceStreamsMemory[frame], VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+        VkResult result = vmaMapMemory(_allocator, _instanceStreamsMemory[frame], &_instanceStreamsMapped[frame]);
+        Assert(result == VK_SUCCESS, "Failed to map instance stream!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+        _instanceStreamCapacities[frame] = capacity;
+    }
+
+    return static_cast<Model::Instance*>(_instanceStreamsMapped[frame]);
+}
+
+float Graphics::PixelsPerUnit(const vec3& center, float radius, const mat4& model)
+{
+    //largest axis scale so the sphere stays conservative under non-uniform scaling
+    const float scale = std::max({ length(vec3(model[0])), length(vec3(model[1])), length(vec3(model[2])) });
+    const vec4 viewCenter = _view * model * vec4(center, 1.0f);
+    const float distance = length(vec3(viewCenter));
+
+    //inside the bounds, everything is as close as it gets
+    if (distance <= radius * scale)
+    {
+        return numeric_limits<float>::max();
+    }
+
+    //in the pixels the scene renders at, a lower render scale picks coarser LODs
+    return scale * std::abs(_proj[1][1]) * 0.5f * static_cast<float>(_renderExtent.height) / distance;
+}
+
 bool Graphics::ShouldClose()
 {
     return glfwWindowShouldClose(_window);
@@ -1725,6 +2445,35 @@ void Graphics::Update()
 {
     glfwPollEvents();
     DrawFrame();
+    UpdateWindowTitle();
+}
+
+void Graphics::UpdateWindowTitle()
+{
+    const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+    if (now - _lastTitleUpdate < chrono::milliseconds(500))
+    {
+        return;
+    }
+
+    _lastTitleUpdate = now;
+    const string prefix = string("Vulkan window - ") + GetQualitySettings(_quality).name + " - " + to_string(_renderExtent.width) + "x"
+        + to_string(_renderExtent.height) + (_dynamicResolution ? " dynamic" : "") + (_depthPrepass ? " - depth prepass" : "") + " - ";
+
+    if (!_gpuCulling)
+    {
+        const DrawList::Stats& stats = _drawList.GetStats();
+        const string title = prefix + to_string(stats.draws) + " draws, " + to_string(stats.StateChanges()) + " state changes";
+        glfwSetWindowTitle(_window, title.c_str());
+
+        return;
+    }
+
+    const GpuCulling::Stats stats = GpuCulling::GetStats();
+    const string title = prefix + to_string(stats.occludedInstances) + " of " + to_string(GpuCulling::InstanceCount())
+        + " instances occluded, " + to_string(stats.occludedTriangles) + " triangles culled";
+    glfwSetWindowTitle(_window, title.c_str());
 }
 
 void Graphics::DeInit()
@@ -1732,6 +2481,13 @@ void Graphics::DeInit()
     //wait for the current frame to finish
     _device.waitIdle();
 
+    LiveReload::DeInit();
+    AssetDB::DeInit();
+    _renderGraph.DestroyTransients();
+    RunDeferredDestroys(true);
+    //nothing streams out of the mapping anymore
+    Package::Unmount();
+
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         _device.destroySemaphore(_renderFinishedSemaphores[i], nullptr);
@@ -1739,11 +2495,22 @@ void Graphics::DeInit()
         _device.destroyFence(_inFlightFences[i], nullptr);
     }
 
+    GpuCulling::DeInit();
     _device.destroyCommandPool(_commandPool, nullptr);
+    _device.destroyQueryPool(_frameTimestamps, nullptr);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        if (_instanceStreams[i])
+        {
+            vmaUnmapMemory(_allocator, _instanceStreamsMemory[i]);
+            vmaDestroyBuffer(_allocator, _instanceStreams[i], _instanceStreamsMemory[i]);
+        }
+    }
 
     CleanupSwapChain();
 
-    _device.destroySampler(_defaultTextureSampler, nullptr);
+    SamplerCache::DeInit();
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
@@ -1753,9 +2520,7 @@ void Graphics::DeInit()
     _device.destroyDescriptorPool(_descriptorPool, nullptr);
 	_device.destroyDescriptorSetLayout(_descriptorSetLayout, nullptr);
 
-    _device.destroyPipeline(_graphicsPipeline, nullptr);
-    _device.destroyPipelineLayout(_pipelineLayout, nullptr);
-    _device.destroyRenderPass(_renderPass, nullptr);
+    DestroyScenePipelines();
 
     vmaDestroyAllocator(_allocator);
 
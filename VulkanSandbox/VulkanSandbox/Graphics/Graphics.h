@@ -2,13 +2,26 @@
 #include <vector>
 #include <optional>
 #include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
 #include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <span>
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan.hpp>
 
-class Model;
+#include "../Assets/AssetHandle.h"
+#include "../Assets/Graphics/Model.h"
+#include "../Scene/Components.h"
+#include "../Scene/EntityManager.h"
+#include "../Scene/TransformHierarchy.h"
+#include "DrawList.h"
+#include "RenderGraph.h"
+
 class Texture;
+class UploadBatch;
 struct GLFWwindow;
 
 class Graphics
@@ -20,6 +33,12 @@ public:
 	static void DeInit();
 	friend class Texture;
 	friend class Model;
+	friend class UploadBatch;
+	friend class AssetDB;
+	friend class Benchmark;
+	friend class SamplerCache;
+	friend class GpuCulling;
+	friend class RenderGraph;
 private:
 	static void CreateInstance();
 	static bool CheckValidationLayerSupport();
@@ -31,6 +50,7 @@ private:
 	static void CreateSurface();
 
 	static bool CheckDeviceExtensionSupport(vk::PhysicalDevice device);
+	static bool SupportsDeviceExtension(vk::PhysicalDevice device, const char* extensionName);
 	static void PickPhysicalDevice();
 	static bool IsPhysicalDeviceSuitable(vk::PhysicalDevice device);
 
@@ -58,25 +78,30 @@ private:
 	static void CreateLogicalDevice();
 
 	static void CreateVMAAllocator();
+	//summed over the device local heaps, from VK_EXT_memory_budget when the device has it
+	static void GetDeviceLocalBudget(uint64_t& budget, uint64_t& usage);
 
 	static void CreateSwapChain();
-	static void CreateImageViews();
 	static void RecreateSwapChain();
 	static void CleanupSwapChain();
 
 	static void CreateDescriptorSetLayout();
+	//with _depthPrepass the render passes get a depth only subpass ahead of the color one
 	static void CreateRenderPass();
+	//the color pipeline, and the depth only one for the prepass when there is one
 	static void CreateGraphicsPipeline();
-	static void CompileShaders();
-	static vk::ShaderModule CreateShaderModule(std::vector<char>& code);
+	//the pipelines, their layout and the render passes, everything CreateRenderPass and CreateGraphicsPipeline make
+	static void DestroyScenePipelines();
+	static vk::ShaderModule CreateShaderModule(std::span<const char> code);
 
 	static void CreateFramebuffers();
 	static void FramebufferResizeCallback(GLFWwindow* window, int width, int height);
 
-	static void LoadModel();
 	static void CreateUniformBuffers();
 	static void CreateDescriptorPool();
 	static void CreateDescriptorSets();
+	//points the frame's set at whatever texture the AssetDB hands out right now
+	static void UpdateTextureDescriptor(uint32_t frame);
 	static void CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, 
 		vk::MemoryPropertyFlags properties, vk::Buffer& buffer, 
 		VmaAllocation& bufferMemory, uint32_t memoryTypeBits = 0);
@@ -86,6 +111,11 @@ private:
 	static void CreateCommandPool();
 	static void CreateCommandBuffers();
 	static void RecordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
+	//begins renderPass on the scene framebuffer, the render area, viewport and scissor cover _renderExtent
+	static void BeginScenePass(vk::CommandBuffer commandBuffer, vk::RenderPass renderPass);
+	//binds the pipeline, the frame's descriptors, the model's buffers and the instance stream, for draws that don't go through _drawList
+	//depthPrepass binds the depth only pipeline and the model's position stream instead
+	static void BindScene(vk::CommandBuffer commandBuffer, const Model& model, vk::Buffer instanceBuffer, bool depthPrepass = false);
 	static vk::CommandBuffer BeginSingleTimeCommands();
 	static void EndSingleTimeCommands(vk::CommandBuffer commandBuffer);
 
@@ -93,24 +123,97 @@ private:
 	static vk::Format FindSupportedFormat(const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features);
 	static vk::Format FindDepthFormat();
 	static bool HasStencilComponent(vk::Format format);
+	//depth and stencil for depth formats, color for everything else
+	static vk::ImageAspectFlags GetImageAspect(vk::Format format);
 
-	static void CreateTextureImage();
+	//transient attachments get lazily allocated memory when the device has it, properties are required of the memory otherwise
 	static void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits samples,
 		vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage,
 		vk::MemoryPropertyFlags properties, vk::Image& image, VmaAllocation& imageMemory);
+	//barrier stages and access masks come from what each layout is typically used for, see RenderGraph::GetLayoutInfo
 	static void TransitionImageLayout(vk::Image image, vk::Format format, uint32_t mipLevels, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
-	static void CopyBufferToImage(vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height);
-	static vk::ImageView CreateImageView(vk::Image image, vk::Format format, uint32_t mipLevels, vk::ImageAspectFlags aspectFlags);
-	static void CreateTextureSampler();
-	static void GenerateMipmaps(vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	static void TransitionImageLayout(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format format, uint32_t mipLevels, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+		uint32_t baseMipLevel = 0);
+	static void CopyBufferToImage(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height);
+	//one region per mip, mipOffsets[i] is where mip baseMipLevel + i starts in buffer and width and height are mip 0's
+	static void CopyBufferToImageMips(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height,
+		const std::vector<vk::DeviceSize>& mipOffsets, uint32_t baseMipLevel = 0);
+	//copies mipLevels mips starting at srcBaseMip into the top mips of dstImage, width and height are dstImage's
+	static void CopyImageMips(vk::CommandBuffer commandBuffer, vk::Image srcImage, uint32_t srcBaseMip, vk::Image dstImage,
+		uint32_t width, uint32_t height, uint32_t mipLevels);
+	static vk::ImageView CreateImageView(vk::Image image, vk::Format format, uint32_t mipLevels, vk::ImageAspectFlags aspectFlags, uint32_t baseMipLevel = 0);
+	static void GenerateMipmaps(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 
 	static void CreateSyncObjects();
 
-	static vk::SampleCountFlagBits GetMaxUsableSampleCount();
+	//anti aliasing quality, the sample count and whether the fragment shader runs for every sample instead of once per pixel
+	enum QualityTier
+	{
+		QUALITY_MSAA_OFF,
+		QUALITY_MSAA_2X,
+		QUALITY_MSAA_2X_SAMPLE_SHADING,
+		QUALITY_MSAA_4X,
+		QUALITY_MSAA_4X_SAMPLE_SHADING,
+		QUALITY_MSAA_8X,
+		QUALITY_MSAA_8X_SAMPLE_SHADING,
+		QUALITY_COUNT
+	};
+
+	struct QualitySettings
+	{
+		vk::SampleCountFlagBits samples;
+		bool sampleShading;
+		const char* name;
+	};
+
+	static QualitySettings GetQualitySettings(QualityTier tier);
+	//sample counts the color and depth attachments and the depth pyramid's sampling of depth all support
+	static vk::SampleCountFlags GetUsableSampleCounts();
+	static bool SupportsQuality(QualityTier tier);
+	//waits for the GPU and rebuilds the render passes, pipeline, attachments and framebuffers for the tier
+	static void SetQuality(QualityTier tier);
+	//waits for the GPU and rebuilds the render passes, pipelines and framebuffer with or without the depth prepass
+	//it's per scene, it only pays off when there's enough overdraw for the shading it saves to beat drawing everything twice
+	static void SetDepthPrepass(bool enabled);
+	//waits for the GPU and rebuilds the same as SetQuality, since the attachments depend on how culling is done
+	static void SetGpuCulling(bool enabled);
+	//render passes, pipelines, attachments, depth pyramid and framebuffers for the current settings, after they were destroyed
+	static void CreateSceneTargets();
+	//M steps through the quality tiers the device supports, R toggles dynamic resolution, P the depth prepass, C GPU culling
+	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	//the scene's attachments and framebuffers, and the depth pyramid built from them
+	static void DestroyAttachments();
+	//two timestamps per frame in flight around its command buffer, when the graphics queue can write them
+	static void CreateFrameTimestamps();
+	//the frame's GPU time into _gpuFrameMs, its fence has to have been waited on. False when it wrote no timestamps
+	static bool ReadFrameTimestamps(uint32_t frame);
+	//whether the scene's color and depth buffers are only used inside the render pass that clears them, so they
+	//don't need storing and can be transient attachments
+	static bool AttachmentsStayInRenderPass();
+	//the scene color image the frame resolves into and, with MSAA, the multisampled color buffer
 	static void CreateColorResources();
 
+	//the scene renders into the top left scale * the swap chain extent of its attachments, which keep the swap chain's size
+	//so changing the scale never waits for the GPU or recreates anything
+	static void SetRenderScale(float scale);
+	//every RENDER_SCALE_INTERVAL measured frames, moves the render scale so the GPU frame time stays under _targetFrameMs
+	static void UpdateRenderScale();
+
 	static void DrawFrame();
+	//destroy runs once every frame that could have been using the resources has finished
+	static void DeferDestroy(std::function<void()> destroy);
+	static void RunDeferredDestroys(bool all);
 	static void UpdateUniformBuffer(uint32_t currentImage);
+	//replaces the drawn instances of the model, transforms are relative to _model
+	static void SetInstances(std::span<const Model::Instance> instances);
+	//room for count instances in the frame's instance stream, grows it (through DeferDestroy) when it's too small
+	static Model::Instance* MapInstanceStream(uint32_t frame, uint32_t count);
+	//CPU side of culling and LOD selection, streams through the entity chunks in parallel and fills the frame's
+	//instance stream with the visible instances sorted by LOD, lodCounts gets how many each LOD has
+	static void CullInstances(const Model& model, std::array<uint32_t, Model::MAX_LODS>& lodCounts);
+	static float PixelsPerUnit(const glm::vec3& center, float radius, const glm::mat4& model);
+	//puts the occlusion culling stats in the title, a couple of times a second so it stays readable
+	static void UpdateWindowTitle();
 
 	//glfw
 	inline static GLFWwindow* _window = nullptr;
@@ -128,23 +231,36 @@ private:
 	inline static vk::Queue _graphicsQueue{};
 	inline static vk::Queue _presentQueue{};
 	const static std::vector<const char*> _deviceExtensions;
+	inline static bool _memoryBudgetSupported = false;
+	//VK_KHR_draw_indirect_count, without it every indirect slot gets drawn and unused ones are empty draws
+	inline static bool _drawIndirectCountSupported = false;
+	//a memory type that only gets backed when a transient attachment actually needs it, which tilers have
+	inline static bool _lazilyAllocatedSupported = false;
 
 	inline static vk::SwapchainKHR _swapChain{};
 	inline static std::vector<vk::Image> _swapChainImages;
 	inline static vk::Format _swapChainImageFormat{};
 	inline static vk::Extent2D _swapChainExtent{};
-	inline static std::vector<vk::ImageView> _swapChainImageViews;
 
 	inline static vk::SurfaceKHR _surface{};
 
 	inline static vk::RenderPass _renderPass;
+	//loads what _renderPass stored, for the draws the second occlusion culling pass adds
+	inline static vk::RenderPass _loadRenderPass;
 	inline static vk::DescriptorSetLayout _descriptorSetLayout;
 	inline static vk::DescriptorPool _descriptorPool;
 	inline static std::vector<vk::DescriptorSet> _descriptorSets;
 	inline static vk::PipelineLayout _pipelineLayout;
 	inline static vk::Pipeline _graphicsPipeline;
+	//depth only, no fragment shader, for subpass 0 when there's a depth prepass, _graphicsPipeline then tests for equal
+	//depth without writing it so only the closest fragment of every pixel gets shaded
+	inline static vk::Pipeline _depthPipeline;
+	inline static bool _depthPrepass = false;
+	//what Init starts the scene with, one room has too little overdraw for the prepass to pay for drawing it twice
+	constexpr static bool SCENE_DEPTH_PREPASS = false;
 
-	inline static std::vector<vk::Framebuffer> _swapChainFramebuffers;
+	//the swap chain images are only ever blitted to, so every frame renders into the same attachments
+	inline static vk::Framebuffer _sceneFramebuffer;
 
 	inline static std::vector<vk::Buffer> _uniformBuffers;
 	inline static std::vector<VmaAllocation> _uniformBuffersMemory;
@@ -153,13 +269,30 @@ private:
 	inline static vk::CommandPool _commandPool;
 	inline static std::vector<vk::CommandBuffer> _commandBuffers;
 
-	inline static vk::Buffer _stagingBuffer;
-	inline static VmaAllocation _stagingBufferMemory;
-	inline static uint32_t _mipLevels;
-	static Texture *_texture;
-	inline static vk::Sampler _defaultTextureSampler;
+	inline static AssetHandle<Texture> _texture;
+
+	inline static AssetHandle<Model> _modelAsset;
+	//false culls on the CPU and records one instanced draw per LOD, for comparing against GpuCulling, see SetGpuCulling
+	inline static bool _gpuCulling = true;
+	//one entity per instance, see Scene/Components.h
+	inline static EntityManager _entities;
+	//per chunk of the CullInstances query: visible rows, and how many of them and where they go in the stream per LOD
+	inline static std::vector<std::vector<uint32_t>> _chunkVisibleRows;
+	inline static std::vector<std::array<uint32_t, Model::MAX_LODS>> _chunkLodCounts;
+	inline static std::vector<std::array<uint32_t, Model::MAX_LODS>> _chunkLodOffsets;
+
+	//the pass field of _drawList's keys
+	enum DrawPass
+	{
+		DRAW_PASS_DEPTH_PREPASS,
+		DRAW_PASS_OPAQUE,
+		DRAW_PASS_COUNT
+	};
 
-	static Model *_modelAsset;
+	//the CPU path's draws, rebuilt every frame
+	inline static DrawList _drawList;
+	//the frame's passes, rebuilt every frame by RecordCommandBuffer
+	inline static RenderGraph _renderGraph;
 
 	inline static vk::Image _depthImage;
 	inline static VmaAllocation _depthImageMemory;
@@ -170,14 +303,64 @@ private:
 	inline static std::vector<vk::Fence> _inFlightFences;
 	constexpr static int MAX_FRAMES_IN_FLIGHT = 2;
 	inline static uint32_t currentFrame = 0;
+	//frames submitted so far
+	inline static uint64_t _frameNumber = 0;
+	inline static std::deque<std::pair<uint64_t, std::function<void()>>> _deferredDestroys;
+	inline static std::array<vk::ImageView, MAX_FRAMES_IN_FLIGHT> _boundTextureViews{};
+	inline static std::array<vk::Sampler, MAX_FRAMES_IN_FLIGHT> _boundTextureSamplers{};
+	//the CPU path's visible instances, sorted by LOD so each LOD's are contiguous, host visible and rewritten every frame
+	inline static std::array<vk::Buffer, MAX_FRAMES_IN_FLIGHT> _instanceStreams{};
+	inline static std::array<VmaAllocation, MAX_FRAMES_IN_FLIGHT> _instanceStreamsMemory{};
+	inline static std::array<void*, MAX_FRAMES_IN_FLIGHT> _instanceStreamsMapped{};
+	inline static std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> _instanceStreamCapacities{};
+
+	inline static vk::QueryPool _frameTimestamps;
+	inline static std::array<bool, MAX_FRAMES_IN_FLIGHT> _frameTimestampsWritten{};
+	//nanoseconds per timestamp tick
+	inline static double _timestampPeriod = 0.0;
+	//GPU time of the last frame whose fence was waited on, 0 without timestamps
+	inline static double _gpuFrameMs = 0.0;
 
 	inline static bool _framebufferResized = false;
+	inline static std::chrono::steady_clock::time_point _lastTitleUpdate{};
 
+	inline static QualityTier _quality = QUALITY_MSAA_4X;
+	//VkPhysicalDeviceFeatures::sampleRateShading, the sample shading tiers need it
+	inline static bool _sampleShadingSupported = false;
+	//of _quality, e1 renders straight into _sceneColorImage without _colorImage
 	inline static vk::SampleCountFlagBits _msaaSamples = vk::SampleCountFlagBits::e1;
 	inline static vk::Image _colorImage;
 	inline static VmaAllocation _colorImageMemory;
 	inline static vk::ImageView _colorImageView;
-
+	//swap chain sized, the scene is resolved into its top left _renderExtent and stretched over the swap chain image from there
+	inline static vk::Image _sceneColorImage;
+	inline static VmaAllocation _sceneColorImageMemory;
+	inline static vk::ImageView _sceneColorImageView;
+	//linear where the swap chain format can be blitted with it
+	inline static vk::Filter _upscaleFilter = vk::Filter::eLinear;
+
+	//R turns the render scale controller on and off, off goes back to full resolution
+	inline static bool _dynamicResolution = true;
+	inline static double _targetFrameMs = 1000.0 / 60.0;
+	inline static float _renderScale = 1.0f;
+	inline static vk::Extent2D _renderExtent{};
+	//measured frames since the controller last looked, only ones recorded at the current scale count
+	inline static double _renderScaleFrameMs = 0.0;
+	inline static uint32_t _renderScaleFrames = 0;
+	//_frameNumber of the first frame recorded at the current scale
+	inline static uint64_t _renderScaleChangedFrame = 0;
+	constexpr static uint32_t RENDER_SCALE_INTERVAL = 8;
+	constexpr static float MIN_RENDER_SCALE = 0.5f;
+	//per controller update, bigger jumps overshoot since not all of the frame's cost follows the pixel count
+	constexpr static float MAX_RENDER_SCALE_STEP = 0.1f;
+	//the scale only goes back up once frames take less than this much of the target, and moves to aim at RENDER_SCALE_HEADROOM
+	//of it, so it doesn't flip back and forth around the target
+	constexpr static double RENDER_SCALE_RAISE_BELOW = 0.8;
+	constexpr static double RENDER_SCALE_HEADROOM = 0.9;
+
+	//_model is the world matrix of _modelNode, as of the last _scene.Update
+	inline static TransformHierarchy _scene;
+	inline static uint32_t _modelNode = TransformHierarchy::INVALID_NODE;
 	static glm::mat4 _model;
 	static glm::mat4 _view;
 	static glm::mat4 _proj;
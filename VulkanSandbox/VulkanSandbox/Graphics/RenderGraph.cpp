@@ -0,0 +1,712 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "Graphics.h"
+#include "../Utils/CLogger.h"
+
+using namespace std;
+
+//the access flags that need making available, reads only ever need an execution dependency
+static const vk::AccessFlags WRITE_ACCESS = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite
+    | vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eHostWrite
+    | vk::AccessFlagBits::eMemoryWrite;
+
+constexpr uint32_t INVALID_PASS = ~0u;
+
+RenderGraph::AccessInfo RenderGraph::GetAccessInfo(Access access, vk::ImageAspectFlags aspect)
+{
+    using Stage = vk::PipelineStageFlagBits;
+    using Flag = vk::AccessFlagBits;
+    using Layout = vk::ImageLayout;
+
+    const bool depth = static_cast<bool>(aspect & vk::ImageAspectFlagBits::eDepth);
+    const Layout sampledLayout = depth ? Layout::eDepthStencilReadOnlyOptimal : Layout::eShaderReadOnlyOptimal;
+
+    switch (access)
+    {
+    case ACCESS_NONE:
+        return { Stage::eTopOfPipe, {}, Layout::eUndefined };
+    case ACCESS_INDIRECT_READ:
+        return { Stage::eDrawIndirect, Flag::eIndirectCommandRead, Layout::eUndefined };
+    case ACCESS_VERTEX_READ:
+        return { Stage::eVertexInput, Flag::eVertexAttributeRead | Flag::eIndexRead, Layout::eUndefined };
+    case ACCESS_COMPUTE_READ:
+        return { Stage::eComputeShader, Flag::eShaderRead, Layout::eGeneral };
+    case ACCESS_COMPUTE_WRITE:
+        return { Stage::eComputeShader, Flag::eShaderRead | Flag::eShaderWrite, Layout::eGeneral };
+    case ACCESS_COMPUTE_SAMPLED:
+        return { Stage::eComputeShader, Flag::eShaderRead, sampledLayout };
+    case ACCESS_FRAGMENT_SAMPLED:
+        return { Stage::eFragmentShader, Flag::eShaderRead, sampledLayout };
+    case ACCESS_COLOR_ATTACHMENT:
+        return { Stage::eColorAttachmentOutput, Flag::eColorAttachmentRead | Flag::eColorAttachmentWrite, Layout::eColorAttachmentOptimal };
+    case ACCESS_DEPTH_ATTACHMENT:
+        return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Flag::eDepthStencilAttachmentRead | Flag::eDepthStencilAttachmentWrite,
+            Layout::eDepthStencilAttachmentOptimal };
+    case ACCESS_DEPTH_READ:
+        return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Flag::eDepthStencilAttachmentRead, Layout::eDepthStencilReadOnlyOptimal };
+    case ACCESS_TRANSFER_READ:
+        return { Stage::eTransfer, Flag::eTransferRead, Layout::eTransferSrcOptimal };
+    case ACCESS_TRANSFER_WRITE:
+        return { Stage::eTransfer, Flag::eTransferWrite, Layout::eTransferDstOptimal };
+    case ACCESS_HOST_READ:
+        return { Stage::eHost, Flag::eHostRead, Layout::eGeneral };
+    case ACCESS_PRESENT:
+        //the stage the acquire semaphore is waited on, so leaving present chains onto the wait
+        return { Stage::eTransfer, {}, Layout::ePresentSrcKHR };
+    default:
+        Assert(false, "Unknown render graph access!", { {"Access", static_cast<uint32_t>(access)} });
+
+        return {};
+    }
+}
+
+RenderGraph::AccessInfo RenderGraph::GetLayoutInfo(vk::ImageLayout layout)
+{
+    using Stage = vk::PipelineStageFlagBits;
+    using Flag = vk::AccessFlagBits;
+
+    switch (layout)
+    {
+    case vk::ImageLayout::eUndefined:
+        return GetAccessInfo(ACCESS_NONE);
+    case vk::ImageLayout::eGeneral:
+        return GetAccessInfo(ACCESS_COMPUTE_WRITE);
+    case vk::ImageLayout::eColorAttachmentOptimal:
+        return GetAccessInfo(ACCESS_COLOR_ATTACHMENT);
+    case vk::ImageLayout::eDepthStencilAttachmentOptimal:
+        return GetAccessInfo(ACCESS_DEPTH_ATTACHMENT);
+    case vk::ImageLayout::eDepthStencilReadOnlyOptimal:
+        return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests | Stage::eFragmentShader | Stage::eComputeShader,
+            Flag::eDepthStencilAttachmentRead | Flag::eShaderRead, layout };
+    case vk::ImageLayout::eShaderReadOnlyOptimal:
+        return { Stage::eFragmentShader | Stage::eComputeShader, Flag::eShaderRead, layout };
+    case vk::ImageLayout::eTransferSrcOptimal:
+        return GetAccessInfo(ACCESS_TRANSFER_READ);
+    case vk::ImageLayout::eTransferDstOptimal:
+        return GetAccessInfo(ACCESS_TRANSFER_WRITE);
+    case vk::ImageLayout::ePresentSrcKHR:
+        return GetAccessInfo(ACCESS_PRESENT);
+    default:
+        Assert(false, "Unsupported layout!", { {"Layout", static_cast<uint32_t>(layout)} });
+
+        return {};
+    }
+}
+
+void RenderGraph::RecordTransition(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageAspectFlags aspect, uint32_t baseMipLevel,
+    uint32_t mipLevels, const AccessInfo& from, const AccessInfo& to)
+{
+    vk::ImageMemoryBarrier barrier{};
+    barrier.oldLayout = from.layout;
+    barrier.newLayout = to.layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { aspect, baseMipLevel, mipLevels, 0, 1 };
+    barrier.srcAccessMask = from.access & WRITE_ACCESS;
+    barrier.dstAccessMask = to.access;
+
+    commandBuffer.pipelineBarrier(from.stages, to.stages, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+uint32_t RenderGraph::ImportImage(string_view name, vk::Image image, vk::ImageAspectFlags aspect, uint32_t mipLevels, Access current)
+{
+    Resource& resource = _resources.emplace_back();
+    resource.name = name;
+    resource.image = image;
+    resource.aspect = aspect;
+    resource.mipLevels = mipLevels;
+    resource.current = current;
+
+    return static_cast<uint32_t>(_resources.size() - 1);
+}
+
+uint32_t RenderGraph::ImportBuffer(string_view name, vk::Buffer buffer, Access current)
+{
+    Resource& resource = _resources.emplace_back();
+    resource.name = name;
+    resource.buffer = buffer;
+    resource.current = current;
+
+    return static_cast<uint32_t>(_resources.size() - 1);
+}
+
+void RenderGraph::Export(uint32_t resource, Access final)
+{
+    Assert(!_resources[resource].transient, "Transient images end with the graph, they can't be exported!", { {"Image", _resources[resource].name} });
+
+    _resources[resource].exported = true;
+    _resources[resource].final = final;
+}
+
+uint32_t RenderGraph::CreateImage(string_view name, const ImageDesc& desc)
+{
+    Resource& resource = _resources.emplace_back();
+    resource.name = name;
+    resource.aspect = desc.aspect;
+    resource.mipLevels = desc.mipLevels;
+    resource.transient = true;
+    resource.desc = desc;
+
+    return static_cast<uint32_t>(_resources.size() - 1);
+}
+
+vk::Image RenderGraph::GetImage(uint32_t resource) const
+{
+    const Resource& image = _resources[resource];
+    Assert(!image.transient || image.physical != INVALID_INDEX, "Transient image has no memory outside its passes!", { {"Image", image.name} });
+
+    return image.image;
+}
+
+vk::ImageView RenderGraph::GetImageView(uint32_t resource) const
+{
+    const Resource& image = _resources[resource];
+    Assert(image.transient && image.physical != INVALID_INDEX, "Only transient images inside their passes have views!", { {"Image", image.name} });
+
+    return _physicalImages[image.physical].view;
+}
+
+void RenderGraph::DestroyTransients()
+{
+    if (!_physicalImages.empty())
+    {
+        Graphics::DeferDestroy([images = _physicalImages, blocks = _memoryBlocks]()
+            {
+                for (const PhysicalImage& physical : images)
+                {
+                    Graphics::_device.destroyImageView(physical.view, nullptr);
+                    Graphics::_device.destroyImage(physical.image, nullptr);
+                }
+
+                for (const MemoryBlock& block : blocks)
+                {
+                    vmaFreeMemory(Graphics::_allocator, block.allocation);
+                }
+            });
+    }
+
+    _transientKeys.clear();
+    _physicalImages.clear();
+    _memoryBlocks.clear();
+    _physicalSizes.clear();
+}
+
+uint32_t RenderGraph::AddPass(string_view name, function<void(vk::CommandBuffer)> record)
+{
+    Pass& pass = _passes.emplace_back();
+    pass.name = name;
+    pass.record = move(record);
+
+    return static_cast<uint32_t>(_passes.size() - 1);
+}
+
+void RenderGraph::Read(uint32_t pass, uint32_t resource, Access access)
+{
+    _passes[pass].uses.push_back({ resource, access, false, false });
+}
+
+void RenderGraph::Write(uint32_t pass, uint32_t resource, Access access, bool discard)
+{
+    _passes[pass].uses.push_back({ resource, access, true, discard });
+}
+
+void RenderGraph::SetSideEffects(uint32_t pass)
+{
+    _passes[pass].sideEffects = true;
+}
+
+void RenderGraph::Reset()
+{
+    _resources.clear();
+    _passes.clear();
+    _order.clear();
+    _states.clear();
+}
+
+vector<string_view> RenderGraph::GetPassOrder() const
+{
+    vector<string_view> names;
+
+    for (uint32_t pass : _order)
+    {
+        names.push_back(_passes[pass].name);
+    }
+
+    return names;
+}
+
+void RenderGraph::Cull()
+{
+    //walking backwards, a resource is needed while a later live pass still reads what's in it
+    vector<bool> needed(_resources.size());
+
+    for (uint32_t i = 0; i < _resources.size(); i++)
+    {
+        needed[i] = _resources[i].exported;
+    }
+
+    for (uint32_t i = static_cast<uint32_t>(_passes.size()); i-- > 0;)
+    {
+        Pass& pass = _passes[i];
+        pass.culled = !pass.sideEffects && none_of(pass.uses.begin(), pass.uses.end(), [&](const Use& use) { return use.write && needed[use.resource]; });
+
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        //whatever was in a discarded resource before this pass is never seen
+        for (const Use& use : pass.uses)
+        {
+            if (use.discard)
+            {
+                needed[use.resource] = false;
+            }
+        }
+
+        for (const Use& use : pass.uses)
+        {
+            if (!use.discard)
+            {
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::BuildDependencies()
+{
+    vector<uint32_t> lastWriters(_resources.size(), INVALID_PASS);
+    vector<vector<uint32_t>> readers(_resources.size());
+
+    for (uint32_t i = 0; i < _passes.size(); i++)
+    {
+        Pass& pass = _passes[i];
+        pass.dependencies.clear();
+
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        for (const Use& use : pass.uses)
+        {
+            if (lastWriters[use.resource] != INVALID_PASS)
+            {
+                pass.dependencies.push_back(lastWriters[use.resource]);
+            }
+
+            //a write also has to wait for everything reading the old contents
+            if (use.write)
+            {
+                pass.dependencies.insert(pass.dependencies.end(), readers[use.resource].begin(), readers[use.resource].end());
+                lastWriters[use.resource] = i;
+                readers[use.resource].clear();
+            }
+            else
+            {
+                readers[use.resource].push_back(i);
+            }
+        }
+
+        erase(pass.dependencies, i);
+        sort(pass.dependencies.begin(), pass.dependencies.end());
+        pass.dependencies.erase(unique(pass.dependencies.begin(), pass.dependencies.end()), pass.dependencies.end());
+    }
+}
+
+void RenderGraph::Schedule()
+{
+    //of every pass already scheduled, where it went
+    vector<uint32_t> positions(_passes.size(), INVALID_PASS);
+    uint32_t liveCount = 0;
+
+    for (const Pass& pass : _passes)
+    {
+        liveCount += !pass.culled;
+    }
+
+    _order.clear();
+
+    while (_order.size() < liveCount)
+    {
+        uint32_t best = INVALID_PASS;
+        //one past the position of the latest dependency, 0 without any
+        uint32_t bestLatest = 0;
+
+        //of the passes whose dependencies have all run, the one that has waited on them longest goes next
+        //so a pass's consumers drift away from it and independent work fills the gap the barrier leaves
+        for (uint32_t i = 0; i < _passes.size(); i++)
+        {
+            const Pass& pass = _passes[i];
+
+            if (pass.culled || positions[i] != INVALID_PASS)
+            {
+                continue;
+            }
+
+            uint32_t latest = 0;
+            bool ready = true;
+
+            for (uint32_t dependency : pass.dependencies)
+            {
+                ready &= positions[dependency] != INVALID_PASS;
+                latest = ready ? std::max(latest, positions[dependency] + 1) : latest;
+            }
+
+            if (ready && (best == INVALID_PASS || latest < bestLatest))
+            {
+                best = i;
+                bestLatest = latest;
+            }
+        }
+
+        Assert(best != INVALID_PASS, "Render graph has a dependency cycle!", { {"Scheduled", _order.size()}, {"Passes", liveCount} });
+
+        positions[best] = static_cast<uint32_t>(_order.size());
+        _order.push_back(best);
+    }
+}
+
+void RenderGraph::PlaceTransients()
+{
+    //first and last position in _order of the passes using each transient
+    vector<uint32_t> first(_resources.size(), INVALID_INDEX);
+    vector<uint32_t> last(_resources.size(), INVALID_INDEX);
+    vector<bool> attachmentOnly(_resources.size(), true);
+
+    for (uint32_t position = 0; position < _order.size(); position++)
+    {
+        for (const Use& use : _passes[_order[position]].uses)
+        {
+            if (_resources[use.resource].transient)
+            {
+                first[use.resource] = std::min(first[use.resource], position);
+                last[use.resource] = position;
+                attachmentOnly[use.resource] = attachmentOnly[use.resource] && (use.access == ACCESS_COLOR_ATTACHMENT
+                    || use.access == ACCESS_DEPTH_ATTACHMENT || use.access == ACCESS_DEPTH_READ);
+            }
+        }
+    }
+
+    //the only usages a transient attachment image may have
+    const vk::ImageUsageFlags attachmentUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment
+        | vk::ImageUsageFlagBits::eInputAttachment;
+    vector<TransientKey> keys;
+
+    for (uint32_t i = 0; i < _resources.size(); i++)
+    {
+        Resource& resource = _resources[i];
+
+        if (!resource.transient || first[i] == INVALID_INDEX)
+        {
+            continue;
+        }
+
+        //nothing outside its one pass ever sees it, so on tilers it never has to leave tile memory
+        const bool lazy = Graphics::_lazilyAllocatedSupported && first[i] == last[i] && attachmentOnly[i] && !(resource.desc.usage & ~attachmentUsage);
+
+        resource.physical = static_cast<uint32_t>(keys.size());
+        keys.push_back({ resource.desc, first[i], last[i], lazy });
+    }
+
+    if (keys != _transientKeys)
+    {
+        CreatePhysicalImages(keys);
+    }
+
+    for (Resource& resource : _resources)
+    {
+        if (resource.physical != INVALID_INDEX)
+        {
+            resource.image = _physicalImages[resource.physical].image;
+        }
+    }
+
+    for (vk::DeviceSize size : _physicalSizes)
+    {
+        _stats.transientBytes += size;
+    }
+
+    for (const MemoryBlock& block : _memoryBlocks)
+    {
+        (block.lazy ? _stats.lazyBytes : _stats.aliasedBytes) += block.size;
+    }
+}
+
+void RenderGraph::CreatePhysicalImages(const vector<TransientKey>& keys)
+{
+    //the frames in flight might still be using the old ones
+    DestroyTransients();
+    _transientKeys = keys;
+
+    vector<vk::MemoryRequirements> requirements(keys.size());
+
+    for (uint32_t i = 0; i < keys.size(); i++)
+    {
+        const ImageDesc& desc = keys[i].desc;
+
+        vk::ImageCreateInfo imageInfo{};
+        imageInfo.imageType = vk::ImageType::e2D;
+        imageInfo.extent = vk::Extent3D{ desc.extent.width, desc.extent.height, 1 };
+        imageInfo.mipLevels = desc.mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = desc.format;
+        imageInfo.tiling = vk::ImageTiling::eOptimal;
+        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+        imageInfo.usage = keys[i].lazy ? desc.usage | vk::ImageUsageFlagBits::eTransientAttachment : desc.usage;
+        imageInfo.sharingMode = vk::SharingMode::eExclusive;
+        imageInfo.samples = desc.samples;
+
+        PhysicalImage& physical = _physicalImages.emplace_back();
+        vk::Result result = Graphics::_device.createImage(&imageInfo, nullptr, &physical.image);
+        Assert(result == vk::Result::eSuccess, "Failed to create transient image!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+        Graphics::_device.getImageMemoryRequirements(physical.image, &requirements[i]);
+        _physicalSizes.push_back(requirements[i].size);
+    }
+
+    struct BlockPlan
+    {
+        //what every image in it needs, merged
+        vk::MemoryRequirements requirements;
+        vector<uint32_t> images;
+        bool lazy;
+    };
+
+    //biggest first, each into the first block holding nothing alive at the same time as it, so the big ones set
+    //the block sizes and the smaller ones fit in around them
+    vector<uint32_t> bySize(keys.size());
+    iota(bySize.begin(), bySize.end(), 0);
+    stable_sort(bySize.begin(), bySize.end(), [&](uint32_t a, uint32_t b) { return requirements[a].size > requirements[b].size; });
+
+    vector<BlockPlan> plans;
+
+    for (uint32_t image : bySize)
+    {
+        const TransientKey& key = keys[image];
+        BlockPlan* target = nullptr;
+
+        //sharing lazily allocated memory would only get it backed
+        for (BlockPlan& plan : plans)
+        {
+            if (key.lazy || plan.lazy || !(plan.requirements.memoryTypeBits & requirements[image].memoryTypeBits))
+            {
+                continue;
+            }
+
+            const bool overlaps = any_of(plan.images.begin(), plan.images.end(),
+                [&](uint32_t other) { return keys[other].first <= key.last && key.first <= keys[other].last; });
+
+            if (!overlaps)
+            {
+                target = &plan;
+                break;
+            }
+        }
+
+        if (!target)
+        {
+            target = &plans.emplace_back(BlockPlan{ requirements[image], {}, key.lazy });
+        }
+
+        //every image in a block starts at its beginning
+        target->requirements.size = std::max(target->requirements.size, requirements[image].size);
+        target->requirements.alignment = std::max(target->requirements.alignment, requirements[image].alignment);
+        target->requirements.memoryTypeBits &= requirements[image].memoryTypeBits;
+        target->images.push_back(image);
+    }
+
+    for (const BlockPlan& plan : plans)
+    {
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.requiredFlags = plan.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+        MemoryBlock& block = _memoryBlocks.emplace_back();
+        block.size = plan.requirements.size;
+        block.lazy = plan.lazy;
+
+        VkResult result = vmaAllocateMemory(Graphics::_allocator, reinterpret_cast<const VkMemoryRequirements*>(&plan.requirements), &allocInfo,
+            &block.allocation, nullptr);
+        Assert(result == VK_SUCCESS, "Failed to allocate transient image memory!", { {"Error Code", static_cast<int32_t>(result)}, {"Size", block.size} });
+
+        for (uint32_t image : plan.images)
+        {
+            PhysicalImage& physical = _physicalImages[image];
+            const ImageDesc& desc = keys[image].desc;
+
+            physical.block = static_cast<uint32_t>(_memoryBlocks.size() - 1);
+            result = vmaBindImageMemory(Graphics::_allocator, block.allocation, physical.image);
+            Assert(result == VK_SUCCESS, "Failed to bind transient image memory!", { {"Error Code", static_cast<int32_t>(result)} });
+
+            physical.view = Graphics::CreateImageView(physical.image, desc.format, desc.mipLevels, desc.aspect);
+        }
+    }
+}
+
+void RenderGraph::AddBarriers(const Use& use, BarrierBatch& batch)
+{
+    const Resource& resource = _resources[use.resource];
+    ResourceState& state = _states[use.resource];
+    const AccessInfo info = GetAccessInfo(use.access, resource.aspect);
+    //a discarded image goes through undefined even when the layout stays, which also covers images that were never initialized
+    const bool transition = resource.image && (info.layout != state.layout || use.discard);
+
+    if (!transition && !use.write)
+    {
+        //reads only wait for the last write, and only once per stage and access
+        if (state.writeStages && ((info.stages & ~state.visibleStages) || (info.access & ~state.visibleAccess)))
+        {
+            batch.srcStages |= state.writeStages;
+            batch.dstStages |= info.stages;
+            batch.memoryBarrier.srcAccessMask |= state.writeAccess;
+            batch.memoryBarrier.dstAccessMask |= info.access;
+            batch.needed = true;
+            state.visibleStages |= info.stages;
+            state.visibleAccess |= info.access;
+        }
+
+        state.readStages |= info.stages;
+
+        return;
+    }
+
+    const vk::PipelineStageFlags srcStages = state.writeStages | state.readStages;
+
+    if (transition)
+    {
+        vk::ImageMemoryBarrier barrier{};
+        barrier.oldLayout = use.discard ? vk::ImageLayout::eUndefined : state.layout;
+        barrier.newLayout = info.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.image;
+        barrier.subresourceRange = { resource.aspect, 0, resource.mipLevels, 0, 1 };
+        barrier.srcAccessMask = state.writeAccess;
+        barrier.dstAccessMask = info.access;
+        batch.imageBarriers.push_back(barrier);
+        batch.needed = true;
+    }
+    else if (srcStages)
+    {
+        batch.memoryBarrier.srcAccessMask |= state.writeAccess;
+        batch.memoryBarrier.dstAccessMask |= info.access;
+        batch.needed = true;
+    }
+
+    batch.srcStages |= srcStages;
+    batch.dstStages |= info.stages;
+
+    //a transition counts as a write, later accesses have to come after it too
+    state.writeStages = info.stages;
+    state.writeAccess = use.write ? info.access & WRITE_ACCESS : vk::AccessFlags{};
+    state.readStages = {};
+    //the barrier made the transition visible to this access, a write isn't visible to anything yet
+    state.visibleStages = use.write ? vk::PipelineStageFlags{} : info.stages;
+    state.visibleAccess = use.write ? vk::AccessFlags{} : info.access;
+    state.layout = resource.image ? info.layout : state.layout;
+}
+
+void RenderGraph::RecordBatch(vk::CommandBuffer commandBuffer, BarrierBatch& batch)
+{
+    if (!batch.needed)
+    {
+        return;
+    }
+
+    //nothing to wait for, only layouts from undefined
+    if (!batch.srcStages)
+    {
+        batch.srcStages = vk::PipelineStageFlagBits::eTopOfPipe;
+    }
+
+    const bool memory = batch.memoryBarrier.srcAccessMask || batch.memoryBarrier.dstAccessMask;
+
+    commandBuffer.pipelineBarrier(batch.srcStages, batch.dstStages, {}, memory ? 1 : 0, &batch.memoryBarrier, 0, nullptr,
+        static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+    _stats.barriers++;
+}
+
+void RenderGraph::Execute(vk::CommandBuffer commandBuffer)
+{
+    Cull();
+    BuildDependencies();
+    Schedule();
+
+    _stats = {};
+    _stats.passes = static_cast<uint32_t>(_order.size());
+    _stats.culledPasses = static_cast<uint32_t>(_passes.size() - _order.size());
+
+    PlaceTransients();
+    _states.assign(_resources.size(), {});
+    //transients that took over their memory this frame
+    vector<bool> started(_resources.size());
+
+    for (uint32_t i = 0; i < _resources.size(); i++)
+    {
+        //nothing to wait for
+        if (_resources[i].current == ACCESS_NONE)
+        {
+            continue;
+        }
+
+        const AccessInfo info = GetAccessInfo(_resources[i].current, _resources[i].aspect);
+        const bool write = static_cast<bool>(info.access & WRITE_ACCESS);
+
+        //the last user might still be at it, whether it wrote or read
+        _states[i].writeStages = write ? info.stages : vk::PipelineStageFlags{};
+        _states[i].writeAccess = info.access & WRITE_ACCESS;
+        _states[i].readStages = write ? vk::PipelineStageFlags{} : info.stages;
+        _states[i].layout = info.layout;
+    }
+
+    for (uint32_t passIndex : _order)
+    {
+        Pass& pass = _passes[passIndex];
+        BarrierBatch batch;
+
+        for (const Use& use : pass.uses)
+        {
+            const Resource& resource = _resources[use.resource];
+
+            if (!resource.transient)
+            {
+                AddBarriers(use, batch);
+                continue;
+            }
+
+            MemoryBlock& block = _memoryBlocks[_physicalImages[resource.physical].block];
+
+            //picks up after whatever used the memory last, in this frame or one still in flight, and hands it on after
+            if (!started[use.resource])
+            {
+                Assert(use.discard, "A transient image's first pass has to discard it!", { {"Image", resource.name}, {"Pass", pass.name} });
+
+                _states[use.resource] = block.state;
+                started[use.resource] = true;
+            }
+
+            AddBarriers(use, batch);
+            block.state = _states[use.resource];
+        }
+
+        RecordBatch(commandBuffer, batch);
+        pass.record(commandBuffer);
+    }
+
+    BarrierBatch finalBatch;
+
+    for (uint32_t i = 0; i < _resources.size(); i++)
+    {
+        if (_resources[i].exported && _resources[i].final != ACCESS_NONE)
+        {
+            AddBarriers({ i, _resources[i].final, false, false }, finalBatch);
+        }
+    }
+
+    RecordBatch(commandBuffer, finalBatch);
+}
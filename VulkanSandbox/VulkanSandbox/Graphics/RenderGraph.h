@@ -0,0 +1,224 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+//A frame's work as passes that declare how they use named images and buffers. Execute culls the passes nothing
+//needs, orders the rest so dependent passes sit as far apart as their dependencies allow, and records them with
+//every barrier and layout transition derived from the declarations, batched into one pipelineBarrier per pass
+//Passes that use vk::RenderPasses begin and end them in their record function, with attachment layouts that match
+//the access here on both ends, so the render pass itself never transitions anything
+class RenderGraph
+{
+public:
+	//how a pass touches a resource, every access implies its stages, access flags and for images the layout
+	enum Access
+	{
+		ACCESS_NONE,
+		ACCESS_INDIRECT_READ,
+		ACCESS_VERTEX_READ,
+		//storage buffers and images, and images sampled in the general layout
+		ACCESS_COMPUTE_READ,
+		ACCESS_COMPUTE_WRITE,
+		ACCESS_COMPUTE_SAMPLED,
+		ACCESS_FRAGMENT_SAMPLED,
+		ACCESS_COLOR_ATTACHMENT,
+		ACCESS_DEPTH_ATTACHMENT,
+		//depth tested but not written
+		ACCESS_DEPTH_READ,
+		ACCESS_TRANSFER_READ,
+		ACCESS_TRANSFER_WRITE,
+		ACCESS_HOST_READ,
+		ACCESS_PRESENT,
+		ACCESS_COUNT
+	};
+
+	struct AccessInfo
+	{
+		vk::PipelineStageFlags stages;
+		vk::AccessFlags access;
+		vk::ImageLayout layout;
+	};
+
+	//sampled depth images use the depth read only layout
+	static AccessInfo GetAccessInfo(Access access, vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor);
+	//what a layout is typically used for, for one off transitions outside a graph
+	static AccessInfo GetLayoutInfo(vk::ImageLayout layout);
+
+	//the barrier between two accesses to a whole image, for one off transitions outside a graph
+	static void RecordTransition(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageAspectFlags aspect, uint32_t baseMipLevel,
+		uint32_t mipLevels, const AccessInfo& from, const AccessInfo& to);
+
+	struct Stats
+	{
+		uint32_t passes = 0;
+		uint32_t culledPasses = 0;
+		uint32_t barriers = 0;
+		//what the live transients would take with memory of their own, and what they take sharing it
+		vk::DeviceSize transientBytes = 0;
+		vk::DeviceSize aliasedBytes = 0;
+		//of the transients in lazily allocated memory, which might never be backed at all, not part of aliasedBytes
+		vk::DeviceSize lazyBytes = 0;
+	};
+
+	struct ImageDesc
+	{
+		vk::Format format = vk::Format::eUndefined;
+		vk::Extent2D extent;
+		uint32_t mipLevels = 1;
+		vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+		vk::ImageUsageFlags usage;
+		//of the view GetImageView hands out too
+		vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+
+		bool operator==(const ImageDesc&) const = default;
+	};
+
+	//resources come from outside and keep living after the graph, current is how the last use left them
+	uint32_t ImportImage(std::string_view name, vk::Image image, vk::ImageAspectFlags aspect, uint32_t mipLevels, Access current);
+	uint32_t ImportBuffer(std::string_view name, vk::Buffer buffer, Access current);
+	//the resource's contents are needed after the graph, left in the final access. Passes that don't lead to an
+	//exported resource or a pass with side effects get culled
+	void Export(uint32_t resource, Access final);
+	//an image only the graph's passes use, alive from its first live pass to its last. It starts out undefined every
+	//frame, so its first pass has to discard it. Transients that are never alive at the same time share memory, and
+	//ones a single pass only uses as an attachment get lazily allocated memory where the device has it
+	uint32_t CreateImage(std::string_view name, const ImageDesc& desc);
+	//a transient's image and a view of all of it, only valid in the record functions of the Execute that placed it
+	vk::Image GetImage(uint32_t resource) const;
+	vk::ImageView GetImageView(uint32_t resource) const;
+	//the memory behind transients is kept from one Execute to the next while they stay the same, this frees it
+	//once the frames using it are done
+	void DestroyTransients();
+
+	uint32_t AddPass(std::string_view name, std::function<void(vk::CommandBuffer)> record);
+	void Read(uint32_t pass, uint32_t resource, Access access);
+	//discard means the pass overwrites all of it without reading, so what came before doesn't matter
+	void Write(uint32_t pass, uint32_t resource, Access access, bool discard = false);
+	//kept even when nothing reads what it writes, like copies the CPU reads back
+	void SetSideEffects(uint32_t pass);
+
+	//compiles and records, the graph stays as it is until Reset
+	void Execute(vk::CommandBuffer commandBuffer);
+	void Reset();
+
+	const Stats& GetStats() const { return _stats; }
+	//names of the passes in the order the last Execute recorded them
+	std::vector<std::string_view> GetPassOrder() const;
+
+private:
+	constexpr static uint32_t INVALID_INDEX = ~0u;
+
+	struct Resource
+	{
+		std::string name;
+		vk::Image image;
+		vk::Buffer buffer;
+		vk::ImageAspectFlags aspect;
+		uint32_t mipLevels = 1;
+		Access current = ACCESS_NONE;
+		bool exported = false;
+		Access final = ACCESS_NONE;
+		bool transient = false;
+		ImageDesc desc;
+		//into _physicalImages, for live transients once Execute placed them
+		uint32_t physical = INVALID_INDEX;
+	};
+
+	struct Use
+	{
+		uint32_t resource;
+		Access access;
+		bool write;
+		bool discard;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::function<void(vk::CommandBuffer)> record;
+		std::vector<Use> uses;
+		bool sideEffects = false;
+		bool culled = false;
+		//passes that have to run before this one
+		std::vector<uint32_t> dependencies;
+	};
+
+	//what the barriers so far guarantee about a resource
+	struct ResourceState
+	{
+		vk::PipelineStageFlags writeStages;
+		vk::AccessFlags writeAccess;
+		//reads since the last write, a write has to wait for them
+		vk::PipelineStageFlags readStages;
+		//what the last write is already visible to
+		vk::PipelineStageFlags visibleStages;
+		vk::AccessFlags visibleAccess;
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+	};
+
+	//what the physical images were made for, they're kept while every frame asks for the same
+	struct TransientKey
+	{
+		ImageDesc desc;
+		//positions in _order of the first and last pass using it
+		uint32_t first;
+		uint32_t last;
+		bool lazy;
+
+		bool operator==(const TransientKey&) const = default;
+	};
+
+	struct PhysicalImage
+	{
+		vk::Image image;
+		vk::ImageView view;
+		//into _memoryBlocks
+		uint32_t block;
+	};
+
+	//memory shared by transients whose lifetimes don't overlap
+	struct MemoryBlock
+	{
+		VmaAllocation allocation = nullptr;
+		vk::DeviceSize size = 0;
+		bool lazy = false;
+		//how the last transient in it was left, the next one, in this frame or the next, waits for it
+		ResourceState state;
+	};
+
+	//collects one pass's barriers, so they go out as a single pipelineBarrier
+	struct BarrierBatch
+	{
+		vk::PipelineStageFlags srcStages;
+		vk::PipelineStageFlags dstStages;
+		vk::MemoryBarrier memoryBarrier;
+		std::vector<vk::ImageMemoryBarrier> imageBarriers;
+		bool needed = false;
+	};
+
+	void Cull();
+	void BuildDependencies();
+	void Schedule();
+	//finds every live transient's lifetime and hands it a physical image, placing new ones when the lifetimes changed
+	void PlaceTransients();
+	void CreatePhysicalImages(const std::vector<TransientKey>& keys);
+	void AddBarriers(const Use& use, BarrierBatch& batch);
+	void RecordBatch(vk::CommandBuffer commandBuffer, BarrierBatch& batch);
+
+	std::vector<Resource> _resources;
+	std::vector<Pass> _passes;
+	std::vector<uint32_t> _order;
+	std::vector<ResourceState> _states;
+	Stats _stats;
+
+	std::vector<TransientKey> _transientKeys;
+	std::vector<PhysicalImage> _physicalImages;
+	std::vector<MemoryBlock> _memoryBlocks;
+	//bytes each physical image would take on its own
+	std::vector<vk::DeviceSize> _physicalSizes;
+};
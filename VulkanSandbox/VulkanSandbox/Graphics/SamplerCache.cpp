@@ -0,0 +1,141 @@
+#include "SamplerCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../Utils/CLogger.h"
+
+using namespace std;
+
+void SamplerCache::Init()
+{
+    vk::PhysicalDeviceProperties properties{};
+    Graphics::_physicalDevice.getProperties(&properties);
+
+    vk::PhysicalDeviceFeatures features{};
+    Graphics::_physicalDevice.getFeatures(&features);
+
+    _deviceMaxAnisotropy = features.samplerAnisotropy ? properties.limits.maxSamplerAnisotropy : 1.0f;
+    _deviceMaxSamplers = properties.limits.maxSamplerAllocationCount;
+}
+
+void SamplerCache::DeInit()
+{
+    for (auto& [hash, bucket] : _samplers)
+    {
+        for (auto& [desc, sampler] : bucket)
+        {
+            Graphics::_device.destroySampler(sampler, nullptr);
+        }
+    }
+
+    _samplers.clear();
+    _count = 0;
+}
+
+vk::Sampler SamplerCache::Get(const SamplerDesc& desc)
+{
+    const SamplerDesc normalized = Normalize(desc);
+    vector<pair<SamplerDesc, vk::Sampler>>& bucket = _samplers[Hash(normalized)];
+
+    for (const auto& [cachedDesc, sampler] : bucket)
+    {
+        if (cachedDesc == normalized)
+        {
+            return sampler;
+        }
+    }
+
+    Assert(_count < _deviceMaxSamplers, "Out of samplers!", { {"Sampler count", _count}, {"Device limit", _deviceMaxSamplers} });
+
+    vk::SamplerCreateInfo samplerInfo{};
+    samplerInfo.magFilter = normalized.magFilter;
+    samplerInfo.minFilter = normalized.minFilter;
+    samplerInfo.mipmapMode = normalized.mipmapMode;
+    samplerInfo.addressModeU = normalized.addressModeU;
+    samplerInfo.addressModeV = normalized.addressModeV;
+    samplerInfo.addressModeW = normalized.addressModeW;
+    samplerInfo.mipLodBias = normalized.mipLodBias;
+    samplerInfo.anisotropyEnable = normalized.maxAnisotropy > 1.0f;
+    samplerInfo.maxAnisotropy = normalized.maxAnisotropy;
+    samplerInfo.compareEnable = normalized.compareEnable;
+    samplerInfo.compareOp = normalized.compareOp;
+    samplerInfo.minLod = normalized.minLod;
+    samplerInfo.maxLod = normalized.maxLod;
+    samplerInfo.borderColor = normalized.borderColor;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+    vk::Sampler sampler;
+    vk::Result result = Graphics::_device.createSampler(&samplerInfo, nullptr, &sampler);
+    Assert(result == vk::Result::eSuccess, "Failed to create sampler!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    bucket.push_back({ normalized, sampler });
+    _count++;
+
+    return sampler;
+}
+
+SamplerDesc SamplerCache::Normalize(const SamplerDesc& desc)
+{
+    SamplerDesc normalized = desc;
+
+    normalized.maxAnisotropy = std::min(desc.maxAnisotropy, _deviceMaxAnisotropy);
+
+    if (normalized.maxAnisotropy <= 1.0f)
+    {
+        normalized.maxAnisotropy = 1.0f;
+    }
+
+    normalized.minLod = std::max(desc.minLod, 0.0f);
+    normalized.maxLod = std::max(desc.maxLod, normalized.minLod);
+
+    if (!normalized.compareEnable)
+    {
+        normalized.compareOp = vk::CompareOp::eAlways;
+    }
+
+    const bool usesBorder = normalized.addressModeU == vk::SamplerAddressMode::eClampToBorder
+        || normalized.addressModeV == vk::SamplerAddressMode::eClampToBorder
+        || normalized.addressModeW == vk::SamplerAddressMode::eClampToBorder;
+
+    if (!usesBorder)
+    {
+        normalized.borderColor = vk::BorderColor::eIntOpaqueBlack;
+    }
+
+    return normalized;
+}
+
+uint64_t SamplerCache::Hash(const SamplerDesc& desc)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    //field by field, the struct's padding isn't guaranteed to be zero
+    auto add = [&hash](const auto& value)
+    {
+        unsigned char bytes[sizeof(value)];
+        memcpy(bytes, &value, sizeof(value));
+
+        for (unsigned char byte : bytes)
+        {
+            hash ^= byte;
+            hash *= 1099511628211ull;
+        }
+    };
+
+    add(desc.magFilter);
+    add(desc.minFilter);
+    add(desc.mipmapMode);
+    add(desc.addressModeU);
+    add(desc.addressModeV);
+    add(desc.addressModeW);
+    add(desc.maxAnisotropy);
+    add(desc.mipLodBias);
+    add(desc.minLod);
+    add(desc.maxLod);
+    add(desc.borderColor);
+    add(desc.compareEnable);
+    add(desc.compareOp);
+
+    return hash;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Graphics.h"
+
+//Everything a VkSampler is created from, defaults to trilinear, repeat and 16x anisotropy (or what the device has)
+struct SamplerDesc
+{
+	vk::Filter magFilter = vk::Filter::eLinear;
+	vk::Filter minFilter = vk::Filter::eLinear;
+	vk::SamplerMipmapMode mipmapMode = vk::SamplerMipmapMode::eLinear;
+	vk::SamplerAddressMode addressModeU = vk::SamplerAddressMode::eRepeat;
+	vk::SamplerAddressMode addressModeV = vk::SamplerAddressMode::eRepeat;
+	vk::SamplerAddressMode addressModeW = vk::SamplerAddressMode::eRepeat;
+	//1 or less turns anisotropic filtering off, anything above the device limit gets the limit
+	float maxAnisotropy = 16.0f;
+	float mipLodBias = 0.0f;
+	//relative to the base mip of the view the sampler is used with
+	float minLod = 0.0f;
+	float maxLod = VK_LOD_CLAMP_NONE;
+	vk::BorderColor borderColor = vk::BorderColor::eIntOpaqueBlack;
+	bool compareEnable = false;
+	vk::CompareOp compareOp = vk::CompareOp::eAlways;
+
+	bool operator==(const SamplerDesc&) const = default;
+};
+
+//Hands out one VkSampler per distinct SamplerDesc, so any number of textures and materials share a handful
+//of samplers and we stay far from the device's maxSamplerAllocationCount. Samplers live until DeInit
+class SamplerCache
+{
+public:
+	//needs the device, reads the anisotropy and sampler count limits
+	static void Init();
+	static void DeInit();
+
+	//descs that only differ in ways the device can't tell apart (anisotropy past the limit, border colour without
+	//a border address mode, compare op with compare off) share a sampler
+	static vk::Sampler Get(const SamplerDesc& desc);
+	static size_t Count() { return _count; }
+
+private:
+	static SamplerDesc Normalize(const SamplerDesc& desc);
+	static uint64_t Hash(const SamplerDesc& desc);
+
+	//buckets by hash, a bucket only holds more than one desc on a collision
+	inline static std::unordered_map<uint64_t, std::vector<std::pair<SamplerDesc, vk::Sampler>>> _samplers;
+	inline static size_t _count = 0;
+	inline static float _deviceMaxAnisotropy = 1.0f;
+	inline static uint32_t _deviceMaxSamplers = 4000;
+};
@@ -0,0 +1,182 @@
+#include "SphereCuller.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <immintrin.h>
+
+#include "../Utils/JobSystem.h"
+
+using namespace std;
+using namespace glm;
+
+#if defined(__AVX2__)
+constexpr uint32_t SIMD_WIDTH = 8;
+
+//entry m holds the lanes whose bit is set in m, packed to the front, so adding the block's first index
+//and storing all eight writes the visible indices without branching on each lane
+static const array<array<uint32_t, 8>, 256> COMPACT_LANES = []()
+    {
+        array<array<uint32_t, 8>, 256> table{};
+
+        for (uint32_t mask = 0; mask < table.size(); ++mask)
+        {
+            uint32_t count = 0;
+
+            for (uint32_t lane = 0; lane < 8; ++lane)
+            {
+                if (mask & (1u << lane))
+                {
+                    table[mask][count++] = lane;
+                }
+            }
+        }
+
+        return table;
+    }();
+#endif
+
+static_assert(SphereCuller::SPHERES_PER_JOB % 8 == 0, "Jobs have to start on a SIMD block");
+
+uint32_t SphereCuller::Add(const vec3& center, float radius)
+{
+    _centerX.push_back(center.x);
+    _centerY.push_back(center.y);
+    _centerZ.push_back(center.z);
+    _radius.push_back(radius);
+
+    return Count() - 1;
+}
+
+void SphereCuller::Set(uint32_t index, const vec3& center, float radius)
+{
+    _centerX[index] = center.x;
+    _centerY[index] = center.y;
+    _centerZ[index] = center.z;
+    _radius[index] = radius;
+}
+
+void SphereCuller::Resize(uint32_t count)
+{
+    _centerX.resize(count);
+    _centerY.resize(count);
+    _centerZ.resize(count);
+    _radius.resize(count);
+}
+
+void SphereCuller::Clear()
+{
+    Resize(0);
+}
+
+void SphereCuller::Cull(const Frustum& frustum, vector<uint32_t>& visible, bool simd)
+{
+    const uint32_t count = Count();
+    const size_t chunkCount = (count + SPHERES_PER_JOB - 1) / SPHERES_PER_JOB;
+
+    const Spheres spheres{ _centerX.data(), _centerY.data(), _centerZ.data(), _radius.data() };
+
+    _scratch.resize(count);
+    _chunkVisible.resize(chunkCount);
+
+    JobSystem::ParallelFor(count, SPHERES_PER_JOB, [&](size_t begin, size_t end)
+        {
+            uint32_t* out = _scratch.data() + begin;
+            const uint32_t first = static_cast<uint32_t>(begin);
+            const uint32_t last = static_cast<uint32_t>(end);
+
+            _chunkVisible[begin / SPHERES_PER_JOB] = CullRange(frustum, spheres, first, last, out, simd);
+        });
+
+    //chunks are in index order, so packing them keeps the list sorted
+    size_t visibleCount = 0;
+
+    for (uint32_t chunkVisible : _chunkVisible)
+    {
+        visibleCount += chunkVisible;
+    }
+
+    visible.resize(visibleCount);
+    size_t offset = 0;
+
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        memcpy(visible.data() + offset, _scratch.data() + chunk * SPHERES_PER_JOB, _chunkVisible[chunk] * sizeof(uint32_t));
+        offset += _chunkVisible[chunk];
+    }
+}
+
+uint32_t SphereCuller::CullRange(const Frustum& frustum, const Spheres& spheres, uint32_t begin, uint32_t end, uint32_t* out, bool simd)
+{
+    return simd ? CullRangeSimd(frustum, spheres, begin, end, out) : CullRangeScalar(frustum, spheres, begin, end, out);
+}
+
+uint32_t SphereCuller::CullRangeScalar(const Frustum& frustum, const Spheres& spheres, uint32_t begin, uint32_t end, uint32_t* out)
+{
+    uint32_t visibleCount = 0;
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        bool inside = true;
+
+        for (const vec4& plane : frustum.planes)
+        {
+            inside &= plane.x * spheres.centerX[i] + plane.y * spheres.centerY[i] + plane.z * spheres.centerZ[i] + plane.w + spheres.radius[i] >= 0.0f;
+        }
+
+        out[visibleCount] = i;
+        visibleCount += inside;
+    }
+
+    return visibleCount;
+}
+
+uint32_t SphereCuller::CullRangeSimd(const Frustum& frustum, const Spheres& spheres, uint32_t begin, uint32_t end, uint32_t* out)
+{
+#if defined(__AVX2__)
+    __m256 planes[Frustum::PLANE_COUNT][4];
+
+    for (size_t p = 0; p < Frustum::PLANE_COUNT; ++p)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+        }
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    uint32_t visibleCount = 0;
+    uint32_t i = begin;
+
+    for (; i + SIMD_WIDTH <= end; i += SIMD_WIDTH)
+    {
+        const __m256 x = _mm256_loadu_ps(spheres.centerX + i);
+        const __m256 y = _mm256_loadu_ps(spheres.centerY + i);
+        const __m256 z = _mm256_loadu_ps(spheres.centerZ + i);
+        const __m256 r = _mm256_loadu_ps(spheres.radius + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (const auto& plane : planes)
+        {
+            //plane.w + radius first, the three fmas then give the distance of the sphere's far side
+            __m256 distance = _mm256_add_ps(plane[3], r);
+            distance = _mm256_fmadd_ps(plane[0], x, distance);
+            distance = _mm256_fmadd_ps(plane[1], y, distance);
+            distance = _mm256_fmadd_ps(plane[2], z, distance);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+        }
+
+        const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+        const __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(COMPACT_LANES[mask].data()));
+        //at most i - begin indices are written so far, so all eight stay inside this range of out
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + visibleCount), _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(i))));
+        visibleCount += popcount(mask);
+    }
+
+    //the last few that don't fill a register
+    return visibleCount + CullRangeScalar(frustum, spheres, i, end, out + visibleCount);
+#else
+    return CullRangeScalar(frustum, spheres, begin, end, out);
+#endif
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "Frustum.h"
+
+//Bounding spheres kept as one array per component, so the frustum test loads eight spheres into AVX2 registers at once
+//Culling splits the spheres into chunks on the JobSystem and writes the indices of the visible ones, in order
+class SphereCuller
+{
+public:
+	//returns the sphere's index, which is what Cull writes out
+	uint32_t Add(const glm::vec3& center, float radius);
+	void Set(uint32_t index, const glm::vec3& center, float radius);
+	void Resize(uint32_t count);
+	void Clear();
+	uint32_t Count() const { return static_cast<uint32_t>(_radius.size()); }
+
+	//replaces visible with the indices of every sphere touching the frustum, ascending
+	//the frustum has to be in the spheres' space, build it from viewProj * whatever matrix places them
+	//simd off runs the scalar loop, only the benchmark wants that
+	void Cull(const Frustum& frustum, std::vector<uint32_t>& visible, bool simd = true);
+
+	//spheres per job, a multiple of the SIMD width so chunks never split a register
+	constexpr static size_t SPHERES_PER_JOB = 16 * 1024;
+
+	//one float array per component, owned by whoever culls them
+	struct Spheres
+	{
+		const float* centerX;
+		const float* centerY;
+		const float* centerZ;
+		const float* radius;
+	};
+
+	//writes the visible indices of [begin, end) from out on and returns how many there were, on the calling thread
+	//the SIMD loop stores eight at a time, so out needs room for end - begin indices
+	static uint32_t CullRange(const Frustum& frustum, const Spheres& spheres, uint32_t begin, uint32_t end, uint32_t* out, bool simd = true);
+
+private:
+	static uint32_t CullRangeScalar(const Frustum& frustum, const Spheres& spheres, uint32_t begin, uint32_t end, uint32_t* out);
+	static uint32_t CullRangeSimd(const Frustum& frustum, const Spheres& spheres, uint32_t begin, uint32_t end, uint32_t* out);
+
+	std::vector<float> _centerX;
+	std::vector<float> _centerY;
+	std::vector<float> _centerZ;
+	std::vector<float> _radius;
+
+	//every chunk compacts into its own range of this, then the ranges get packed into the output
+	std::vector<uint32_t> _scratch;
+	std::vector<uint32_t> _chunkVisible;
+};
@@ -0,0 +1,120 @@
+#include "UploadBatch.h"
+
+#include "../Utils/CLogger.h"
+
+using namespace std;
+
+UploadBatch::UploadBatch() : _commandBuffer(Graphics::BeginSingleTimeCommands())
+{
+}
+
+UploadBatch::~UploadBatch()
+{
+    Assert(_submitted, "Upload batch destroyed without being submitted!", { {"Staging buffers", _stagingBuffers.size()} });
+
+    //the staging buffers can't go away while the GPU might still be copying out of them
+    if (!_complete)
+    {
+        vk::Result result = Graphics::_device.waitForFences(1, &_fence, VK_TRUE, UINT64_MAX);
+        Assert(result == vk::Result::eSuccess, "Failed to wait for upload fence!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+        Release();
+    }
+}
+
+vk::Buffer UploadBatch::Stage(const void* data, vk::DeviceSize size)
+{
+    vk::Buffer stagingBuffer;
+    VmaAllocation stagingBufferMemory;
+    Graphics::CreateBuffer(size, vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        stagingBuffer, stagingBufferMemory, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+    void* mapped;
+    VkResult result = vmaMapMemory(Graphics::_allocator, stagingBufferMemory, &mapped);
+    Assert(result == VK_SUCCESS, "Failed to map staging memory!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    memcpy(mapped, data, size);
+    vmaUnmapMemory(Graphics::_allocator, stagingBufferMemory);
+
+    _stagingBuffers.emplace_back(stagingBuffer, stagingBufferMemory);
+
+    return stagingBuffer;
+}
+
+void UploadBatch::UploadBuffer(const void* data, vk::DeviceSize size, vk::BufferUsageFlags usage,
+    vk::Buffer& buffer, VmaAllocation& bufferMemory)
+{
+    vk::Buffer stagingBuffer = Stage(data, size);
+
+    Graphics::CreateBuffer(size, vk::BufferUsageFlagBits::eTransferDst | usage,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, buffer, bufferMemory);
+
+    vk::BufferCopy copyRegion{};
+    copyRegion.size = size;
+    _commandBuffer.copyBuffer(stagingBuffer, buffer, 1, &copyRegion);
+}
+
+void UploadBatch::Submit()
+{
+    SubmitAsync();
+
+    vk::Result result = Graphics::_device.waitForFences(1, &_fence, VK_TRUE, UINT64_MAX);
+    Assert(result == vk::Result::eSuccess, "Failed to wait for upload fence!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    Release();
+}
+
+void UploadBatch::SubmitAsync()
+{
+    Assert(!_submitted, "Upload batch submitted twice!");
+
+    _commandBuffer.end();
+
+    vk::FenceCreateInfo fenceInfo{};
+    vk::Result result = Graphics::_device.createFence(&fenceInfo, nullptr, &_fence);
+    Assert(result == vk::Result::eSuccess, "Failed to create upload fence!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    vk::SubmitInfo submitInfo{};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &_commandBuffer;
+
+    result = Graphics::_graphicsQueue.submit(1, &submitInfo, _fence);
+    Assert(result == vk::Result::eSuccess, "Failed to submit upload batch!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    _submitted = true;
+}
+
+bool UploadBatch::IsComplete()
+{
+    if (_complete)
+    {
+        return true;
+    }
+
+    if (!_submitted || Graphics::_device.getFenceStatus(_fence) != vk::Result::eSuccess)
+    {
+        return false;
+    }
+
+    Release();
+
+    return true;
+}
+
+void UploadBatch::Release()
+{
+    for (auto& [stagingBuffer, stagingBufferMemory] : _stagingBuffers)
+    {
+        vmaDestroyBuffer(Graphics::_allocator, stagingBuffer, stagingBufferMemory);
+    }
+
+    _stagingBuffers.clear();
+
+    Graphics::_device.freeCommandBuffers(Graphics::_commandPool, 1, &_commandBuffer);
+    Graphics::_device.destroyFence(_fence, nullptr);
+
+    _commandBuffer = nullptr;
+    _fence = nullptr;
+    _complete = true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <utility>
+
+#include "Graphics.h"
+
+//Records the copies for a group of assets into one command buffer so they reach the GPU in a single submit
+//Staging memory stays alive until the copies are known to have finished
+class UploadBatch
+{
+public:
+	UploadBatch();
+	~UploadBatch();
+	UploadBatch(const UploadBatch&) = delete;
+	UploadBatch& operator=(const UploadBatch&) = delete;
+
+	//copies data into a host visible buffer that lives until Submit
+	vk::Buffer Stage(const void* data, vk::DeviceSize size);
+	//creates a device local buffer and records the copy of data into it
+	void UploadBuffer(const void* data, vk::DeviceSize size, vk::BufferUsageFlags usage,
+		vk::Buffer& buffer, VmaAllocation& bufferMemory);
+
+	//for image copies, barriers and anything else that has to ride along with the uploads
+	vk::CommandBuffer GetCommandBuffer() const { return _commandBuffer; }
+
+	//submits everything recorded so far and blocks until the GPU has finished with it
+	void Submit();
+	//submits without waiting, poll IsComplete every frame to find out when the copies are done
+	void SubmitAsync();
+	//frees the staging memory once the GPU is done with it
+	bool IsComplete();
+
+private:
+	void Release();
+
+	vk::CommandBuffer _commandBuffer;
+	vk::Fence _fence;
+	std::vector<std::pair<vk::Buffer, VmaAllocation>> _stagingBuffers;
+	bool _submitted = false;
+	bool _complete = false;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "../Assets/AssetHandle.h"
+
+class Model;
+
+//Components of everything Graphics draws, see EntityManager
+
+//relative to Graphics::_model
+struct TransformComponent
+{
+	glm::mat4 transform{ 1.0f };
+};
+
+struct MeshComponent
+{
+	AssetHandle<Model> model;
+};
+
+struct MaterialComponent
+{
+	uint32_t materialIndex = 0;
+};
+
+//the mesh's bounding sphere moved by the transform, in the same space as it
+//one component per float, so every chunk holds them as the plain arrays SphereCuller::CullRange reads eight at a time
+struct BoundsXComponent
+{
+	float x = 0.0f;
+};
+
+struct BoundsYComponent
+{
+	float y = 0.0f;
+};
+
+struct BoundsZComponent
+{
+	float z = 0.0f;
+};
+
+struct BoundsRadiusComponent
+{
+	float radius = 0.0f;
+};
+
+static_assert(sizeof(BoundsXComponent) == sizeof(float) && sizeof(BoundsRadiusComponent) == sizeof(float), "Bounds arrays are read as float arrays");
+
+//LOD drawn last frame, SelectLod needs it for the hysteresis
+struct LodComponent
+{
+	uint32_t lod = 0;
+};
@@ -0,0 +1,154 @@
+#include "EntityManager.h"
+
+#include <bit>
+#include <cstring>
+
+#include "../Utils/CLogger.h"
+
+using namespace std;
+
+static size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t EntityManager::RegisterComponent(size_t size)
+{
+    Assert(_componentSizes.size() < MAX_COMPONENTS, "Too many component types!", { {"Limit", MAX_COMPONENTS} });
+
+    _componentSizes.push_back(size);
+
+    return static_cast<uint32_t>(_componentSizes.size() - 1);
+}
+
+void EntityManager::Destroy(Entity entity)
+{
+    Assert(IsAlive(entity), "Destroying an entity that doesn't exist!", { {"Index", entity.index}, {"Generation", entity.generation} });
+
+    EntityRecord& record = _records[entity.index];
+    Archetype& archetype = _archetypes[record.archetype];
+    const uint32_t last = archetype.count - 1;
+
+    //the archetype's last entity fills the hole, so every chunk but the last stays full
+    if (record.row != last)
+    {
+        for (uint64_t mask = archetype.mask; mask != 0; mask &= mask - 1)
+        {
+            const uint32_t componentId = static_cast<uint32_t>(countr_zero(mask));
+
+            memcpy(Column(archetype, record.row, componentId), Column(archetype, last, componentId), _componentSizes[componentId]);
+        }
+
+        const Entity moved = *reinterpret_cast<Entity*>(Column(archetype, record.row, ComponentId<Entity>()));
+        _records[moved.index].row = record.row;
+    }
+
+    archetype.count--;
+
+    if (archetype.count == (archetype.chunks.size() - 1) * archetype.capacity)
+    {
+        archetype.chunks.pop_back();
+    }
+
+    record.alive = false;
+    record.generation++;
+    _freeIndices.push_back(entity.index);
+    _count--;
+}
+
+void EntityManager::Clear()
+{
+    for (Archetype& archetype : _archetypes)
+    {
+        archetype.chunks.clear();
+        archetype.count = 0;
+    }
+
+    _freeIndices.clear();
+
+    //bumping the generations makes every handed out Entity stale
+    for (uint32_t i = 0; i < _records.size(); i++)
+    {
+        if (_records[i].alive)
+        {
+            _records[i].alive = false;
+            _records[i].generation++;
+        }
+
+        _freeIndices.push_back(i);
+    }
+
+    _count = 0;
+}
+
+bool EntityManager::IsAlive(Entity entity) const
+{
+    return entity.index < _records.size() && _records[entity.index].alive && _records[entity.index].generation == entity.generation;
+}
+
+EntityManager::Archetype& EntityManager::GetArchetype(uint64_t mask)
+{
+    for (Archetype& archetype : _archetypes)
+    {
+        if (archetype.mask == mask)
+        {
+            return archetype;
+        }
+    }
+
+    Archetype& archetype = _archetypes.emplace_back();
+    archetype.mask = mask;
+
+    size_t entitySize = 0;
+    uint32_t componentCount = 0;
+
+    for (uint64_t bits = mask; bits != 0; bits &= bits - 1)
+    {
+        entitySize += _componentSizes[countr_zero(bits)];
+        componentCount++;
+    }
+
+    //every array can lose up to a cache line to alignment
+    archetype.capacity = static_cast<uint32_t>((CHUNK_SIZE - CACHE_LINE * componentCount) / entitySize);
+    Assert(archetype.capacity > 0, "Entity doesn't fit in a chunk!", { {"Bytes", entitySize}, {"Chunk bytes", CHUNK_SIZE} });
+
+    size_t offset = 0;
+
+    for (uint64_t bits = mask; bits != 0; bits &= bits - 1)
+    {
+        const uint32_t componentId = static_cast<uint32_t>(countr_zero(bits));
+
+        archetype.offsets[componentId] = static_cast<uint32_t>(offset);
+        offset = AlignUp(offset + _componentSizes[componentId] * archetype.capacity, CACHE_LINE);
+    }
+
+    return archetype;
+}
+
+byte* EntityManager::Column(Archetype& archetype, uint32_t row, uint32_t componentId)
+{
+    const uint32_t chunk = row / archetype.capacity;
+    const uint32_t slot = row % archetype.capacity;
+
+    return archetype.chunks[chunk]->data + archetype.offsets[componentId] + static_cast<size_t>(slot) * _componentSizes[componentId];
+}
+
+void EntityManager::GatherChunks(uint64_t mask)
+{
+    _queryChunks.clear();
+
+    for (Archetype& archetype : _archetypes)
+    {
+        if ((archetype.mask & mask) != mask)
+        {
+            continue;
+        }
+
+        const uint32_t chunkCount = (archetype.count + archetype.capacity - 1) / archetype.capacity;
+
+        for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+        {
+            _queryChunks.push_back({ &archetype, chunk });
+        }
+    }
+}
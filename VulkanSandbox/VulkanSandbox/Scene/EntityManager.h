@@ -0,0 +1,249 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "../Utils/JobSystem.h"
+
+//slot index plus the generation it was created with, goes stale once the entity is destroyed
+struct Entity
+{
+	constexpr static uint32_t INVALID_INDEX = ~0u;
+
+	uint32_t index = INVALID_INDEX;
+	uint32_t generation = 0;
+
+	bool IsValid() const { return index != INVALID_INDEX; }
+	bool operator==(const Entity&) const = default;
+};
+
+//Entities grouped by archetype, the exact set of components they have. Every archetype stores its entities in
+//16 KiB chunks, each chunk holding one cache line aligned array per component, so a query walks plain arrays
+//Components are plain data, they get moved around with memcpy and are never destructed
+class EntityManager
+{
+public:
+	constexpr static size_t CHUNK_SIZE = 16 * 1024;
+	constexpr static size_t CACHE_LINE = 64;
+	constexpr static uint32_t MAX_COMPONENTS = 64;
+
+	EntityManager() = default;
+	EntityManager(const EntityManager&) = delete;
+	EntityManager& operator=(const EntityManager&) = delete;
+
+	template<typename... Ts>
+	Entity Create(const Ts&... components);
+	void Destroy(Entity entity);
+	void Clear();
+	bool IsAlive(Entity entity) const;
+	uint32_t Count() const { return _count; }
+
+	template<typename T>
+	bool Has(Entity entity) const;
+	template<typename T>
+	T& Get(Entity entity);
+
+	//chunks whose archetype has every one of Ts, what ForEachChunk hands out as chunkIndex goes up to this
+	template<typename... Ts>
+	size_t ChunkCount() const;
+	//func(chunkIndex, std::span<Ts>...) once per chunk with entities of all of Ts, in the same order every call until
+	//entities are created or destroyed. Ts may be const and may include Entity, which gives the chunk's entities
+	template<typename... Ts, typename Func>
+	void ForEachChunk(Func&& func);
+	//same, chunks split across the JobSystem, func may only write to the chunk it was given
+	template<typename... Ts, typename Func>
+	void ParallelForEachChunk(Func&& func, size_t chunksPerJob = CHUNKS_PER_JOB);
+
+	constexpr static size_t CHUNKS_PER_JOB = 4;
+
+	//ids are handed out on first use
+	template<typename T>
+	static uint32_t ComponentId();
+
+private:
+	struct alignas(CACHE_LINE) Chunk
+	{
+		std::byte data[CHUNK_SIZE];
+	};
+
+	struct Archetype
+	{
+		uint64_t mask = 0;
+		//entities that fit in a chunk with every array starting on a cache line
+		uint32_t capacity = 0;
+		//where each component's array starts in a chunk, by component id
+		std::array<uint32_t, MAX_COMPONENTS> offsets{};
+		std::vector<std::unique_ptr<Chunk>> chunks;
+		//every chunk but the last is full
+		uint32_t count = 0;
+	};
+
+	struct EntityRecord
+	{
+		uint32_t generation = 0;
+		uint32_t archetype = 0;
+		//position in the archetype, chunk is row / capacity
+		uint32_t row = 0;
+		bool alive = false;
+	};
+
+	struct ChunkRef
+	{
+		Archetype* archetype;
+		uint32_t chunk;
+	};
+
+	static uint32_t RegisterComponent(size_t size);
+	template<typename... Ts>
+	static uint64_t MaskOf();
+	Archetype& GetArchetype(uint64_t mask);
+	std::byte* Column(Archetype& archetype, uint32_t row, uint32_t componentId);
+	//the matching chunks in a stable order, entities are never reordered outside Create and Destroy
+	void GatherChunks(uint64_t mask);
+
+	template<typename T, typename... Ts, typename Func>
+	static void CallChunk(Func& func, size_t chunkIndex, const ChunkRef& chunk);
+
+	std::vector<Archetype> _archetypes;
+	std::vector<EntityRecord> _records;
+	std::vector<uint32_t> _freeIndices;
+	uint32_t _count = 0;
+
+	std::vector<ChunkRef> _queryChunks;
+
+	inline static std::vector<size_t> _componentSizes;
+};
+
+template<typename T>
+uint32_t EntityManager::ComponentId()
+{
+	//a const query still reads the same arrays
+	if constexpr (std::is_const_v<T>)
+	{
+		return ComponentId<std::remove_const_t<T>>();
+	}
+	else
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Components are moved with memcpy");
+		static_assert(alignof(T) <= CACHE_LINE, "Component arrays are only cache line aligned");
+
+		static const uint32_t id = RegisterComponent(sizeof(T));
+
+		return id;
+	}
+}
+
+template<typename... Ts>
+uint64_t EntityManager::MaskOf()
+{
+	return ((1ull << ComponentId<Ts>()) | ... | 0ull);
+}
+
+template<typename... Ts>
+Entity EntityManager::Create(const Ts&... components)
+{
+	Archetype& archetype = GetArchetype(MaskOf<Entity, Ts...>());
+	const uint32_t archetypeIndex = static_cast<uint32_t>(&archetype - _archetypes.data());
+
+	if (archetype.count == archetype.chunks.size() * archetype.capacity)
+	{
+		archetype.chunks.push_back(std::make_unique<Chunk>());
+	}
+
+	uint32_t index;
+
+	if (_freeIndices.empty())
+	{
+		index = static_cast<uint32_t>(_records.size());
+		_records.emplace_back();
+	}
+	else
+	{
+		index = _freeIndices.back();
+		_freeIndices.pop_back();
+	}
+
+	EntityRecord& record = _records[index];
+	record.archetype = archetypeIndex;
+	record.row = archetype.count++;
+	record.alive = true;
+
+	const Entity entity{ index, record.generation };
+	*reinterpret_cast<Entity*>(Column(archetype, record.row, ComponentId<Entity>())) = entity;
+	((*reinterpret_cast<Ts*>(Column(archetype, record.row, ComponentId<Ts>())) = components), ...);
+	_count++;
+
+	return entity;
+}
+
+template<typename T>
+bool EntityManager::Has(Entity entity) const
+{
+	return IsAlive(entity) && (_archetypes[_records[entity.index].archetype].mask & (1ull << ComponentId<T>()));
+}
+
+template<typename T>
+T& EntityManager::Get(Entity entity)
+{
+	const EntityRecord& record = _records[entity.index];
+
+	return *reinterpret_cast<T*>(Column(_archetypes[record.archetype], record.row, ComponentId<T>()));
+}
+
+template<typename... Ts>
+size_t EntityManager::ChunkCount() const
+{
+	const uint64_t mask = MaskOf<Ts...>();
+	size_t count = 0;
+
+	for (const Archetype& archetype : _archetypes)
+	{
+		if ((archetype.mask & mask) == mask)
+		{
+			count += (archetype.count + archetype.capacity - 1) / archetype.capacity;
+		}
+	}
+
+	return count;
+}
+
+template<typename T, typename... Ts, typename Func>
+void EntityManager::CallChunk(Func& func, size_t chunkIndex, const ChunkRef& chunk)
+{
+	const Archetype& archetype = *chunk.archetype;
+	const uint32_t count = std::min(archetype.capacity, archetype.count - chunk.chunk * archetype.capacity);
+	std::byte* data = archetype.chunks[chunk.chunk]->data;
+
+	func(chunkIndex, std::span<T>(reinterpret_cast<T*>(data + archetype.offsets[ComponentId<T>()]), count),
+		std::span<Ts>(reinterpret_cast<Ts*>(data + archetype.offsets[ComponentId<Ts>()]), count)...);
+}
+
+template<typename... Ts, typename Func>
+void EntityManager::ForEachChunk(Func&& func)
+{
+	GatherChunks(MaskOf<Ts...>());
+
+	for (size_t i = 0; i < _queryChunks.size(); i++)
+	{
+		CallChunk<Ts...>(func, i, _queryChunks[i]);
+	}
+}
+
+template<typename... Ts, typename Func>
+void EntityManager::ParallelForEachChunk(Func&& func, size_t chunksPerJob)
+{
+	GatherChunks(MaskOf<Ts...>());
+
+	JobSystem::ParallelFor(_queryChunks.size(), chunksPerJob, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				CallChunk<Ts...>(func, i, _queryChunks[i]);
+			}
+		});
+}
@@ -0,0 +1,320 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+
+#include "../Utils/CLogger.h"
+#include "../Utils/JobSystem.h"
+
+using namespace std;
+using namespace glm;
+
+//translation * rotation * scale without building the three matrices
+static mat4 ComposeTrs(const vec3& position, const quat& rotation, const vec3& scale)
+{
+    const mat3 rotationMatrix = mat3_cast(rotation);
+
+    return mat4(vec4(rotationMatrix[0] * scale.x, 0.0f), vec4(rotationMatrix[1] * scale.y, 0.0f), vec4(rotationMatrix[2] * scale.z, 0.0f),
+        vec4(position, 1.0f));
+}
+
+uint32_t TransformHierarchy::Add(uint32_t parent, const vec3& position, const quat& rotation, const vec3& scale)
+{
+    Assert(parent == INVALID_NODE || parent < _indices.size(), "Parent node doesn't exist!", { {"Parent", parent}, {"Nodes", Count()} });
+
+    const uint32_t handle = static_cast<uint32_t>(_indices.size());
+    const uint32_t index = Count();
+
+    _positions.push_back(position);
+    _rotations.push_back(rotation);
+    _scales.push_back(scale);
+    _worlds.emplace_back(1.0f);
+    _parents.push_back(parent == INVALID_NODE ? INVALID_NODE : _indices[parent]);
+    _firstChildren.push_back(0);
+    _childCounts.push_back(0);
+    _dirty.push_back(0);
+    _handles.push_back(handle);
+    _indices.push_back(index);
+
+    _orderDirty = true;
+    MarkDirty(index);
+
+    return handle;
+}
+
+void TransformHierarchy::Reserve(uint32_t count)
+{
+    _positions.reserve(count);
+    _rotations.reserve(count);
+    _scales.reserve(count);
+    _worlds.reserve(count);
+    _parents.reserve(count);
+    _firstChildren.reserve(count);
+    _childCounts.reserve(count);
+    _dirty.reserve(count);
+    _handles.reserve(count);
+    _indices.reserve(count);
+}
+
+void TransformHierarchy::Clear()
+{
+    _positions.clear();
+    _rotations.clear();
+    _scales.clear();
+    _worlds.clear();
+    _parents.clear();
+    _firstChildren.clear();
+    _childCounts.clear();
+    _dirty.clear();
+    _handles.clear();
+    _indices.clear();
+    _levelStarts.clear();
+    _dirtyNodes.clear();
+    _levelDirtyNodes.clear();
+    _orderDirty = false;
+    _updatedCount = 0;
+}
+
+void TransformHierarchy::SetLocal(uint32_t node, const vec3& position, const quat& rotation, const vec3& scale)
+{
+    const uint32_t index = _indices[node];
+
+    _positions[index] = position;
+    _rotations[index] = rotation;
+    _scales[index] = scale;
+    MarkDirty(index);
+}
+
+void TransformHierarchy::SetPosition(uint32_t node, const vec3& position)
+{
+    const uint32_t index = _indices[node];
+
+    _positions[index] = position;
+    MarkDirty(index);
+}
+
+void TransformHierarchy::SetRotation(uint32_t node, const quat& rotation)
+{
+    const uint32_t index = _indices[node];
+
+    _rotations[index] = rotation;
+    MarkDirty(index);
+}
+
+void TransformHierarchy::SetScale(uint32_t node, const vec3& scale)
+{
+    const uint32_t index = _indices[node];
+
+    _scales[index] = scale;
+    MarkDirty(index);
+}
+
+uint32_t TransformHierarchy::GetParent(uint32_t node) const
+{
+    const uint32_t parent = _parents[_indices[node]];
+
+    return parent == INVALID_NODE ? INVALID_NODE : _handles[parent];
+}
+
+void TransformHierarchy::MarkDirty(uint32_t index)
+{
+    if (!_dirty[index])
+    {
+        _dirty[index] = 1;
+        _dirtyNodes.push_back(index);
+    }
+}
+
+void TransformHierarchy::MarkAllDirty()
+{
+    for (uint32_t i = 0; i < Count(); i++)
+    {
+        MarkDirty(i);
+    }
+}
+
+void TransformHierarchy::Update()
+{
+    if (_orderDirty)
+    {
+        Rebuild();
+    }
+
+    _updatedCount = 0;
+
+    if (_dirtyNodes.empty())
+    {
+        return;
+    }
+
+    _levelDirtyNodes.resize(LevelCount());
+
+    for (uint32_t index : _dirtyNodes)
+    {
+        _levelDirtyNodes[LevelOf(index)].push_back(index);
+    }
+
+    _dirtyNodes.clear();
+
+    //a level only reads the level above it, which is done by the time it starts
+    for (uint32_t level = 0; level < LevelCount(); level++)
+    {
+        vector<uint32_t>& dirtyNodes = _levelDirtyNodes[level];
+
+        if (dirtyNodes.empty())
+        {
+            continue;
+        }
+
+        JobSystem::ParallelFor(dirtyNodes.size(), NODES_PER_JOB, [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    const uint32_t index = dirtyNodes[i];
+                    const mat4 local = ComposeTrs(_positions[index], _rotations[index], _scales[index]);
+                    const uint32_t parent = _parents[index];
+
+                    _worlds[index] = parent == INVALID_NODE ? local : _worlds[parent] * local;
+                }
+            });
+
+        //children of a moved node move with it, they sit together in the next level
+        if (level + 1 < LevelCount())
+        {
+            vector<uint32_t>& childNodes = _levelDirtyNodes[level + 1];
+
+            for (uint32_t index : dirtyNodes)
+            {
+                const uint32_t firstChild = _firstChildren[index];
+
+                for (uint32_t child = firstChild; child < firstChild + _childCounts[index]; child++)
+                {
+                    if (!_dirty[child])
+                    {
+                        _dirty[child] = 1;
+                        childNodes.push_back(child);
+                    }
+                }
+            }
+        }
+
+        for (uint32_t index : dirtyNodes)
+        {
+            _dirty[index] = 0;
+        }
+
+        _updatedCount += static_cast<uint32_t>(dirtyNodes.size());
+        dirtyNodes.clear();
+    }
+}
+
+void TransformHierarchy::Rebuild()
+{
+    const uint32_t count = Count();
+
+    //children of every node in add order, parents always come before their children so one pass builds it
+    vector<uint32_t> childStarts(count + 1, 0);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (_parents[i] != INVALID_NODE)
+        {
+            childStarts[_parents[i] + 1]++;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        childStarts[i + 1] += childStarts[i];
+    }
+
+    vector<uint32_t> children(childStarts[count]);
+    vector<uint32_t> childCursors(childStarts.begin(), childStarts.end() - 1);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (_parents[i] != INVALID_NODE)
+        {
+            children[childCursors[_parents[i]]++] = i;
+        }
+    }
+
+    //breadth first from the roots, order[new position] = old position
+    vector<uint32_t> order;
+    order.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (_parents[i] == INVALID_NODE)
+        {
+            order.push_back(i);
+        }
+    }
+
+    _levelStarts.assign(1, 0);
+    vector<uint32_t> newIndices(count);
+    vector<uint32_t> firstChildren(count);
+    vector<uint32_t> childCounts(count);
+
+    for (uint32_t levelBegin = 0; levelBegin < order.size();)
+    {
+        const uint32_t levelEnd = static_cast<uint32_t>(order.size());
+        _levelStarts.push_back(levelEnd);
+
+        for (uint32_t i = levelBegin; i < levelEnd; i++)
+        {
+            const uint32_t old = order[i];
+
+            newIndices[old] = i;
+            firstChildren[i] = static_cast<uint32_t>(order.size());
+            childCounts[i] = childStarts[old + 1] - childStarts[old];
+            order.insert(order.end(), children.begin() + childStarts[old], children.begin() + childStarts[old + 1]);
+        }
+
+        levelBegin = levelEnd;
+    }
+
+    auto permute = [&](auto& values)
+        {
+            auto permuted = values;
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                permuted[i] = values[order[i]];
+            }
+
+            values.swap(permuted);
+        };
+
+    permute(_positions);
+    permute(_rotations);
+    permute(_scales);
+    permute(_worlds);
+    permute(_dirty);
+    permute(_handles);
+    permute(_parents);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (_parents[i] != INVALID_NODE)
+        {
+            _parents[i] = newIndices[_parents[i]];
+        }
+
+        _indices[_handles[i]] = i;
+    }
+
+    _firstChildren.swap(firstChildren);
+    _childCounts.swap(childCounts);
+
+    for (uint32_t& index : _dirtyNodes)
+    {
+        index = newIndices[index];
+    }
+
+    _orderDirty = false;
+}
+
+uint32_t TransformHierarchy::LevelOf(uint32_t index) const
+{
+    return static_cast<uint32_t>(upper_bound(_levelStarts.begin(), _levelStarts.end(), index) - _levelStarts.begin()) - 1;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+//Local TRS and world matrices of a node tree, one array per component, ordered by depth so every node comes after
+//its parent and siblings sit next to each other. Update only recomputes nodes that were set since the last Update
+//and their subtrees, one depth level at a time, each level split across the JobSystem
+//Nodes are referred to by handles that stay valid while the arrays get reordered
+class TransformHierarchy
+{
+public:
+	constexpr static uint32_t INVALID_NODE = UINT32_MAX;
+
+	//parent is a handle from an earlier Add or INVALID_NODE for a root, the node's world matrix is valid after the next Update
+	uint32_t Add(uint32_t parent, const glm::vec3& position = glm::vec3(0.0f), const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		const glm::vec3& scale = glm::vec3(1.0f));
+	void Reserve(uint32_t count);
+	void Clear();
+
+	void SetLocal(uint32_t node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	void SetPosition(uint32_t node, const glm::vec3& position);
+	void SetRotation(uint32_t node, const glm::quat& rotation);
+	void SetScale(uint32_t node, const glm::vec3& scale);
+
+	const glm::vec3& GetPosition(uint32_t node) const { return _positions[_indices[node]]; }
+	const glm::quat& GetRotation(uint32_t node) const { return _rotations[_indices[node]]; }
+	const glm::vec3& GetScale(uint32_t node) const { return _scales[_indices[node]]; }
+	//as of the last Update
+	const glm::mat4& GetWorld(uint32_t node) const { return _worlds[_indices[node]]; }
+	uint32_t GetParent(uint32_t node) const;
+
+	//world matrices of every node set since the last Update and of everything below them
+	void Update();
+	//marks every node, for comparing against the dirty update
+	void MarkAllDirty();
+
+	uint32_t Count() const { return static_cast<uint32_t>(_handles.size()); }
+	uint32_t LevelCount() const { return _levelStarts.empty() ? 0 : static_cast<uint32_t>(_levelStarts.size() - 1); }
+	//nodes the last Update recomputed
+	uint32_t UpdatedCount() const { return _updatedCount; }
+
+	//dirty nodes per job, computing one world matrix is too little work to split finer
+	constexpr static size_t NODES_PER_JOB = 4096;
+
+private:
+	void MarkDirty(uint32_t index);
+	//breadth first reorder after Add, so levels are contiguous and children are contiguous within their level
+	void Rebuild();
+	uint32_t LevelOf(uint32_t index) const;
+
+	//indexed by position in depth order
+	std::vector<glm::vec3> _positions;
+	std::vector<glm::quat> _rotations;
+	std::vector<glm::vec3> _scales;
+	std::vector<glm::mat4> _worlds;
+	std::vector<uint32_t> _parents;
+	std::vector<uint32_t> _firstChildren;
+	std::vector<uint32_t> _childCounts;
+	//set while a node is queued for the next Update, so it is only queued once
+	std::vector<uint8_t> _dirty;
+	std::vector<uint32_t> _handles;
+
+	//handle to position
+	std::vector<uint32_t> _indices;
+	//level d is [_levelStarts[d], _levelStarts[d + 1])
+	std::vector<uint32_t> _levelStarts;
+	//Add appends to the end, Update puts the new nodes into their levels first
+	bool _orderDirty = false;
+
+	std::vector<uint32_t> _dirtyNodes;
+	std::vector<std::vector<uint32_t>> _levelDirtyNodes;
+	uint32_t _updatedCount = 0;
+};
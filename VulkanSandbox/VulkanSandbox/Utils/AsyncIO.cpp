@@ -0,0 +1,569 @@
+#include "AsyncIO.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+using namespace std;
+
+bool AsyncIO::File::IsOpen() const
+{
+#ifdef _WIN32
+    return handle != nullptr;
+#else
+    return handle >= 0;
+#endif
+}
+
+AsyncIO::AsyncIO(uint32_t queueDepth)
+{
+    queueDepth = std::max(queueDepth, 1u);
+
+    _slots.resize(queueDepth);
+    _freeSlots.reserve(queueDepth);
+
+    for (uint32_t i = queueDepth; i > 0; --i)
+    {
+        _freeSlots.push_back(i - 1);
+    }
+
+    if (InitRing(queueDepth))
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < FALLBACK_THREAD_COUNT; ++i)
+    {
+        _workers.emplace_back(&AsyncIO::WorkerLoop, this);
+    }
+}
+
+AsyncIO::~AsyncIO()
+{
+    //reads that never started can just be dropped, the ones in flight are writing into someone's buffer
+    _waiting.clear();
+
+    vector<Completion> ignored;
+
+    while (_inFlight > 0)
+    {
+        Reap(ignored, _inFlight);
+    }
+
+    {
+        scoped_lock lock(_workMutex);
+        _quit = true;
+    }
+
+    _workCondition.notify_all();
+
+    for (thread& worker : _workers)
+    {
+        worker.join();
+    }
+
+    DeInitRing();
+}
+
+bool AsyncIO::OpenFile(const filesystem::path& path, File& file)
+{
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(handle, &size))
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    file.handle = handle;
+    file.size = static_cast<uint64_t>(size.QuadPart);
+#else
+    const int handle = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (handle < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+
+    if (fstat(handle, &info) != 0)
+    {
+        close(handle);
+        return false;
+    }
+
+    file.handle = handle;
+    file.size = static_cast<uint64_t>(info.st_size);
+#endif
+
+    return true;
+}
+
+void AsyncIO::CloseFile(File& file)
+{
+    if (!file.IsOpen())
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    CloseHandle(file.handle);
+    file.handle = nullptr;
+#else
+    close(file.handle);
+    file.handle = -1;
+#endif
+
+    file.size = 0;
+}
+
+bool AsyncIO::RegisterBuffers(span<const span<char>> buffers)
+{
+#ifdef __linux__
+    if (!UsesIoUring())
+    {
+        return false;
+    }
+
+    if (!_registeredBuffers.empty())
+    {
+        syscall(__NR_io_uring_register, _ring.fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        _registeredBuffers.clear();
+    }
+
+    vector<iovec> iovecs(buffers.size());
+
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        iovecs[i] = { buffers[i].data(), buffers[i].size() };
+    }
+
+    if (syscall(__NR_io_uring_register, _ring.fd, IORING_REGISTER_BUFFERS, iovecs.data(), static_cast<unsigned>(iovecs.size())) != 0)
+    {
+        return false;
+    }
+
+    _registeredBuffers.assign(buffers.begin(), buffers.end());
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AsyncIO::Submit(span<const Read> reads)
+{
+    _waiting.insert(_waiting.end(), reads.begin(), reads.end());
+
+    Dispatch();
+}
+
+void AsyncIO::Reap(vector<Completion>& completions, uint32_t minCompletions)
+{
+    const size_t first = completions.size();
+    const size_t target = std::min<size_t>(minCompletions, _inFlight + _waiting.size());
+
+    while (true)
+    {
+        const bool wait = completions.size() - first < target;
+
+        if (UsesIoUring())
+        {
+            ReapRing(completions, wait);
+        }
+        else
+        {
+            vector<pair<uint32_t, int64_t>> done;
+
+            {
+                unique_lock lock(_workMutex);
+
+                if (wait)
+                {
+                    _doneCondition.wait(lock, [this]() { return !_workDone.empty(); });
+                }
+
+                done.swap(_workDone);
+            }
+
+            for (const auto& [slot, result] : done)
+            {
+                Advance(slot, result, completions);
+            }
+        }
+
+        //finished reads freed slots for whatever is waiting
+        Dispatch();
+
+        if (completions.size() - first >= target)
+        {
+            return;
+        }
+    }
+}
+
+void AsyncIO::Dispatch()
+{
+    while (!_waiting.empty() && !_freeSlots.empty())
+    {
+        const uint32_t slot = _freeSlots.back();
+        _freeSlots.pop_back();
+
+        _slots[slot] = { _waiting.front(), 0, true };
+        _waiting.pop_front();
+        _inFlight++;
+
+        Issue(slot);
+    }
+
+#ifdef __linux__
+    //everything queued since the last call goes to the kernel in one go
+    if (UsesIoUring() && _unsubmitted > 0)
+    {
+        const long submitted = syscall(__NR_io_uring_enter, _ring.fd, _unsubmitted, 0, 0, nullptr, 0);
+
+        if (submitted > 0)
+        {
+            _unsubmitted -= static_cast<uint32_t>(submitted);
+        }
+    }
+#endif
+}
+
+void AsyncIO::Issue(uint32_t slot)
+{
+    if (UsesIoUring())
+    {
+        PushToRing(slot);
+        return;
+    }
+
+    {
+        scoped_lock lock(_workMutex);
+        _workQueue.push_back(slot);
+    }
+
+    _workCondition.notify_one();
+}
+
+bool AsyncIO::Advance(uint32_t slot, int64_t result, vector<Completion>& completions)
+{
+    Slot& entry = _slots[slot];
+
+    if (result == -EINTR || result == -EAGAIN)
+    {
+        Issue(slot);
+        return false;
+    }
+
+    if (result > 0)
+    {
+        entry.done += static_cast<uint64_t>(result);
+
+        //a short read that isn't at the end of the file yet, go again for the rest
+        if (entry.done < entry.read.size)
+        {
+            Issue(slot);
+            return false;
+        }
+    }
+
+    completions.push_back({ entry.read.userData, result < 0 ? result : static_cast<int64_t>(entry.done) });
+
+    entry.used = false;
+    _freeSlots.push_back(slot);
+    _inFlight--;
+
+    return true;
+}
+
+void AsyncIO::WorkerLoop()
+{
+    while (true)
+    {
+        uint32_t slot;
+        Read read;
+        uint64_t done;
+
+        {
+            unique_lock lock(_workMutex);
+            _workCondition.wait(lock, [this]() { return _quit || !_workQueue.empty(); });
+
+            if (_workQueue.empty())
+            {
+                return;
+            }
+
+            slot = _workQueue.front();
+            _workQueue.pop_front();
+            read = _slots[slot].read;
+            done = _slots[slot].done;
+        }
+
+        int64_t result = 0;
+
+        while (done + result < read.size)
+        {
+            const uint64_t offset = read.offset + done + result;
+            const uint64_t size = std::min(read.size - done - result, MAX_READ_SIZE);
+            char* buffer = read.buffer + done + result;
+
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            DWORD bytesRead = 0;
+
+            if (!ReadFile(read.file.handle, buffer, static_cast<DWORD>(size), &bytesRead, &overlapped))
+            {
+                result = GetLastError() == ERROR_HANDLE_EOF ? result : -EIO;
+                break;
+            }
+
+            const int64_t count = bytesRead;
+#else
+            const int64_t count = pread(read.file.handle, buffer, size, static_cast<off_t>(offset));
+
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                result = -errno;
+                break;
+            }
+#endif
+
+            if (count == 0)
+            {
+                break;
+            }
+
+            result += count;
+        }
+
+        {
+            scoped_lock lock(_workMutex);
+            _workDone.push_back({ slot, result });
+        }
+
+        _doneCondition.notify_one();
+    }
+}
+
+#ifdef __linux__
+
+bool AsyncIO::InitRing(uint32_t queueDepth)
+{
+    io_uring_params params{};
+    const int fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    _ring.fd = fd;
+
+    //IORING_OP_READ and friends came with 5.6, which is also what added this flag
+    if (!(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        DeInitRing();
+        return false;
+    }
+
+    _ring.entries = params.sq_entries;
+    _ring.sqMapSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    _ring.cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+
+    if (singleMap)
+    {
+        _ring.sqMapSize = std::max(_ring.sqMapSize, _ring.cqMapSize);
+        _ring.cqMapSize = _ring.sqMapSize;
+    }
+
+    void* sqMap = mmap(nullptr, _ring.sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    _ring.sqMap = sqMap == MAP_FAILED ? nullptr : sqMap;
+
+    if (!_ring.sqMap)
+    {
+        DeInitRing();
+        return false;
+    }
+
+    if (singleMap)
+    {
+        _ring.cqMap = _ring.sqMap;
+    }
+    else
+    {
+        void* cqMap = mmap(nullptr, _ring.cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        _ring.cqMap = cqMap == MAP_FAILED ? nullptr : cqMap;
+    }
+
+    _ring.sqeMapSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqeMap = mmap(nullptr, _ring.sqeMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    _ring.sqeMap = sqeMap == MAP_FAILED ? nullptr : sqeMap;
+
+    if (!_ring.cqMap || !_ring.sqeMap)
+    {
+        DeInitRing();
+        return false;
+    }
+
+    char* sq = static_cast<char*>(_ring.sqMap);
+    char* cq = static_cast<char*>(_ring.cqMap);
+
+    _ring.sqHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+    _ring.sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    _ring.sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    _ring.sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+    _ring.cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    _ring.cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    _ring.cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    _ring.cqes = cq + params.cq_off.cqes;
+
+    return true;
+}
+
+void AsyncIO::DeInitRing()
+{
+    if (_ring.fd < 0)
+    {
+        return;
+    }
+
+    if (_ring.sqeMap)
+    {
+        munmap(_ring.sqeMap, _ring.sqeMapSize);
+    }
+
+    if (_ring.cqMap && _ring.cqMap != _ring.sqMap)
+    {
+        munmap(_ring.cqMap, _ring.cqMapSize);
+    }
+
+    if (_ring.sqMap)
+    {
+        munmap(_ring.sqMap, _ring.sqMapSize);
+    }
+
+    close(_ring.fd);
+    _ring = {};
+}
+
+void AsyncIO::PushToRing(uint32_t slot)
+{
+    const Slot& entry = _slots[slot];
+
+    //only this thread moves the tail, the kernel only reads it
+    const uint32_t tail = *_ring.sqTail;
+    const uint32_t index = tail & _ring.sqMask;
+
+    io_uring_sqe& sqe = static_cast<io_uring_sqe*>(_ring.sqeMap)[index];
+    memset(&sqe, 0, sizeof(sqe));
+
+    sqe.opcode = entry.read.registeredBuffer >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe.fd = entry.read.file.handle;
+    sqe.off = entry.read.offset + entry.done;
+    sqe.addr = reinterpret_cast<uint64_t>(entry.read.buffer + entry.done);
+    sqe.len = static_cast<uint32_t>(std::min(entry.read.size - entry.done, MAX_READ_SIZE));
+    sqe.user_data = slot;
+
+    if (entry.read.registeredBuffer >= 0)
+    {
+        sqe.buf_index = static_cast<uint16_t>(entry.read.registeredBuffer);
+    }
+
+    _ring.sqArray[index] = index;
+    atomic_ref<uint32_t>(*_ring.sqTail).store(tail + 1, memory_order_release);
+
+    _unsubmitted++;
+}
+
+void AsyncIO::ReapRing(vector<Completion>& completions, bool wait)
+{
+    uint32_t head = *_ring.cqHead;
+    uint32_t tail = atomic_ref<uint32_t>(*_ring.cqTail).load(memory_order_acquire);
+
+    if (wait && head == tail)
+    {
+        //submits whatever is still queued and sleeps until at least one read is back
+        const long submitted = syscall(__NR_io_uring_enter, _ring.fd, _unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+        if (submitted > 0)
+        {
+            _unsubmitted -= static_cast<uint32_t>(submitted);
+        }
+
+        tail = atomic_ref<uint32_t>(*_ring.cqTail).load(memory_order_acquire);
+    }
+
+    const io_uring_cqe* cqes = static_cast<const io_uring_cqe*>(_ring.cqes);
+
+    for (; head != tail; ++head)
+    {
+        const io_uring_cqe& cqe = cqes[head & _ring.cqMask];
+        const uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+        const int64_t result = cqe.res;
+
+        //hand the entry back before Advance can queue more
+        atomic_ref<uint32_t>(*_ring.cqHead).store(head + 1, memory_order_release);
+
+        Advance(slot, result, completions);
+    }
+}
+
+#else
+
+bool AsyncIO::InitRing(uint32_t queueDepth)
+{
+    return false;
+}
+
+void AsyncIO::DeInitRing()
+{
+}
+
+void AsyncIO::PushToRing(uint32_t slot)
+{
+}
+
+void AsyncIO::ReapRing(vector<Completion>& completions, bool wait)
+{
+}
+
+#endif
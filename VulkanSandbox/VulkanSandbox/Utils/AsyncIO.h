@@ -0,0 +1,137 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+//Request/completion file reads. On Linux every read queued between two Reaps goes to the kernel
+//through io_uring in one submission, elsewhere (or when the kernel refuses a ring) a few I/O threads do positional reads
+//One thread owns an AsyncIO, requests and completions are not synchronized beyond that
+class AsyncIO
+{
+public:
+	struct File
+	{
+#ifdef _WIN32
+		void* handle = nullptr;
+#else
+		int handle = -1;
+#endif
+		uint64_t size = 0;
+
+		bool IsOpen() const;
+	};
+
+	struct Read
+	{
+		File file;
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		char* buffer = nullptr;
+		//index into RegisterBuffers, buffer has to lie inside that buffer, -1 for any other memory
+		int32_t registeredBuffer = -1;
+		uint64_t userData = 0;
+	};
+
+	struct Completion
+	{
+		uint64_t userData;
+		//bytes read, short only at the end of the file, negative errno on failure
+		int64_t result;
+	};
+
+	explicit AsyncIO(uint32_t queueDepth = DEFAULT_QUEUE_DEPTH);
+	//waits for every read still in flight, their buffers may not go away before that
+	~AsyncIO();
+	AsyncIO(const AsyncIO&) = delete;
+	AsyncIO& operator=(const AsyncIO&) = delete;
+
+	static bool OpenFile(const std::filesystem::path& path, File& file);
+	static void CloseFile(File& file);
+
+	//pins the buffers with the kernel so reads into them skip mapping the pages on every read
+	//replaces any earlier registration, false without io_uring or if the kernel refuses, reads then just don't use it
+	bool RegisterBuffers(std::span<const std::span<char>> buffers);
+
+	//reads beyond the queue depth wait in order until Reap frees their slot
+	void Submit(std::span<const Read> reads);
+	//appends every finished read, blocking until at least minCompletions have finished
+	//minCompletions is capped at what is in flight, so it never waits for reads that weren't submitted
+	void Reap(std::vector<Completion>& completions, uint32_t minCompletions = 0);
+
+	uint32_t InFlight() const { return _inFlight; }
+	bool UsesIoUring() const { return _ring.fd >= 0; }
+
+	constexpr static uint32_t DEFAULT_QUEUE_DEPTH = 128;
+	//threads the fallback reads on, enough to keep an SSD's queue busy
+	constexpr static uint32_t FALLBACK_THREAD_COUNT = 4;
+	//a single kernel read is capped at this, bigger reads go in several pieces
+	constexpr static uint64_t MAX_READ_SIZE = 1ull << 30;
+
+private:
+	struct Slot
+	{
+		Read read;
+		uint64_t done = 0;
+		bool used = false;
+	};
+
+	//the ring's shared memory, pointers are into the kernel's mappings
+	struct Ring
+	{
+		int fd = -1;
+		uint32_t entries = 0;
+		void* sqMap = nullptr;
+		size_t sqMapSize = 0;
+		void* cqMap = nullptr;
+		size_t cqMapSize = 0;
+		void* sqeMap = nullptr;
+		size_t sqeMapSize = 0;
+
+		uint32_t* sqHead = nullptr;
+		uint32_t* sqTail = nullptr;
+		uint32_t sqMask = 0;
+		uint32_t* sqArray = nullptr;
+		uint32_t* cqHead = nullptr;
+		uint32_t* cqTail = nullptr;
+		uint32_t cqMask = 0;
+		void* cqes = nullptr;
+	};
+
+	bool InitRing(uint32_t queueDepth);
+	void DeInitRing();
+	//moves waiting reads into free slots and hands them to the ring or the I/O threads
+	void Dispatch();
+	//queues the rest of the slot's read on the ring or for the I/O threads
+	void Issue(uint32_t slot);
+	void PushToRing(uint32_t slot);
+	//with wait it sleeps until the kernel has finished at least one read
+	void ReapRing(std::vector<Completion>& completions, bool wait);
+	//records bytes read for the slot, true once the read is finished
+	bool Advance(uint32_t slot, int64_t result, std::vector<Completion>& completions);
+
+	void WorkerLoop();
+
+	std::vector<Slot> _slots;
+	std::vector<uint32_t> _freeSlots;
+	std::deque<Read> _waiting;
+	uint32_t _inFlight = 0;
+	//filled sqes not yet handed to the kernel
+	uint32_t _unsubmitted = 0;
+
+	Ring _ring;
+	std::vector<std::span<char>> _registeredBuffers;
+
+	//fallback
+	std::vector<std::thread> _workers;
+	std::deque<uint32_t> _workQueue;
+	std::vector<std::pair<uint32_t, int64_t>> _workDone;
+	std::mutex _workMutex;
+	std::condition_variable _workCondition;
+	std::condition_variable _doneCondition;
+	bool _quit = false;
+};
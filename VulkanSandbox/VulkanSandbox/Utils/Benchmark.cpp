@@ -0,0 +1,545 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <stb_image.h>
+
+#include "CLogger.h"
+#include "../Assets/Cooking/MipGenerator.h"
+#include "../Graphics/DrawList.h"
+#include "../Graphics/Graphics.h"
+#include "../Graphics/RenderGraph.h"
+#include "../Graphics/SphereCuller.h"
+#include "../Graphics/UploadBatch.h"
+#include "../Scene/TransformHierarchy.h"
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+using namespace std;
+using namespace glm;
+
+Benchmark::Result Benchmark::Time(string_view name, uint32_t iterations, const function<void()>& func)
+{
+    func();
+
+    vector<double> samples;
+    samples.reserve(iterations);
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        const auto start = chrono::steady_clock::now();
+        func();
+        samples.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+
+    return Report(name, move(samples));
+}
+
+Benchmark::Result Benchmark::Report(string_view name, vector<double> samplesMs)
+{
+    Assert(!samplesMs.empty(), "Benchmark has no samples!", { {"Benchmark", string(name)} });
+
+    sort(samplesMs.begin(), samplesMs.end());
+
+    const Result result{ samplesMs.front(), samplesMs[samplesMs.size() / 2] };
+
+    Log(name, { {"Min ms", result.minMs}, {"Median ms", result.medianMs}, {"Runs", samplesMs.size()} });
+
+    return result;
+}
+
+void Benchmark::RunAll()
+{
+    MipGeneration();
+    FrustumCulling();
+    TransformUpdate();
+    DrawListSort();
+    TransientAttachments();
+    QualityTiers();
+    RenderScales();
+    DepthPrepass();
+}
+
+void Benchmark::MipGeneration()
+{
+    const string path = "Data/Textures/statue-1275469_1920.jpg";
+
+    int width;
+    int height;
+    int channels;
+    stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+    Assert(pixels, "Could not load texture!", { {"Path", path} });
+
+    const MipImage image{ vector<uint8_t>(pixels, pixels + static_cast<size_t>(width) * height * 4),
+        static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+    stbi_image_free(pixels);
+
+    Log("Mip generation benchmark", { {"Texture", path}, {"Width", width}, {"Height", height}, {"Mip count", MipGenerator::MipCount(image.width, image.height)} });
+
+    for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser })
+    {
+        const string filterName = filter == MipFilter::Box ? "box" : "kaiser";
+
+        Time("CPU mips, " + filterName + ", scalar", ITERATIONS, [&]() { MipGenerator::Generate(image, filter, MipColorSpace::Srgb, false); });
+        Time("CPU mips, " + filterName + ", simd", ITERATIONS, [&]() { MipGenerator::Generate(image, filter, MipColorSpace::Srgb, true); });
+
+        //both paths do the same math, only float rounding may differ
+        const vector<MipImage> scalar = MipGenerator::Generate(image, filter, MipColorSpace::Srgb, false);
+        const vector<MipImage> simd = MipGenerator::Generate(image, filter, MipColorSpace::Srgb, true);
+        int maxDifference = 0;
+
+        for (size_t mip = 0; mip < scalar.size(); ++mip)
+        {
+            for (size_t i = 0; i < scalar[mip].rgba.size(); ++i)
+            {
+                maxDifference = std::max(maxDifference, abs(scalar[mip].rgba[i] - simd[mip].rgba[i]));
+            }
+        }
+
+        Log("Scalar and simd mips compared", { {"Filter", filterName}, {"Max difference", maxDifference} });
+    }
+
+    vector<double> blitSamples = TimeMipBlits(image, ITERATIONS);
+
+    if (blitSamples.empty())
+    {
+        Log("Graphics queue has no timestamps, skipping the blit benchmark");
+        return;
+    }
+
+    //GPU time only, the CPU numbers above include getting the data in and out of float
+    Report("GPU blit mips", move(blitSamples));
+}
+
+vector<double> Benchmark::TimeMipBlits(const MipImage& image, uint32_t iterations)
+{
+    const vector<vk::QueueFamilyProperties> queueFamilies = Graphics::_physicalDevice.getQueueFamilyProperties();
+
+    if (queueFamilies[Graphics::_queueFamilyIndices.graphicsFamily.value()].timestampValidBits == 0)
+    {
+        return {};
+    }
+
+    const double timestampPeriod = Graphics::_physicalDevice.getProperties().limits.timestampPeriod;
+    const uint32_t mipLevels = MipGenerator::MipCount(image.width, image.height);
+    const vk::Format format = vk::Format::eR8G8B8A8Srgb;
+
+    vk::QueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.queryType = vk::QueryType::eTimestamp;
+    queryPoolInfo.queryCount = 2;
+
+    vk::QueryPool queryPool;
+    vk::Result result = Graphics::_device.createQueryPool(&queryPoolInfo, nullptr, &queryPool);
+    Assert(result == vk::Result::eSuccess, "Failed to create query pool!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+    vector<double> samples;
+
+    //the first run is a warm up
+    for (uint32_t i = 0; i <= iterations; ++i)
+    {
+        vk::Image mipImage;
+        VmaAllocation mipImageMemory;
+        Graphics::CreateImage(image.width, image.height, mipLevels, vk::SampleCountFlagBits::e1, format,
+            vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            mipImage, mipImageMemory);
+
+        //getting mip 0 in isn't part of the timing
+        {
+            UploadBatch batch;
+            vk::Buffer stagingBuffer = batch.Stage(image.rgba.data(), image.rgba.size());
+            vk::CommandBuffer commandBuffer = batch.GetCommandBuffer();
+
+            Graphics::TransitionImageLayout(commandBuffer, mipImage, format, mipLevels,
+                vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+            Graphics::CopyBufferToImage(commandBuffer, stagingBuffer, mipImage, image.width, image.height);
+
+            batch.Submit();
+        }
+
+        vk::CommandBuffer commandBuffer = Graphics::BeginSingleTimeCommands();
+        commandBuffer.resetQueryPool(queryPool, 0, 2);
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool, 0);
+        Graphics::GenerateMipmaps(commandBuffer, mipImage, format, static_cast<int32_t>(image.width), static_cast<int32_t>(image.height), mipLevels);
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 1);
+        Graphics::EndSingleTimeCommands(commandBuffer);
+
+        uint64_t timestamps[2];
+        result = Graphics::_device.getQueryPoolResults(queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+            vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+        Assert(result == vk::Result::eSuccess, "Failed to read timestamps!", { {"Error Code", static_cast<uint32_t>(result)} });
+
+        vmaDestroyImage(Graphics::_allocator, mipImage, mipImageMemory);
+
+        if (i > 0)
+        {
+            samples.push_back((timestamps[1] - timestamps[0]) * timestampPeriod / 1e6);
+        }
+    }
+
+    Graphics::_device.destroyQueryPool(queryPool, nullptr);
+
+    return samples;
+}
+
+void Benchmark::FrustumCulling()
+{
+    //the camera UpdateUniformBuffer uses, the spheres fill a box far bigger than what it sees
+    const mat4 view = lookAt(vec3(2.0f, 2.0f, 2.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f));
+    const mat4 proj = perspective(radians(45.0f), 16.0f / 9.0f, 0.1f, 10.0f);
+    const Frustum frustum = Frustum::FromMatrix(proj * view);
+
+    mt19937 random(1234);
+    uniform_real_distribution<float> position(-10.0f, 10.0f);
+    uniform_real_distribution<float> radius(0.05f, 0.5f);
+
+    for (uint32_t count : CULL_COUNTS)
+    {
+        SphereCuller culler;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            culler.Add(vec3(position(random), position(random), position(random)), radius(random));
+        }
+
+        vector<uint32_t> scalarVisible;
+        vector<uint32_t> simdVisible;
+        const string name = "Frustum culling, " + to_string(count) + " spheres";
+
+        Time(name + ", scalar", ITERATIONS, [&]() { culler.Cull(frustum, scalarVisible, false); });
+        Time(name + ", simd", ITERATIONS, [&]() { culler.Cull(frustum, simdVisible, true); });
+
+        //fma in the simd path can only flip spheres that touch a plane within rounding
+        Log("Scalar and simd culling compared", { {"Spheres", count}, {"Scalar visible", scalarVisible.size()},
+            {"Simd visible", simdVisible.size()}, {"Same list", scalarVisible == simdVisible} });
+    }
+}
+
+void Benchmark::TransformUpdate()
+{
+    mt19937 random(1234);
+    uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    TransformHierarchy hierarchy;
+    hierarchy.Reserve(TRANSFORM_NODES);
+
+    //a few roots, then every node hangs off a random earlier one, which gives a deep and uneven tree
+    for (uint32_t i = 0; i < TRANSFORM_NODES; ++i)
+    {
+        const uint32_t parent = i < 64 ? TransformHierarchy::INVALID_NODE : random() % i;
+
+        hierarchy.Add(parent, vec3(offset(random), offset(random), offset(random)), angleAxis(offset(random), vec3(0.0f, 0.0f, 1.0f)));
+    }
+
+    hierarchy.Update();
+
+    const uint32_t movingCount = TRANSFORM_NODES / 100 * MOVING_NODES_PERCENT;
+    uint64_t updatedCount = 0;
+    uint32_t runs = 0;
+
+    Time("Transform update, " + to_string(MOVING_NODES_PERCENT) + "% moving", ITERATIONS, [&]()
+        {
+            for (uint32_t i = 0; i < movingCount; ++i)
+            {
+                hierarchy.SetPosition(random() % TRANSFORM_NODES, vec3(offset(random), offset(random), offset(random)));
+            }
+
+            hierarchy.Update();
+            updatedCount += hierarchy.UpdatedCount();
+            ++runs;
+        });
+
+    Time("Transform update, all nodes", ITERATIONS, [&]()
+        {
+            hierarchy.MarkAllDirty();
+            hierarchy.Update();
+        });
+
+    //moving a node moves its subtree, so more nodes get recomputed than were set
+    Log("Transform hierarchy", { {"Nodes", TRANSFORM_NODES}, {"Levels", hierarchy.LevelCount()}, {"Set per run", movingCount},
+        {"Recomputed per run", updatedCount / runs} });
+}
+
+void Benchmark::DrawListSort()
+{
+    constexpr uint32_t PIPELINE_COUNT = 8;
+    constexpr uint32_t MATERIAL_COUNT = 256;
+    constexpr uint32_t MESH_COUNT = 1024;
+
+    //the handles are never given to Vulkan, the draw list only compares them
+    auto fakeHandle = []<typename T>(T, uint64_t id) { return T(reinterpret_cast<typename T::CType>(id + 1)); };
+
+    vector<unique_ptr<Model>> meshes;
+
+    for (uint32_t i = 0; i < MESH_COUNT; ++i)
+    {
+        meshes.push_back(make_unique<Model>(""));
+    }
+
+    mt19937 random(1234);
+    uniform_real_distribution<float> depth(0.0f, 1.0f);
+    vector<pair<uint64_t, DrawList::Draw>> draws;
+    draws.reserve(DRAW_LIST_COUNT);
+
+    for (uint32_t i = 0; i < DRAW_LIST_COUNT; ++i)
+    {
+        const uint32_t pipeline = random() % PIPELINE_COUNT;
+        const uint32_t material = random() % MATERIAL_COUNT;
+        const uint32_t mesh = random() % MESH_COUNT;
+
+        DrawList::Draw draw{};
+        draw.pipeline = fakeHandle(vk::Pipeline(), pipeline);
+        draw.descriptorSet = fakeHandle(vk::DescriptorSet(), material);
+        draw.model = meshes[mesh].get();
+        draw.instanceBuffer = fakeHandle(vk::Buffer(), 0);
+        draw.instanceCount = 1;
+
+        draws.emplace_back(DrawList::MakeKey(0, pipeline, material, mesh, DrawList::QuantizeDepth(depth(random))), draw);
+    }
+
+    DrawList drawList;
+    drawList.Reserve(DRAW_LIST_COUNT);
+
+    auto fill = [&](bool sortKeys)
+        {
+            drawList.Clear();
+
+            for (const auto& [key, draw] : draws)
+            {
+                //one key for everything leaves the draws in submission order
+                drawList.Add(sortKeys ? key : 0, draw);
+            }
+        };
+
+    fill(false);
+    drawList.CountStateChanges(0);
+    const uint32_t unsortedChanges = drawList.GetStats().StateChanges();
+
+    vector<double> samples;
+
+    for (uint32_t i = 0; i < ITERATIONS; ++i)
+    {
+        fill(true);
+        drawList.Sort();
+        samples.push_back(drawList.GetStats().sortMs);
+    }
+
+    Report("Draw list radix sort, " + to_string(DRAW_LIST_COUNT) + " draws", move(samples));
+
+    drawList.CountStateChanges(0);
+    const DrawList::Stats& stats = drawList.GetStats();
+
+    Log("Draw list state changes", { {"Draws", stats.draws}, {"Unsorted", unsortedChanges}, {"Sorted", stats.StateChanges()},
+        {"Pipeline binds", stats.pipelineBinds}, {"Descriptor set binds", stats.descriptorSetBinds},
+        {"Vertex buffer binds", stats.vertexBufferBinds}, {"Index buffer binds", stats.indexBufferBinds},
+        {"Keys ordered", is_sorted(drawList.GetKeys().begin(), drawList.GetKeys().end())} });
+}
+
+void Benchmark::TransientAttachments()
+{
+    const vk::Extent2D extent{ REPORT_WIDTH, REPORT_HEIGHT };
+    const vk::Format depthFormat = Graphics::FindDepthFormat();
+    vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+
+    for (uint32_t tier = 0; tier < Graphics::QUALITY_COUNT; tier++)
+    {
+        if (Graphics::SupportsQuality(static_cast<Graphics::QualityTier>(tier)))
+        {
+            samples = std::max(samples, Graphics::GetQualitySettings(static_cast<Graphics::QualityTier>(tier)).samples);
+        }
+    }
+
+    //stands in for the scene color image the frame resolves into
+    vk::Image resolveImage;
+    VmaAllocation resolveImageMemory;
+    Graphics::CreateImage(extent.width, extent.height, 1, vk::SampleCountFlagBits::e1, Graphics::_swapChainImageFormat, vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eColorAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, resolveImage, resolveImageMemory);
+
+    auto report = [&](string_view name, bool occlusionCulling)
+        {
+            RenderGraph graph;
+            const uint32_t resolve = graph.ImportImage("Resolve", resolveImage, vk::ImageAspectFlagBits::eColor, 1, RenderGraph::ACCESS_NONE);
+            graph.Export(resolve, RenderGraph::ACCESS_COLOR_ATTACHMENT);
+
+            const uint32_t color = graph.CreateImage("Color", { Graphics::_swapChainImageFormat, extent, 1, samples,
+                vk::ImageUsageFlagBits::eColorAttachment });
+            //the depth pyramid samples it between the passes
+            const uint32_t depth = graph.CreateImage("Depth", { depthFormat, extent, 1, samples,
+                vk::ImageUsageFlagBits::eDepthStencilAttachment | (occlusionCulling ? vk::ImageUsageFlagBits::eSampled : vk::ImageUsageFlags{}),
+                Graphics::GetImageAspect(depthFormat) });
+
+            //the frame's passes without their work, the graph only looks at what they declare
+            auto writeTargets = [&](string_view passName, bool clear)
+                {
+                    const uint32_t pass = graph.AddPass(passName, [](vk::CommandBuffer) {});
+                    graph.Write(pass, color, RenderGraph::ACCESS_COLOR_ATTACHMENT, clear);
+                    graph.Write(pass, depth, RenderGraph::ACCESS_DEPTH_ATTACHMENT, clear);
+                    graph.Write(pass, resolve, RenderGraph::ACCESS_COLOR_ATTACHMENT, true);
+                };
+
+            if (occlusionCulling)
+            {
+                writeTargets("Draw previously visible", true);
+
+                const uint32_t pyramid = graph.AddPass("Depth pyramid", [](vk::CommandBuffer) {});
+                graph.Read(pyramid, depth, RenderGraph::ACCESS_COMPUTE_SAMPLED);
+                graph.SetSideEffects(pyramid);
+
+                writeTargets("Draw newly visible", false);
+            }
+            else
+            {
+                writeTargets("Scene", true);
+            }
+
+            vk::CommandBuffer commandBuffer = Graphics::BeginSingleTimeCommands();
+            graph.Execute(commandBuffer);
+            Graphics::EndSingleTimeCommands(commandBuffer);
+
+            const RenderGraph::Stats& stats = graph.GetStats();
+            constexpr double MIB = 1024.0 * 1024.0;
+
+            //lazily allocated memory counts as saved, it only gets backed if the GPU can't keep the attachment on chip
+            Log(name, { {"Samples", static_cast<uint32_t>(samples)}, {"Lazily allocated memory", Graphics::_lazilyAllocatedSupported},
+                {"Separate MiB", stats.transientBytes / MIB}, {"Aliased MiB", stats.aliasedBytes / MIB}, {"Lazily allocated MiB", stats.lazyBytes / MIB},
+                {"Saved MiB", (stats.transientBytes - stats.aliasedBytes) / MIB} });
+
+            graph.DestroyTransients();
+        };
+
+    const string resolution = to_string(REPORT_WIDTH) + "x" + to_string(REPORT_HEIGHT);
+    report("Transient attachments at " + resolution + ", CPU culling", false);
+    report("Transient attachments at " + resolution + ", GPU occlusion culling", true);
+
+    vmaDestroyImage(Graphics::_allocator, resolveImage, resolveImageMemory);
+}
+
+void Benchmark::QualityTiers()
+{
+    if (!Graphics::_frameTimestamps)
+    {
+        Log("Graphics queue has no timestamps, skipping the quality tier benchmark");
+        return;
+    }
+
+    const Graphics::QualityTier startTier = Graphics::_quality;
+    const bool dynamicResolution = Graphics::_dynamicResolution;
+    const string resolution = to_string(Graphics::_swapChainExtent.width) + "x" + to_string(Graphics::_swapChainExtent.height);
+
+    //every tier at the same resolution
+    Graphics::_dynamicResolution = false;
+    Graphics::SetRenderScale(1.0f);
+
+    for (uint32_t i = 0; i < Graphics::QUALITY_COUNT; i++)
+    {
+        const Graphics::QualityTier tier = static_cast<Graphics::QualityTier>(i);
+        const Graphics::QualitySettings settings = Graphics::GetQualitySettings(tier);
+
+        if (!Graphics::SupportsQuality(tier))
+        {
+            Log("Quality tier isn't supported, skipping it", { {"Tier", settings.name} });
+            continue;
+        }
+
+        Graphics::SetQuality(tier);
+        Report("Frame GPU time, " + string(settings.name) + ", " + resolution, TimeFrames(QUALITY_WARMUP_FRAMES, QUALITY_FRAMES));
+    }
+
+    Graphics::SetQuality(startTier);
+    Graphics::_dynamicResolution = dynamicResolution;
+}
+
+void Benchmark::RenderScales()
+{
+    if (!Graphics::_frameTimestamps)
+    {
+        Log("Graphics queue has no timestamps, skipping the render scale benchmark");
+        return;
+    }
+
+    const bool dynamicResolution = Graphics::_dynamicResolution;
+    const float startScale = Graphics::_renderScale;
+    Graphics::_dynamicResolution = false;
+
+    for (float scale : RENDER_SCALES)
+    {
+        Graphics::SetRenderScale(scale);
+        const string resolution = to_string(Graphics::_renderExtent.width) + "x" + to_string(Graphics::_renderExtent.height);
+
+        //the warmup frames cover the ones still in flight at the last scale
+        Report("Frame GPU time, render scale " + to_string(scale) + ", " + resolution + " upscaled, "
+            + Graphics::GetQualitySettings(Graphics::_quality).name, TimeFrames(QUALITY_WARMUP_FRAMES, QUALITY_FRAMES));
+    }
+
+    Graphics::SetRenderScale(startScale);
+    Graphics::_dynamicResolution = dynamicResolution;
+}
+
+void Benchmark::DepthPrepass()
+{
+    if (!Graphics::_frameTimestamps)
+    {
+        Log("Graphics queue has no timestamps, skipping the depth prepass benchmark");
+        return;
+    }
+
+    const bool dynamicResolution = Graphics::_dynamicResolution;
+    const bool depthPrepass = Graphics::_depthPrepass;
+    const string quality = Graphics::GetQualitySettings(Graphics::_quality).name;
+
+    //both sides at the same resolution
+    Graphics::_dynamicResolution = false;
+    Graphics::SetRenderScale(1.0f);
+
+    //the default camera looks at the origin from (2, 2, 2)
+    const vec3 away = normalize(vec3(-1.0f));
+
+    for (uint32_t layers : PREPASS_LAYERS)
+    {
+        vector<Model::Instance> instances(layers);
+
+        for (uint32_t i = 0; i < layers; i++)
+        {
+            instances[i].transform = rotate(translate(mat4(1.0f), away * (PREPASS_LAYER_SPACING * i)),
+                radians(PREPASS_LAYER_TURN_DEGREES * i), vec3(0.0f, 0.0f, 1.0f));
+        }
+
+        Graphics::SetInstances(instances);
+
+        for (bool enabled : { false, true })
+        {
+            Graphics::SetDepthPrepass(enabled);
+            Report("Frame GPU time, " + to_string(layers) + " layers, depth prepass " + (enabled ? "on" : "off") + ", " + quality,
+                TimeFrames(QUALITY_WARMUP_FRAMES, QUALITY_FRAMES));
+        }
+    }
+
+    //what Graphics::Init starts with
+    const Model::Instance instance{};
+    Graphics::SetInstances({ &instance, 1 });
+    Graphics::SetDepthPrepass(depthPrepass);
+    Graphics::_dynamicResolution = dynamicResolution;
+}
+
+vector<double> Benchmark::TimeFrames(uint32_t warmup, uint32_t frames)
+{
+    vector<double> samples;
+
+    for (uint32_t frame = 0; frame < warmup + frames; frame++)
+    {
+        Graphics::DrawFrame();
+
+        if (frame >= warmup)
+        {
+            samples.push_back(Graphics::_gpuFrameMs);
+        }
+    }
+
+    return samples;
+}
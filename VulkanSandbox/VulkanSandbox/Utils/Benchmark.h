@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+struct MipImage;
+
+//Timing harness for the --bench run, every result is logged with its fastest and median run
+//The median is the one to compare, the fastest shows how much of it is noise
+class Benchmark
+{
+public:
+	struct Result
+	{
+		double minMs;
+		double medianMs;
+	};
+
+	//runs func once to warm caches and allocators, then times iterations runs of it
+	static Result Time(std::string_view name, uint32_t iterations, const std::function<void()>& func);
+	//for timings taken somewhere else, like GPU timestamps
+	static Result Report(std::string_view name, std::vector<double> samplesMs);
+
+	//main calls this instead of the render loop when started with --bench, after Graphics::Init
+	static void RunAll();
+
+	constexpr static uint32_t ITERATIONS = 10;
+
+private:
+	//CPU mip chains against the GPU blit chain on the biggest texture we ship
+	static void MipGeneration();
+	//GenerateMipmaps timed with timestamp queries, empty if the graphics queue can't write timestamps
+	static std::vector<double> TimeMipBlits(const MipImage& image, uint32_t iterations);
+	//SphereCuller scalar against AVX2 on random spheres around the default camera, at each of CULL_COUNTS
+	static void FrustumCulling();
+	//TransformHierarchy::Update on a random tree with MOVING_NODES_PERCENT of the nodes set each run, against updating all of them
+	static void TransformUpdate();
+	//DrawList::Sort on DRAW_LIST_COUNT random draws, and the state changes recording them takes sorted against submission order
+	static void DrawListSort();
+	//the scene's color and depth buffers as render graph transients at REPORT_WIDTH x REPORT_HEIGHT with the most MSAA the device has,
+	//for both frame paths, and how much memory lazy allocation and aliasing save over giving each its own
+	static void TransientAttachments();
+	//GPU frame time of the default scene at every quality tier the device supports, QUALITY_FRAMES frames each
+	static void QualityTiers();
+	//GPU frame time at each of RENDER_SCALES with the controller off, what the dynamic resolution controller trades against
+	static void RenderScales();
+	//GPU frame time with and without the depth prepass, for each of PREPASS_LAYERS copies of the model stacked behind each
+	//other along the view direction, more layers is more overdraw the prepass can save shading for
+	static void DepthPrepass();
+	//draws warmup + frames frames and returns the GPU time of the last frames, Graphics has to have frame timestamps
+	static std::vector<double> TimeFrames(uint32_t warmup, uint32_t frames);
+
+	constexpr static uint32_t CULL_COUNTS[] = { 10'000, 100'000, 1'000'000 };
+	constexpr static uint32_t TRANSFORM_NODES = 1'000'000;
+	constexpr static uint32_t MOVING_NODES_PERCENT = 1;
+	constexpr static uint32_t DRAW_LIST_COUNT = 100'000;
+	constexpr static uint32_t REPORT_WIDTH = 3840;
+	constexpr static uint32_t REPORT_HEIGHT = 2160;
+	//dropped after each switch, they still include frames of the previous tier and the new pipeline's first uses
+	constexpr static uint32_t QUALITY_WARMUP_FRAMES = 10;
+	constexpr static uint32_t QUALITY_FRAMES = 100;
+	constexpr static float RENDER_SCALES[] = { 1.0f, 0.85f, 0.7f, 0.5f };
+	constexpr static uint32_t PREPASS_LAYERS[] = { 1, 8, 32 };
+	//distance between the layers, each is also turned a little so the ones behind stay partly visible
+	constexpr static float PREPASS_LAYER_SPACING = 0.15f;
+	constexpr static float PREPASS_LAYER_TURN_DEGREES = 10.0f;
+};
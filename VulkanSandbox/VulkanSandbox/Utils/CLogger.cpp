@@ -1,5 +1,6 @@
 #include "CLogger.h"
 #include <iostream>
+#include <mutex>
 
 using namespace std;
 const std::size_t CLogger::MAX_LINES = 128;
@@ -7,6 +8,8 @@ std::vector<CLogger::Line> CLogger::_lineBuf(MAX_LINES);
 int CLogger::_lineEnd = 0;
 size_t CLogger::_numLines = 0;
 constexpr bool DIRECT_TO_STDOUT = true;
+//jobs log from worker threads, so the console and the line buffer are both guarded
+static mutex logMutex;
 
 string FormatForStream(const string_view msg, vector<CLogPair> &tags, source_location &loc)
 {
@@ -38,6 +41,7 @@ void Log(string_view msg, vector<CLogPair> &&tags, source_location loc)
 	{
 		const string line(move(FormatForStream(msg, tags, loc)));
 
+		scoped_lock lock(logMutex);
 		cout << line << std::endl;
 	}
 
@@ -50,6 +54,7 @@ void Error(std::string_view msg, std::vector<CLogPair> &&tags, std::source_locat
 	{
 		const string line(move(FormatForStream(msg, tags, loc)));
 
+		scoped_lock lock(logMutex);
 		cerr << "ERROR " << line << std::endl;
 	}
 
@@ -64,6 +69,7 @@ void Assert(bool condition, std::string_view msg, std::vector<CLogPair> &&tags,
 		{
 			const string line(move(FormatForStream(msg, tags, loc)));
 
+			scoped_lock lock(logMutex);
 			cerr << "ASSERTION FAILED " << line << std::endl;
 		}
 
@@ -75,6 +81,8 @@ void Assert(bool condition, std::string_view msg, std::vector<CLogPair> &&tags,
 
 void CLogger::AddLine(Line&& line)
 {
+	scoped_lock lock(logMutex);
+
 	_lineBuf[_lineEnd] = move(line);
 
 	_lineEnd = (_lineEnd + 1) % _lineBuf.size();
@@ -0,0 +1,184 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if (_fd >= 0)
+    {
+        close(_fd);
+    }
+#endif
+}
+
+bool FileWatcher::Watch(const filesystem::path& root)
+{
+    if (!filesystem::is_directory(root))
+    {
+        return false;
+    }
+
+#ifdef __linux__
+    if (_fd < 0)
+    {
+        return false;
+    }
+#else
+    _roots.push_back(root);
+#endif
+
+    WatchDirectory(root);
+
+    for (const filesystem::directory_entry& entryIt : filesystem::recursive_directory_iterator(root))
+    {
+        if (entryIt.is_directory())
+        {
+            WatchDirectory(entryIt.path());
+        }
+    }
+
+    return true;
+}
+
+#ifdef __linux__
+
+void FileWatcher::WatchDirectory(const filesystem::path& dir)
+{
+    //close write rather than modify, so a file is reported once when the writer is done with it
+    //moved to catches editors that save to a temp file and rename it over the original
+    const int wd = inotify_add_watch(_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+
+    if (wd >= 0)
+    {
+        _watches[wd] = dir;
+    }
+}
+
+void FileWatcher::Poll(vector<filesystem::path>& changed)
+{
+    if (_fd < 0)
+    {
+        return;
+    }
+
+    const size_t first = changed.size();
+    alignas(inotify_event) char buffer[16 * 1024];
+
+    while (true)
+    {
+        const ssize_t size = read(_fd, buffer, sizeof(buffer));
+
+        if (size <= 0)
+        {
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < size;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            auto it = _watches.find(event->wd);
+
+            if (it == _watches.end() || event->len == 0)
+            {
+                continue;
+            }
+
+            const filesystem::path path = (it->second / event->name).lexically_normal();
+
+            if (event->mask & IN_ISDIR)
+            {
+                //files copied in along with a new directory can land before the watch does, report what's already there
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    Watch(path);
+
+                    for (const filesystem::directory_entry& entryIt : filesystem::recursive_directory_iterator(path))
+                    {
+                        if (entryIt.is_regular_file())
+                        {
+                            changed.push_back(entryIt.path().lexically_normal());
+                        }
+                    }
+                }
+
+                continue;
+            }
+
+            if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            {
+                changed.push_back(path);
+            }
+        }
+    }
+
+    //saving once can close the file more than once
+    sort(changed.begin() + first, changed.end());
+    changed.erase(unique(changed.begin() + first, changed.end()), changed.end());
+}
+
+#else
+
+void FileWatcher::WatchDirectory(const filesystem::path& dir)
+{
+    for (const filesystem::directory_entry& entryIt : filesystem::directory_iterator(dir))
+    {
+        if (entryIt.is_regular_file())
+        {
+            _writeTimes[entryIt.path().generic_string()] = entryIt.last_write_time();
+        }
+    }
+}
+
+void FileWatcher::Poll(vector<filesystem::path>& changed)
+{
+    const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+    if (now - _lastScan < POLL_INTERVAL)
+    {
+        return;
+    }
+
+    _lastScan = now;
+
+    for (const filesystem::path& root : _roots)
+    {
+        error_code error;
+
+        for (const filesystem::directory_entry& entryIt : filesystem::recursive_directory_iterator(root, error))
+        {
+            if (!entryIt.is_regular_file())
+            {
+                continue;
+            }
+
+            const filesystem::file_time_type writeTime = entryIt.last_write_time();
+            auto [it, inserted] = _writeTimes.try_emplace(entryIt.path().generic_string(), writeTime);
+
+            if (inserted || it->second != writeTime)
+            {
+                it->second = writeTime;
+                changed.push_back(entryIt.path().lexically_normal());
+            }
+        }
+    }
+}
+
+#endif
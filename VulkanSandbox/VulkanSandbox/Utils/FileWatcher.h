@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Reports files that were written under a set of directories. Uses inotify on Linux,
+//elsewhere the watched trees get rescanned for newer write times every POLL_INTERVAL
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	//watches root and every directory under it, directories created later get picked up too
+	bool Watch(const std::filesystem::path& root);
+	//never blocks, appends every file finished writing since the last call once each
+	void Poll(std::vector<std::filesystem::path>& changed);
+
+	constexpr static std::chrono::milliseconds POLL_INTERVAL{ 500 };
+
+private:
+	void WatchDirectory(const std::filesystem::path& dir);
+
+#ifdef __linux__
+	int _fd = -1;
+	//watch descriptor to the directory it watches
+	std::unordered_map<int, std::filesystem::path> _watches;
+#else
+	std::vector<std::filesystem::path> _roots;
+	//generic path to write time at the last scan
+	std::unordered_map<std::string, std::filesystem::file_time_type> _writeTimes;
+	std::chrono::steady_clock::time_point _lastScan;
+#endif
+};
@@ -0,0 +1,168 @@
+#include "JobSystem.h"
+#include "CLogger.h"
+
+#include <algorithm>
+
+using namespace std;
+
+void JobSystem::Init(uint32_t threadCount)
+{
+    Assert(_workers.empty(), "Job system initialized twice!");
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    _quit = false;
+    _workers.reserve(threadCount);
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        _workers.emplace_back(WorkerLoop);
+    }
+
+    Log("Started job system", { {"Worker threads", threadCount} });
+}
+
+void JobSystem::DeInit()
+{
+    {
+        scoped_lock lock(_queueMutex);
+        _quit = true;
+    }
+
+    _queueCondition.notify_all();
+
+    for (thread& worker : _workers)
+    {
+        worker.join();
+    }
+
+    _workers.clear();
+}
+
+void JobSystem::Submit(function<void()> job, JobCounter& counter)
+{
+    counter._pending.fetch_add(1, memory_order_relaxed);
+
+    //no workers means nobody else will ever run it
+    if (_workers.empty())
+    {
+        Job inlineJob{ move(job), &counter };
+        RunJob(inlineJob);
+        return;
+    }
+
+    {
+        scoped_lock lock(_queueMutex);
+        _queue.push_back({ move(job), &counter });
+    }
+
+    _queueCondition.notify_one();
+    //a thread in Wait helps run it rather than sleeping until its own counter is done
+    _doneCondition.notify_all();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    while (!counter.Done())
+    {
+        if (TryRunJob())
+        {
+            continue;
+        }
+
+        //everything left is already running on a worker
+        unique_lock lock(_queueMutex);
+        _doneCondition.wait(lock, [&counter]() { return counter.Done() || !_queue.empty(); });
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t chunkSize, const function<void(size_t begin, size_t end)>& func)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    chunkSize = std::max<size_t>(chunkSize, 1);
+
+    //one chunk is quicker to just run here
+    if (count <= chunkSize)
+    {
+        func(0, count);
+        return;
+    }
+
+    JobCounter counter;
+
+    for (size_t begin = 0; begin < count; begin += chunkSize)
+    {
+        const size_t end = std::min(begin + chunkSize, count);
+        Submit([&func, begin, end]() { func(begin, end); }, counter);
+    }
+
+    Wait(counter);
+}
+
+uint32_t JobSystem::WorkerCount()
+{
+    return static_cast<uint32_t>(_workers.size());
+}
+
+void JobSystem::WorkerLoop()
+{
+    while (true)
+    {
+        Job job;
+
+        {
+            unique_lock lock(_queueMutex);
+            _queueCondition.wait(lock, []() { return _quit || !_queue.empty(); });
+
+            if (_queue.empty())
+            {
+                return;
+            }
+
+            job = move(_queue.front());
+            _queue.pop_front();
+        }
+
+        RunJob(job);
+    }
+}
+
+bool JobSystem::TryRunJob()
+{
+    Job job;
+
+    {
+        scoped_lock lock(_queueMutex);
+
+        if (_queue.empty())
+        {
+            return false;
+        }
+
+        job = move(_queue.front());
+        _queue.pop_front();
+    }
+
+    RunJob(job);
+
+    return true;
+}
+
+void JobSystem::RunJob(Job& job)
+{
+    job.func();
+
+    if (job.counter->_pending.fetch_sub(1, memory_order_acq_rel) == 1)
+    {
+        //take the lock so a waiter can't miss the notify between its check and its wait
+        scoped_lock lock(_queueMutex);
+        _doneCondition.notify_all();
+    }
+}
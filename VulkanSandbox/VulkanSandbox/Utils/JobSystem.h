@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//counts outstanding jobs, Wait on it to block until every job submitted with it has run
+class JobCounter
+{
+public:
+	bool Done() const { return _pending.load(std::memory_order_acquire) == 0; }
+	friend class JobSystem;
+private:
+	std::atomic<uint32_t> _pending = 0;
+};
+
+//fixed pool of worker threads pulling from one shared queue
+class JobSystem
+{
+public:
+	//0 threads means one per hardware thread, minus the main thread
+	static void Init(uint32_t threadCount = 0);
+	static void DeInit();
+
+	static void Submit(std::function<void()> job, JobCounter& counter);
+	//runs queued jobs on the calling thread while it waits so the main thread is never idle
+	static void Wait(JobCounter& counter);
+	//splits [0, count) into chunks of chunkSize and blocks until all of them have run
+	static void ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)>& func);
+
+	static uint32_t WorkerCount();
+
+private:
+	struct Job
+	{
+		std::function<void()> func;
+		JobCounter* counter;
+	};
+
+	static void WorkerLoop();
+	static bool TryRunJob();
+	static void RunJob(Job& job);
+
+	inline static std::vector<std::thread> _workers;
+	inline static std::deque<Job> _queue;
+	inline static std::mutex _queueMutex;
+	inline static std::condition_variable _queueCondition;
+	//notified whenever a counter reaches zero or a job is queued, so waiters can pick it up
+	inline static std::condition_variable _doneCondition;
+	inline static bool _quit = false;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+
+//Read only view of a whole file, the OS pages it in on first touch instead of us reading it into a buffer
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//false if the file can't be opened or is empty, the old mapping is closed either way
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	bool IsOpen() const { return _data != nullptr; }
+	const char* GetData() const { return _data; }
+	uint64_t GetSize() const { return _size; }
+	//whether ptr points into the mapping
+	bool Contains(const void* ptr) const;
+
+private:
+	const char* _data = nullptr;
+	uint64_t _size = 0;
+#ifdef _WIN32
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#else
+	int _file = -1;
+#endif
+};
@@ -8,19 +8,37 @@
 
 #include <iostream>
 #include <filesystem>
+#include <string_view>
 #include "Graphics/Graphics.h"
+#include "Utils/Benchmark.h"
+#include "Utils/JobSystem.h"
 
-int main() {
+int main(int argc, char** argv) {
+    bool runBenchmarks = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        runBenchmarks |= std::string_view(argv[i]) == "--bench";
+    }
+
+    JobSystem::Init();
     Graphics::Init();
     char *temp;
     size_t tempsize;
 	errno_t err = _dupenv_s(&temp, &tempsize, "VK_INSTANCE_LAYERS");
-    while (!Graphics::ShouldClose())
+
+    if (runBenchmarks)
+    {
+        Benchmark::RunAll();
+    }
+
+    while (!runBenchmarks && !Graphics::ShouldClose())
     {
         Graphics::Update();
     }
 
     Graphics::DeInit();
+    JobSystem::DeInit();
 
     return 0;
 }
\ No newline at end of file